@@ -0,0 +1,479 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../pbench.h"
+#include "../../core/builtin.h"
+#include "../../core/env.h"
+#include "../../core/eval.h"
+#include "../../core/vm.h"
+
+
+lval_T* lval_copy (lval_T* val);
+lval_T* lval_num  (double n);
+lval_T* lval_pop  (lval_T* t, size_t i);
+lval_T* lval_sym  (const char* s);
+
+
+static lexy_vm_T* vm = NULL;
+static lenv_T* env = NULL;
+static char bench_dir[] = "/tmp/lexy-bench-XXXXXX";
+
+
+/* writes "contents" to a file inside the scratch directory */
+static char*
+bench_file(const char* name, const char* contents)
+{
+    char* path = malloc(strlen(bench_dir) + strlen(name) + 2);
+    sprintf(path, "%s/%s", bench_dir, name);
+
+    FILE* f = fopen(path, "w");
+    fputs(contents, f);
+    fclose(f);
+
+    return path;
+}
+
+
+/* builds "count" copies of a printf-style line where "%d" is the copy index */
+static char*
+bench_source(const char* line, int count)
+{
+    size_t cap = (strlen(line) + 16) * count + 1;
+    char* src = malloc(cap);
+    size_t len = 0;
+
+    src[0] = '\0';
+    for (int i = 0; i < count; i++)
+        len += snprintf(src + len, cap - len, line, i);
+
+    return src;
+}
+
+
+/* parses lexy source and returns its first form */
+static lval_T*
+bench_read(const char* src)
+{
+    mpc_result_t r;
+    if (!mpc_parse("<bench>", src, vm->parser.read, &r))
+    {
+        mpc_err_print(r.error);
+        exit(1);
+    }
+
+    lval_T* forms = r.output;
+    lval_T* form = lval_pop(forms, 0);
+    lval_del(forms);
+
+    return form;
+}
+
+
+/* evaluates a form the same way the REPL evaluates a top-level form */
+static void
+bench_eval(lval_T* form)
+{
+    lval_arena_begin();
+    lval_del(lval_eval(env, lval_copy(form)));
+    lval_arena_end();
+}
+
+
+static void
+bench_use(const char* module)
+{
+    lval_del(btinfn_load(env, lval_add(lval_sexpr(), lval_str((char*)module))));
+}
+
+
+/* interpreter with the standard library loaded; shared by every benchmark */
+static void
+bench_init(void)
+{
+    if (env != NULL)
+        return;
+
+    vm  = lexy_vm_new();
+    env = vm->env;
+    lexy_vm_enter(vm);
+
+    bench_use("lib/std");
+}
+
+
+/* Interpreter startup */
+
+static void
+bench_startup_env(long n)
+{
+    bench_init();
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+    {
+        lenv_T* e = lenv_new();
+        lenv_init(e);
+        lenv_del(e);
+    }
+}
+
+static void
+bench_startup_vm(long n)
+{
+    bench_init();
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+        lexy_vm_del(lexy_vm_new());
+}
+
+void
+suite_startup(void)
+{
+    pb_add_bench(bench_startup_env, "lenv-init", "startup");
+    pb_add_bench(bench_startup_vm, "vm-new", "startup");
+}
+
+
+/* Symbol lookup */
+
+static void
+bench_lookup_depth(long n, int depth)
+{
+    bench_init();
+
+    lenv_T* inner = env;
+    for (int i = 0; i < depth; i++)
+    {
+        lenv_T* e = lenv_new();
+        e->parent = inner;
+
+        for (int j = 0; j < 8; j++)
+        {
+            char name[32];
+            sprintf(name, "local-%d-%d", i, j);
+
+            lval_T* sym = lval_sym(name);
+            lval_T* val = lval_num(j);
+            lval_del(lenv_put(e, sym, val, LCOND_DYNAMIC));
+            lval_del(sym);
+            lval_del(val);
+        }
+
+        inner = e;
+    }
+
+    lval_T* sym = lval_sym("drop-start-of");
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+        lval_del(lenv_get(inner, sym));
+
+    lval_del(sym);
+    while (inner != env)
+    {
+        lenv_T* parent = inner->parent;
+        lenv_del(inner);
+        inner = parent;
+    }
+}
+
+static void bench_lookup_depth_1(long n)  { bench_lookup_depth(n, 1); }
+static void bench_lookup_depth_16(long n) { bench_lookup_depth(n, 16); }
+static void bench_lookup_depth_64(long n) { bench_lookup_depth(n, 64); }
+
+void
+suite_lookup(void)
+{
+    pb_add_bench(bench_lookup_depth_1,  "depth-1",  "lookup");
+    pb_add_bench(bench_lookup_depth_16, "depth-16", "lookup");
+    pb_add_bench(bench_lookup_depth_64, "depth-64", "lookup");
+}
+
+
+/* Arithmetic */
+
+static void
+bench_numop(long n, const char* op, int argc)
+{
+    bench_init();
+
+    char* args = bench_source(" %d", argc);
+    char* src  = malloc(strlen(op) + strlen(args) + 4);
+    sprintf(src, "(%s%s)", op, args);
+
+    lval_T* form = bench_read(src);
+    free(args);
+    free(src);
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+        bench_eval(form);
+
+    lval_del(form);
+}
+
+static void bench_add_2(long n)    { bench_numop(n, "add", 2); }
+static void bench_add_1000(long n) { bench_numop(n, "add", 1000); }
+static void bench_max_1000(long n) { bench_numop(n, "max", 1000); }
+
+void
+suite_numop(void)
+{
+    pb_add_bench(bench_add_2,    "add-2",    "numop");
+    pb_add_bench(bench_add_1000, "add-1000", "numop");
+    pb_add_bench(bench_max_1000, "max-1000", "numop");
+}
+
+
+/* Standard library recursion */
+
+static void
+bench_std(long n, const char* fmt)
+{
+    bench_init();
+
+    char* list = bench_source(" %d", 100);
+    char* src  = malloc(strlen(fmt) + strlen(list) + 1);
+    sprintf(src, fmt, list);
+
+    lval_T* form = bench_read(src);
+    free(list);
+    free(src);
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+        bench_eval(form);
+
+    lval_del(form);
+}
+
+static void bench_len_of_100(long n) { bench_std(n, "(len-of {%s})"); }
+static void bench_nth_of_100(long n) { bench_std(n, "(nth-of {%s} 99)"); }
+
+void
+suite_std(void)
+{
+    pb_add_bench(bench_len_of_100, "len-of-100", "std");
+    pb_add_bench(bench_nth_of_100, "nth-of-100", "std");
+}
+
+
+/* Output */
+
+static void
+bench_render(long n, int count)
+{
+    bench_init();
+
+    char* items = bench_source(" %d \"text\"", count);
+    char* src   = malloc(strlen(items) + 3);
+    sprintf(src, "{%s}", items);
+
+    lval_T* form = bench_read(src);
+    free(items);
+    free(src);
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+        lval_del(btinfn_to_string(env, lval_add(lval_sexpr(), lval_copy(form))));
+
+    lval_del(form);
+}
+
+static void bench_render_1000(long n) { bench_render(n, 1000); }
+
+void
+suite_output(void)
+{
+    pb_add_bench(bench_render_1000, "to-string-1000", "output");
+}
+
+
+/* Strings */
+
+static void
+bench_str_append(long n, int count)
+{
+    bench_init();
+
+    lval_T* piece = lval_str("line of text, ");
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+    {
+        lval_T* acc = lval_str("");
+
+        for (int j = 0; j < count; j++)
+            acc = btinfn_str_concat(env, lval_add(lval_add(lval_sexpr(), acc), lval_copy(piece)));
+
+        lval_del(btinfn_str_split(env, lval_add(lval_add(lval_sexpr(), acc), lval_str(", "))));
+    }
+
+    lval_del(piece);
+}
+
+static void bench_str_append_1000(long n) { bench_str_append(n, 1000); }
+
+void
+suite_string(void)
+{
+    pb_add_bench(bench_str_append_1000, "concat-split-1000", "string");
+}
+
+
+/* Function calls */
+
+static void
+bench_call(long n, const char* src)
+{
+    bench_init();
+
+    lval_T* def1 = bench_read("(fn {bench-id x} {x})");
+    lval_T* def3 = bench_read("(fn {bench-add3 x y z} {add x y z})");
+    bench_eval(def1);
+    bench_eval(def3);
+
+    lval_T* form = bench_read(src);
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+        bench_eval(form);
+
+    lval_del(def1);
+    lval_del(def3);
+    lval_del(form);
+}
+
+static void bench_call_builtin(long n) { bench_call(n, "(add 1 2)"); }
+static void bench_call_lambda1(long n) { bench_call(n, "(bench-id 1)"); }
+static void bench_call_lambda3(long n) { bench_call(n, "(bench-add3 1 2 3)"); }
+static void bench_call_partial(long n) { bench_call(n, "((bench-add3 1) 2 3)"); }
+static void bench_call_err_type(long n) { bench_call(n, "(add 1 \"x\")"); }
+static void bench_call_err_zero(long n) { bench_call(n, "(div 1 0)"); }
+
+void
+suite_call(void)
+{
+    pb_add_bench(bench_call_builtin, "builtin",  "call");
+    pb_add_bench(bench_call_lambda1, "lambda-1", "call");
+    pb_add_bench(bench_call_lambda3, "lambda-3", "call");
+    pb_add_bench(bench_call_partial, "partial",  "call");
+    pb_add_bench(bench_call_err_type, "error-type", "call");
+    pb_add_bench(bench_call_err_zero, "error-div0", "call");
+}
+
+
+/* Parsing and loading */
+
+static void
+bench_parse_file(long n, const char* line, int forms)
+{
+    bench_init();
+
+    char* src = bench_source(line, forms);
+
+    char* path = bench_file("parse.lisp", src);
+    free(src);
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+    {
+        mpc_result_t r;
+        if (!mpc_parse_contents(path, vm->parser.read, &r))
+        {
+            mpc_err_print(r.error);
+            exit(1);
+        }
+
+        lval_del(r.output);
+    }
+
+    free(path);
+}
+
+#define BENCH_PARSE_LINE \
+    "; definition number %d\n" \
+    "(fn {bench-fn x y} {if (gt x y) {add x y 1.5} {join {x \"text\"} (list y)}})\n"
+
+/* few forms made of long tokens, where scanning dominates */
+#define BENCH_TOKENS_LINE \
+    "; a long comment line, the kind that documents a module at length %d\n" \
+    "(print \"a long string literal, with an \\\"escaped\\\" quote, that goes on and on\")\n"
+
+static void bench_parse_64k(long n)    { bench_parse_file(n, BENCH_PARSE_LINE, 640); }
+static void bench_parse_256k(long n)   { bench_parse_file(n, BENCH_PARSE_LINE, 2560); }
+static void bench_parse_tokens(long n) { bench_parse_file(n, BENCH_TOKENS_LINE, 400); }
+
+static void
+bench_use_module(long n, bool cached)
+{
+    bench_init();
+
+    char* src = bench_source("(global {bench-fn-%d} (lambda {x} {add x 1}))\n", 200);
+    free(bench_file("module.lisp", src));
+    free(src);
+
+    char* module = malloc(strlen(bench_dir) + sizeof("/module"));
+    sprintf(module, "%s/module", bench_dir);
+    pb_reset_timer();
+
+    for (long i = 0; i < n; i++)
+    {
+        if (!cached)
+            lmod_clear(vm->modules);
+
+        bench_use(module);
+    }
+
+    free(module);
+}
+
+static void bench_use_cold(long n)   { bench_use_module(n, FALSE); }
+static void bench_use_cached(long n) { bench_use_module(n, TRUE); }
+
+void
+suite_load(void)
+{
+    pb_add_bench(bench_parse_64k,  "parse-64k",  "load");
+    pb_add_bench(bench_parse_256k, "parse-256k", "load");
+    pb_add_bench(bench_parse_tokens, "parse-tokens-64k", "load");
+    pb_add_bench(bench_use_cold,   "use-200",    "load");
+    pb_add_bench(bench_use_cached, "use-cached", "load");
+}
+
+
+int
+main(int argc, char** argv)
+{
+    if (mkdtemp(bench_dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    pb_add_suite(suite_startup);
+    pb_add_suite(suite_lookup);
+    pb_add_suite(suite_numop);
+    pb_add_suite(suite_std);
+    pb_add_suite(suite_output);
+    pb_add_suite(suite_string);
+    pb_add_suite(suite_call);
+    pb_add_suite(suite_load);
+
+    int retcode = pb_run();
+
+    /* scratch files are created by the (forked) benchmarks themselves */
+    char* path = malloc(strlen(bench_dir) + sizeof("/module.lisp"));
+    sprintf(path, "%s/parse.lisp", bench_dir);
+    remove(path);
+    sprintf(path, "%s/module.lisp", bench_dir);
+    remove(path);
+    remove(bench_dir);
+
+    free(path);
+    return retcode;
+}
@@ -0,0 +1,232 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pbench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/*
+ * pbench - a ptest-flavoured micro-benchmark runner.
+ *
+ * Every benchmark runs in its own forked process, so the heap state and the
+ * peak RSS of one benchmark never leak into the next. Results are written to
+ * STDOUT as tab-separated values (one line per benchmark, with a header), which
+ * can be diffed or joined between two versions; progress goes to STDERR.
+ */
+
+/* Globals */
+
+enum {
+  MAX_NAME = 512
+};
+
+enum {
+  MAX_BENCHES = 256
+};
+
+enum {
+  MAX_ITERATIONS = 1000000000
+};
+
+/* minimum time a single measured run must take to be trusted */
+static const double min_run_ns = 2e8;
+
+/* how many measured runs to take the median from */
+enum {
+  NUM_RUNS = 5
+};
+
+/* Allocations */
+
+static long num_allocs = 0;
+
+#ifdef PB_COUNT_ALLOCS
+
+/*
+ * With "-Wl,--wrap=..." the linker routes every allocation made by the code
+ * under benchmark through these counters.
+ */
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  num_allocs++;
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size) {
+  num_allocs++;
+  return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  num_allocs++;
+  return __real_realloc(ptr, size);
+}
+
+#endif
+
+/* Timing */
+
+static double pb_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double timer_start = 0;
+static long allocs_start = 0;
+
+void pb_reset_timer(void) {
+  allocs_start = num_allocs;
+  timer_start = pb_now();
+}
+
+/* Benchmarks */
+
+typedef struct {
+  void (*func)(long);
+  char name[MAX_NAME];
+  char suite[MAX_NAME];
+} bench_t;
+
+static bench_t benches[MAX_BENCHES];
+static int num_benches = 0;
+
+void pb_add_bench(void (*func)(long), const char* name, const char* suite) {
+
+  bench_t bench;
+
+  if (num_benches == MAX_BENCHES) {
+    fprintf(stderr, "ERROR: Exceeded maximum benchmark count of %i!\n",
+      MAX_BENCHES); abort();
+  }
+
+  if (strlen(name) >= MAX_NAME || strlen(suite) >= MAX_NAME) {
+    fprintf(stderr, "ERROR: Benchmark name '%s/%s' too long (Maximum is %i characters)\n",
+      suite, name, MAX_NAME); abort();
+  }
+
+  bench.func = func;
+  strcpy(bench.name, name);
+  strcpy(bench.suite, suite);
+
+  benches[num_benches] = bench;
+  num_benches++;
+}
+
+/* Suites */
+
+void pb_add_suite(void (*func)(void)) {
+  func();
+}
+
+/* Running */
+
+typedef struct {
+  double ns;
+  long allocs;
+} sample_t;
+
+static sample_t pb_sample(bench_t* bench, long n) {
+
+  sample_t s;
+
+  pb_reset_timer();
+  bench->func(n);
+
+  s.ns = pb_now() - timer_start;
+  s.allocs = num_allocs - allocs_start;
+
+  return s;
+}
+
+static int pb_cmp_sample(const void* a, const void* b) {
+  double x = ((const sample_t*)a)->ns;
+  double y = ((const sample_t*)b)->ns;
+  return (x > y) - (x < y);
+}
+
+static void pb_measure(bench_t* bench) {
+
+  long n = 1;
+  sample_t s = pb_sample(bench, n);
+  sample_t runs[NUM_RUNS];
+  struct rusage usage;
+
+  /* grow the iteration count until a single run is long enough */
+  while (s.ns < min_run_ns && n < MAX_ITERATIONS) {
+    double per_op = s.ns > 0 ? s.ns / n : 1;
+    long next = (long)(min_run_ns * 1.2 / per_op);
+
+    if (next > n * 100) { next = n * 100; }
+    if (next <= n) { next = n + 1; }
+    if (next > MAX_ITERATIONS) { next = MAX_ITERATIONS; }
+
+    n = next;
+    s = pb_sample(bench, n);
+  }
+
+  for (int i = 0; i < NUM_RUNS; i++) {
+    runs[i] = pb_sample(bench, n);
+  }
+
+  qsort(runs, NUM_RUNS, sizeof(sample_t), pb_cmp_sample);
+  s = runs[NUM_RUNS / 2];
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("%s/%s\t%.1f\t", bench->suite, bench->name, s.ns / n);
+
+#ifdef PB_COUNT_ALLOCS
+  printf("%.2f\t", (double)s.allocs / n);
+#else
+  printf("-\t");
+#endif
+
+  printf("%ld\t%ld\n", (long)usage.ru_maxrss, n);
+  fflush(stdout);
+}
+
+int pb_run(void) {
+
+  int num_fails = 0;
+
+  puts("benchmark\tns/op\tallocs/op\tpeak_rss_kb\titerations");
+  fflush(stdout);
+
+  for (int i = 0; i < num_benches; i++) {
+
+    bench_t* bench = &benches[i];
+    int status;
+    pid_t pid;
+
+    fprintf(stderr, "    | %s/%s ... ", bench->suite, bench->name);
+    fflush(stderr);
+
+    pid = fork();
+
+    if (pid == 0) {
+      pb_measure(bench);
+      _exit(0);
+    }
+
+    if (pid < 0 || waitpid(pid, &status, 0) < 0
+        || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fputs("Failed!\n", stderr);
+      num_fails++;
+      continue;
+    }
+
+    fputs("Done\n", stderr);
+  }
+
+  return num_fails > 0 ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#ifndef pbench_h
+#define pbench_h
+
+#define PB_SUITE(name) void name(void)
+
+#define PB_FUNC(name) static void name(long n)
+#define PB_REG(name) pb_add_bench(name, #name, __func__)
+
+void pb_reset_timer(void);
+
+void pb_add_bench(void (*func)(long), const char* name, const char* suite);
+void pb_add_suite(void (*func)(void));
+int pb_run(void);
+
+#endif
@@ -0,0 +1,164 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdlib.h>
+
+#include "arena.h"
+
+
+struct arena_block_S;
+typedef struct arena_block_S arena_block_T;
+
+
+/* a chunk of contiguous slots; slots are handed out bump-pointer style */
+struct arena_block_S
+{
+    arena_block_T* next;
+    size_t used;
+
+    unsigned char data[];
+};
+
+
+/* a released slot, threaded through the memory of the slot itself */
+struct arena_free_S
+{
+    struct arena_free_S* next;
+};
+
+
+struct arena_S
+{
+    size_t slot_size;
+
+    arena_block_T* head;
+    struct arena_free_S* free_list;
+};
+
+
+static arena_block_T* arena_block_new(const arena_T* a, arena_block_T* next)
+{
+    arena_block_T* b = malloc(sizeof(struct arena_block_S) + (a->slot_size * ARENA_BLOCK_SLOTS));
+    b->next = next;
+    b->used = 0;
+
+    return b;
+}
+
+
+/**
+ * arena_new - Arena creation
+ *
+ * Constructs an arena that hands out fixed-size slots of "slot_size" bytes.
+ */
+arena_T* arena_new(size_t slot_size)
+{
+    arena_T* a = malloc(sizeof(struct arena_S));
+
+    /* slots must be able to hold the free-list link and keep pointer alignment */
+    if (slot_size < sizeof(struct arena_free_S))
+        slot_size = sizeof(struct arena_free_S);
+
+    a->slot_size = (slot_size + (sizeof(void*) - 1)) & ~(sizeof(void*) - 1);
+    a->free_list = NULL;
+    a->head      = arena_block_new(a, NULL);
+
+    return a;
+}
+
+
+/**
+ * arena_alloc - Arena slot allocation
+ *
+ * Reuses a released slot if there is one; otherwise, bumps the current block.
+ */
+void* arena_alloc(arena_T* a)
+{
+    if (a->free_list != NULL)
+    {
+        struct arena_free_S* slot = a->free_list;
+        a->free_list = slot->next;
+
+        return slot;
+    }
+
+    if (a->head->used == ARENA_BLOCK_SLOTS)
+        a->head = arena_block_new(a, a->head);
+
+    return a->head->data + (a->slot_size * a->head->used++);
+}
+
+
+/**
+ * arena_release - Arena slot release
+ *
+ * Gives a single slot back to the arena so it can be reused before the reset.
+ */
+void arena_release(arena_T* a, void* p)
+{
+    struct arena_free_S* slot = p;
+    slot->next = a->free_list;
+
+    a->free_list = slot;
+}
+
+
+/**
+ * arena_reset - Arena reset
+ *
+ * Releases every slot at once. Only the first block is kept around for reuse.
+ */
+void arena_reset(arena_T* a)
+{
+    while (a->head->next != NULL)
+    {
+        arena_block_T* b = a->head;
+        a->head = b->next;
+
+        free(b);
+    }
+
+    a->head->used = 0;
+    a->free_list  = NULL;
+}
+
+
+/**
+ * arena_destroy - Arena deletion
+ */
+void arena_destroy(arena_T* a)
+{
+    while (a->head != NULL)
+    {
+        arena_block_T* b = a->head;
+        a->head = b->next;
+
+        free(b);
+    }
+
+    free(a);
+}
@@ -0,0 +1,48 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_ARENA
+#define LEXY_ARENA
+
+#include <stddef.h>
+
+
+/* number of slots held by each block of an arena */
+#define ARENA_BLOCK_SLOTS 1024
+
+
+struct arena_S;
+typedef struct arena_S arena_T;
+
+
+arena_T* arena_new     (size_t slot_size);
+void*    arena_alloc   (arena_T* a);
+void     arena_release (arena_T* a, void* p);
+void     arena_reset   (arena_T* a);
+void     arena_destroy (arena_T* a);
+
+#endif
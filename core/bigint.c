@@ -0,0 +1,671 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bigint.h"
+
+
+/* ten to the ninth, the largest power of ten that fits in a limb */
+#define BIG_DECIMAL_CHUNK  1000000000u
+#define BIG_DECIMAL_DIGITS 9
+
+
+static lbig_T* big_alloc          (size_t length);
+static lbig_T* big_norm           (lbig_T* a);
+static lbig_T* big_addsign        (const lbig_T* a, const lbig_T* b, bool bneg);
+static int     mag_cmp            (const uint32_t* a, size_t na, const uint32_t* b, size_t nb);
+static void    mag_add_into       (uint32_t* r, size_t nr, const uint32_t* x, size_t nx);
+static void    mag_sub_from       (uint32_t* r, size_t nr, const uint32_t* x, size_t nx);
+static void    mag_mul_school     (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* r);
+static void    mag_mul            (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* r);
+static uint32_t mag_divmod_small  (uint32_t* a, size_t na, uint32_t d);
+static void    mag_divmod         (const uint32_t* u, size_t m, const uint32_t* v, size_t n, uint32_t* q, uint32_t* r);
+
+
+/**
+ * big_alloc - Zeroed integer with room for "length" limbs
+ */
+static lbig_T* big_alloc(size_t length)
+{
+    lbig_T* a = calloc(1, sizeof(lbig_T) + (length ? length : 1) * sizeof(uint32_t));
+    a->length = length;
+    a->negative = FALSE;
+    return a;
+}
+
+
+/**
+ * big_norm - Drop leading zero limbs
+ *
+ * Zero is always positive, so every value has a single representation.
+ */
+static lbig_T* big_norm(lbig_T* a)
+{
+    while (a->length > 0 && a->limbs[a->length - 1] == 0)
+        a->length--;
+
+    if (a->length == 0)
+        a->negative = FALSE;
+
+    return a;
+}
+
+
+lbig_T* big_from_int(int64_t n)
+{
+    lbig_T* a = big_alloc(2);
+    uint64_t m = n < 0 ? (uint64_t)0 - (uint64_t)n : (uint64_t)n;
+
+    a->limbs[0] = (uint32_t)m;
+    a->limbs[1] = (uint32_t)(m >> 32);
+    a->negative = n < 0;
+    return big_norm(a);
+}
+
+
+/**
+ * big_from_str - Parse a decimal integer
+ *
+ * Accepts an optional sign followed by digits; anything else stops the scan.
+ * Chunks of nine digits are folded in with one multiply-add per limb.
+ */
+lbig_T* big_from_str(const char* s)
+{
+    bool negative = FALSE;
+    size_t digits;
+    lbig_T* a;
+
+    if (*s == '-' || *s == '+')
+        negative = *s++ == '-';
+
+    for (digits = 0; s[digits] >= '0' && s[digits] <= '9'; digits++)
+        ;
+
+    /* each limb holds at least nine decimal digits */
+    a = big_alloc(digits / BIG_DECIMAL_DIGITS + 1);
+    a->length = 0;
+
+    while (digits > 0)
+    {
+        size_t take = digits % BIG_DECIMAL_DIGITS ? digits % BIG_DECIMAL_DIGITS : BIG_DECIMAL_DIGITS;
+        uint64_t scale = 1, carry = 0;
+        size_t i;
+
+        for (i = 0; i < take; i++)
+        {
+            carry = carry * 10 + (uint64_t)(*s++ - '0');
+            scale *= 10;
+        }
+
+        for (i = 0; i < a->length; i++)
+        {
+            uint64_t t = (uint64_t)a->limbs[i] * scale + carry;
+            a->limbs[i] = (uint32_t)t;
+            carry = t >> 32;
+        }
+
+        if (carry)
+            a->limbs[a->length++] = (uint32_t)carry;
+
+        digits -= take;
+    }
+
+    a->negative = negative;
+    return big_norm(a);
+}
+
+
+lbig_T* big_copy(const lbig_T* a)
+{
+    lbig_T* b = big_alloc(a->length);
+    memcpy(b->limbs, a->limbs, a->length * sizeof(uint32_t));
+    b->negative = a->negative;
+    return b;
+}
+
+
+void big_del(lbig_T* a)
+{
+    free(a);
+}
+
+
+void big_neg(lbig_T* a)
+{
+    if (a->length > 0)
+        a->negative = !a->negative;
+}
+
+
+/**
+ * mag_cmp - Compare two magnitudes
+ *
+ * The lengths may include leading zeros.
+ */
+static int mag_cmp(const uint32_t* a, size_t na, const uint32_t* b, size_t nb)
+{
+    while (na > 0 && a[na - 1] == 0)
+        na--;
+
+    while (nb > 0 && b[nb - 1] == 0)
+        nb--;
+
+    if (na != nb)
+        return na < nb ? -1 : 1;
+
+    while (na-- > 0)
+        if (a[na] != b[na])
+            return a[na] < b[na] ? -1 : 1;
+
+    return 0;
+}
+
+
+int big_cmp(const lbig_T* a, const lbig_T* b)
+{
+    int c;
+
+    if (a->negative != b->negative)
+        return a->negative ? -1 : 1;
+
+    c = mag_cmp(a->limbs, a->length, b->limbs, b->length);
+    return a->negative ? -c : c;
+}
+
+
+/**
+ * mag_add_into - Add "x" to "r" in place
+ *
+ * The caller guarantees that the sum fits in "nr" limbs.
+ */
+static void mag_add_into(uint32_t* r, size_t nr, const uint32_t* x, size_t nx)
+{
+    uint64_t carry = 0;
+    size_t i;
+
+    for (i = 0; i < nx; i++)
+    {
+        carry += (uint64_t)r[i] + x[i];
+        r[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+
+    for (; carry && i < nr; i++)
+    {
+        carry += r[i];
+        r[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+
+/**
+ * mag_sub_from - Subtract "x" from "r" in place
+ *
+ * The caller guarantees that "r" is not smaller than "x".
+ */
+static void mag_sub_from(uint32_t* r, size_t nr, const uint32_t* x, size_t nx)
+{
+    uint32_t borrow = 0;
+    size_t i;
+
+    for (i = 0; i < nx; i++)
+    {
+        uint64_t d = (uint64_t)r[i] - x[i] - borrow;
+        r[i] = (uint32_t)d;
+        borrow = (uint32_t)(d >> 63);
+    }
+
+    for (; borrow && i < nr; i++)
+    {
+        borrow = r[i] == 0;
+        r[i]--;
+    }
+}
+
+
+static lbig_T* big_addsign(const lbig_T* a, const lbig_T* b, bool bneg)
+{
+    const lbig_T* big;
+    const lbig_T* small;
+    lbig_T* r;
+
+    if (a->negative == bneg)
+    {
+        big = a->length >= b->length ? a : b;
+        small = big == a ? b : a;
+
+        r = big_alloc(big->length + 1);
+        mag_add_into(r->limbs, r->length, big->limbs, big->length);
+        mag_add_into(r->limbs, r->length, small->limbs, small->length);
+        r->negative = bneg;
+        return big_norm(r);
+    }
+
+    /* opposite signs: subtract the smaller magnitude from the larger one */
+    if (mag_cmp(a->limbs, a->length, b->limbs, b->length) >= 0)
+    {
+        r = big_copy(a);
+        mag_sub_from(r->limbs, r->length, b->limbs, b->length);
+        r->negative = a->negative;
+    }
+    else
+    {
+        r = big_copy(b);
+        mag_sub_from(r->limbs, r->length, a->limbs, a->length);
+        r->negative = bneg;
+    }
+
+    return big_norm(r);
+}
+
+
+lbig_T* big_add(const lbig_T* a, const lbig_T* b)
+{
+    return big_addsign(a, b, b->negative);
+}
+
+
+lbig_T* big_sub(const lbig_T* a, const lbig_T* b)
+{
+    return big_addsign(a, b, b->length > 0 && !b->negative);
+}
+
+
+static void mag_mul_school(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* r)
+{
+    size_t i, j;
+
+    for (i = 0; i < na; i++)
+    {
+        uint64_t carry = 0;
+
+        if (a[i] == 0)
+            continue;
+
+        for (j = 0; j < nb; j++)
+        {
+            carry += (uint64_t)a[i] * b[j] + r[i + j];
+            r[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+
+        r[i + nb] = (uint32_t)carry;
+    }
+}
+
+
+/**
+ * mag_mul - Multiply two magnitudes into a zeroed "r" of "na + nb" limbs
+ *
+ * Operands below BIG_KARATSUBA_LIMBS use the schoolbook product. Larger ones
+ * are split at half the longer length, a = a1 B^m + a0 and b = b1 B^m + b0,
+ * and the three products z0 = a0 b0, z2 = a1 b1 and (a0 + a1)(b0 + b1) give
+ * the middle term z1 by subtraction. A much shorter "b" is instead multiplied
+ * slice by slice against "a", which keeps every recursion balanced.
+ */
+static void mag_mul(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* r)
+{
+    size_t m, nsa, nsb, i;
+    uint32_t* buffer;
+    uint32_t* z0;
+    uint32_t* z1;
+    uint32_t* z2;
+    uint32_t* sa;
+    uint32_t* sb;
+
+    if (na < nb)
+    {
+        const uint32_t* t = a;
+        a = b;
+        b = t;
+        m = na;
+        na = nb;
+        nb = m;
+    }
+
+    if (nb < BIG_KARATSUBA_LIMBS)
+    {
+        mag_mul_school(a, na, b, nb, r);
+        return;
+    }
+
+    if (2 * nb <= na)
+    {
+        buffer = malloc(2 * nb * sizeof(uint32_t));
+
+        for (i = 0; i < na; i += nb)
+        {
+            size_t len = na - i < nb ? na - i : nb;
+
+            memset(buffer, 0, (len + nb) * sizeof(uint32_t));
+            mag_mul(a + i, len, b, nb, buffer);
+            mag_add_into(r + i, na + nb - i, buffer, len + nb);
+        }
+
+        free(buffer);
+        return;
+    }
+
+    /* nb > m, so both high halves are non-empty */
+    m = na / 2;
+    nsa = na - m + 1;
+    nsb = (nb - m > m ? nb - m : m) + 1;
+
+    buffer = calloc(2 * m + (na + nb - 2 * m) + nsa + nsb + nsa + nsb, sizeof(uint32_t));
+    z0 = buffer;
+    z2 = z0 + 2 * m;
+    sa = z2 + (na + nb - 2 * m);
+    sb = sa + nsa;
+    z1 = sb + nsb;
+
+    mag_mul(a, m, b, m, z0);
+    mag_mul(a + m, na - m, b + m, nb - m, z2);
+
+    memcpy(sa, a + m, (na - m) * sizeof(uint32_t));
+    mag_add_into(sa, nsa, a, m);
+    memcpy(sb, b, m * sizeof(uint32_t));
+    mag_add_into(sb, nsb, b + m, nb - m);
+
+    mag_mul(sa, nsa, sb, nsb, z1);
+    mag_sub_from(z1, nsa + nsb, z0, 2 * m);
+    mag_sub_from(z1, nsa + nsb, z2, na + nb - 2 * m);
+
+    /* the middle term is below B^(na + nb - m), whatever its padded length */
+    mag_add_into(r, na + nb, z0, 2 * m);
+    mag_add_into(r + m, na + nb - m, z1, nsa + nsb < na + nb - m ? nsa + nsb : na + nb - m);
+    mag_add_into(r + 2 * m, na + nb - 2 * m, z2, na + nb - 2 * m);
+
+    free(buffer);
+}
+
+
+lbig_T* big_mul(const lbig_T* a, const lbig_T* b)
+{
+    lbig_T* r = big_alloc(a->length + b->length);
+
+    if (a->length > 0 && b->length > 0)
+        mag_mul(a->limbs, a->length, b->limbs, b->length, r->limbs);
+
+    r->negative = a->negative != b->negative;
+    return big_norm(r);
+}
+
+
+/**
+ * mag_divmod_small - Divide a magnitude by one limb in place
+ *
+ * Returns the remainder.
+ */
+static uint32_t mag_divmod_small(uint32_t* a, size_t na, uint32_t d)
+{
+    uint64_t rem = 0;
+
+    while (na-- > 0)
+    {
+        uint64_t cur = (rem << 32) | a[na];
+        a[na] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+
+    return (uint32_t)rem;
+}
+
+
+/**
+ * mag_divmod - Long division of magnitudes
+ *
+ * Knuth's algorithm D: "u" has "m" limbs and "v" has "n >= 2" limbs with a
+ * non-zero top, and m >= n. The "m - n + 1" quotient limbs go to "q" and the
+ * "n" remainder limbs to "r".
+ */
+static void mag_divmod(const uint32_t* u, size_t m, const uint32_t* v, size_t n, uint32_t* q, uint32_t* r)
+{
+    uint32_t* un = malloc((m + 1 + n) * sizeof(uint32_t));
+    uint32_t* vn = un + m + 1;
+    unsigned int s = 0;
+    size_t i, j;
+
+    /* normalise so the divisor's top bit is set, which bounds the guesses */
+    while (!((v[n - 1] << s) & 0x80000000u))
+        s++;
+
+    for (i = n - 1; i > 0; i--)
+        vn[i] = (v[i] << s) | (s ? v[i - 1] >> (32 - s) : 0);
+    vn[0] = v[0] << s;
+
+    un[m] = s ? u[m - 1] >> (32 - s) : 0;
+    for (i = m - 1; i > 0; i--)
+        un[i] = (u[i] << s) | (s ? u[i - 1] >> (32 - s) : 0);
+    un[0] = u[0] << s;
+
+    for (j = m - n + 1; j-- > 0;)
+    {
+        uint64_t num = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+        uint64_t qhat = num / vn[n - 1];
+        uint64_t rhat = num % vn[n - 1];
+        int64_t borrow = 0, t;
+
+        while (qhat >> 32 || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2]))
+        {
+            qhat--;
+            rhat += vn[n - 1];
+
+            if (rhat >> 32)
+                break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            uint64_t p = qhat * vn[i];
+            t = (int64_t)un[i + j] - borrow - (int64_t)(p & 0xFFFFFFFFu);
+            un[i + j] = (uint32_t)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+
+        t = (int64_t)un[j + n] - borrow;
+        un[j + n] = (uint32_t)t;
+        q[j] = (uint32_t)qhat;
+
+        /* the guess was one too large: add the divisor back */
+        if (t < 0)
+        {
+            uint64_t carry = 0;
+
+            q[j]--;
+            for (i = 0; i < n; i++)
+            {
+                carry += (uint64_t)un[i + j] + vn[i];
+                un[i + j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            un[j + n] += (uint32_t)carry;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        r[i] = (un[i] >> s) | (s ? un[i + 1] << (32 - s) : 0);
+
+    free(un);
+}
+
+
+/**
+ * big_divmod - Truncated division
+ *
+ * Returns the quotient rounded towards zero and, when "rem" is given, stores
+ * the remainder, which takes the sign of the dividend. "b" must not be zero.
+ */
+lbig_T* big_divmod(const lbig_T* a, const lbig_T* b, lbig_T** rem)
+{
+    lbig_T* q;
+    lbig_T* r;
+
+    if (mag_cmp(a->limbs, a->length, b->limbs, b->length) < 0)
+    {
+        q = big_alloc(0);
+        r = big_copy(a);
+    }
+    else if (b->length == 1)
+    {
+        q = big_copy(a);
+        r = big_alloc(1);
+        r->limbs[0] = mag_divmod_small(q->limbs, q->length, b->limbs[0]);
+    }
+    else
+    {
+        q = big_alloc(a->length - b->length + 1);
+        r = big_alloc(b->length);
+        mag_divmod(a->limbs, a->length, b->limbs, b->length, q->limbs, r->limbs);
+    }
+
+    q->negative = a->negative != b->negative;
+    r->negative = a->negative;
+    big_norm(q);
+    big_norm(r);
+
+    if (rem)
+        *rem = r;
+    else
+        big_del(r);
+
+    return q;
+}
+
+
+/**
+ * big_pow - Integer exponentiation
+ *
+ * Exponentiation by squaring.
+ */
+lbig_T* big_pow(const lbig_T* a, uint64_t exp)
+{
+    lbig_T* acc = big_from_int(1);
+    lbig_T* base = big_copy(a);
+    lbig_T* t;
+
+    while (exp > 0)
+    {
+        if (exp & 1)
+        {
+            t = big_mul(acc, base);
+            big_del(acc);
+            acc = t;
+        }
+
+        exp >>= 1;
+        if (exp > 0)
+        {
+            t = big_mul(base, base);
+            big_del(base);
+            base = t;
+        }
+    }
+
+    big_del(base);
+    return acc;
+}
+
+
+/**
+ * big_to_int - Narrow to a 64-bit integer
+ *
+ * Returns FALSE, leaving "n" untouched, when the value does not fit.
+ */
+bool big_to_int(const lbig_T* a, int64_t* n)
+{
+    uint64_t m;
+
+    if (a->length > 2)
+        return FALSE;
+
+    m = a->length > 0 ? a->limbs[0] : 0;
+    if (a->length == 2)
+        m |= (uint64_t)a->limbs[1] << 32;
+
+    if (a->negative ? m > (uint64_t)INT64_MAX + 1 : m > (uint64_t)INT64_MAX)
+        return FALSE;
+
+    *n = a->negative ? (int64_t)(0 - m) : (int64_t)m;
+    return TRUE;
+}
+
+
+double big_to_double(const lbig_T* a)
+{
+    double d = 0;
+    size_t i = a->length;
+
+    while (i-- > 0)
+        d = d * 4294967296.0 + a->limbs[i];
+
+    return a->negative ? -d : d;
+}
+
+
+/**
+ * big_to_str - Decimal representation
+ *
+ * Peels nine digits at a time off a scratch copy of the magnitude. The string
+ * is heap allocated and owned by the caller.
+ */
+char* big_to_str(const lbig_T* a)
+{
+    size_t nchunks = 0, n = a->length, size;
+    uint32_t* chunks = malloc((a->length * 10 / 9 + 2) * sizeof(uint32_t));
+    uint32_t* scratch = malloc((a->length + 1) * sizeof(uint32_t));
+    char* s;
+    char* p;
+
+    memcpy(scratch, a->limbs, a->length * sizeof(uint32_t));
+
+    do
+    {
+        chunks[nchunks++] = mag_divmod_small(scratch, n, BIG_DECIMAL_CHUNK);
+
+        while (n > 0 && scratch[n - 1] == 0)
+            n--;
+    }
+    while (n > 0);
+
+    size = nchunks * BIG_DECIMAL_DIGITS + 2;
+    s = p = malloc(size);
+
+    if (a->negative)
+        *p++ = '-';
+
+    p += sprintf(p, "%u", (unsigned int)chunks[--nchunks]);
+    while (nchunks-- > 0)
+        p += sprintf(p, "%09u", (unsigned int)chunks[nchunks]);
+
+    free(scratch);
+    free(chunks);
+    return s;
+}
@@ -0,0 +1,67 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_BIGINT
+#define LEXY_BIGINT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "type.h"
+
+
+/* operands of at least this many limbs are multiplied with Karatsuba */
+#define BIG_KARATSUBA_LIMBS 32
+
+
+/* arbitrary-precision integer: sign and magnitude, in little-endian base 2^32
+   limbs without leading zeros (zero has no limbs) */
+struct lbig_S
+{
+    size_t length;
+    bool   negative;
+
+    uint32_t limbs[];
+};
+
+
+lbig_T* big_from_int  (int64_t n);
+lbig_T* big_from_str  (const char* s);
+lbig_T* big_copy      (const lbig_T* a);
+void    big_del       (lbig_T* a);
+void    big_neg       (lbig_T* a);
+lbig_T* big_add       (const lbig_T* a, const lbig_T* b);
+lbig_T* big_sub       (const lbig_T* a, const lbig_T* b);
+lbig_T* big_mul       (const lbig_T* a, const lbig_T* b);
+lbig_T* big_divmod    (const lbig_T* a, const lbig_T* b, lbig_T** rem);
+lbig_T* big_pow       (const lbig_T* a, uint64_t exp);
+int     big_cmp       (const lbig_T* a, const lbig_T* b);
+bool    big_to_int    (const lbig_T* a, int64_t* n);
+double  big_to_double (const lbig_T* a);
+char*   big_to_str    (const lbig_T* a);
+
+#endif
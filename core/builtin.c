@@ -25,18 +25,35 @@
 
  */
 
+#include <ctype.h>
 #include <math.h>
 
 #include "builtin.h"
+#include "num.h"
 
 #include "parser.h"
+#include "stats.h"
+#include "str.h"
 #include "type.h"
+#include "error.h"
 #include "fmt.h"
+#include "pool.h"
+#include "vm.h"
+
+
+/* chunks of work handed to each "pmap" worker */
+#define PMAP_CHUNKS_PER_WORKER 4
+
+/* largest result of an exact "pow", in bits (64 MiB of limbs) */
+#define BIGINT_POW_MAX_BITS (1 << 29)
+
+/* "builtin_strfind" result when there is no match */
+#define BUILTIN_STR_NOT_FOUND ((size_t)-1)
 
 
 #define LASSERT(args, cond, fmt, ...) \
     if (!cond) { \
-        lval_T* err = lval_err(fmt, __VA_ARGS__); \
+        lval_T* err = lval_errc(LERR_BAD_ARGS, fmt, __VA_ARGS__); \
         lval_del(args); \
         return err; \
     }
@@ -49,6 +66,13 @@
         fname, (index + 1), ltype_nrepr(args->cell[index]->type), ltype_nrepr(expect))
 
 
+#define LASSERT_NUMERIC(fname, args, index) \
+    LASSERT(args, LVAL_IS_NUMERIC(args->cell[index]), \
+        "function '%s' has taken an incorrect type at argument %i. " \
+        "Got '%s', expected '%s'", \
+        fname, (index + 1), ltype_nrepr(args->cell[index]->type), ltype_nrepr(LTYPE_NUM))
+
+
 #define LASSERT_NUM(fname, args, num) \
     LASSERT(args, (args->counter == num), \
         "function '%s' has taken an incorrect number of arguments. " \
@@ -56,29 +80,101 @@
         fname, args->counter, num);
 
 
+#define LASSERT_IN_VM(fname, args) \
+    LASSERT(args, (lexy_vm_current != NULL), \
+        "function '%s' cannot be used inside of a parallel task", fname);
+
+
 #define LASSERT_NOT_EMPTY(fname, args, index) \
     LASSERT(args, (args->cell[index]->counter != 0), \
         "function '%s' has taken nil value for argument %i", \
         fname, index);
 
 
-lval_T* lenv_put      (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
-lval_T* lenv_putg     (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
-char*   ltype_nrepr   (int type);
-void    lval_del      (lval_T* v);
-int     lval_eq       (lval_T* a, lval_T* b);
-void    lval_print    (lenv_T* e, lval_T* t);
-lval_T* lval_new      (void);
-lval_T* lval_num      (double n);
-lval_T* lval_err      (const char* fmt, ...);
-lval_T* lval_eval     (lenv_T* env, lval_T* value);
-lval_T* lval_join     (lval_T* x, lval_T* y);
-lval_T* lval_lambda   (lval_T* formals, lval_T* body);
-lval_T* lval_pop      (lval_T* t, size_t i);
-lval_T* lval_sexpr    (void);
-lval_T* lval_take     (lval_T* t, size_t i);
-lval_T* lval_read     (mpc_ast_t* t);
-lval_T* btinfn_define (lenv_T* env, lval_T* qexpr, const char* fn);
+lval_T* lenv_put         (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
+lval_T* lenv_putg        (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
+char*   ltype_nrepr      (int type);
+void    lval_del         (lval_T* v);
+int     lval_eq          (lval_T* a, lval_T* b);
+void    lval_print       (lenv_T* e, lval_T* t);
+lval_T* lval_new         (void);
+lval_T* lval_add         (lval_T* v, lval_T* x);
+lval_T* lval_copy        (lval_T* val);
+lval_T* lval_qexpr       (void);
+lval_T* lval_num         (double n);
+lval_T* lval_err         (const char* fmt, ...);
+lval_T* lval_eval        (lenv_T* env, lval_T* value);
+lval_T* lval_join        (lval_T* x, lval_T* y);
+lval_T* lval_lambda      (lval_T* formals, lval_T* body);
+lval_T* lval_pop         (lval_T* t, size_t i);
+lval_T* lval_sexpr       (void);
+lval_T* lval_take        (lval_T* t, size_t i);
+lval_T* btinfn_define    (lenv_T* env, lval_T* qexpr, const char* fn);
+lval_T* lval_call        (lenv_T* env, lval_T* func, lval_T* args);
+void    lval_arena_begin (void);
+void    lval_arena_end   (void);
+
+
+/**
+ * builtin_render - Plain rendering of a value into a new string
+ */
+static lval_T* builtin_render(lval_T* v)
+{
+    char storage[LVAL_PRINT_BUFFER_BYTES];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+    lval_render(&b, v, FALSE);
+
+    lval_T* str = lval_strv(lstr_new(b.data, b.length), 0, b.length);
+
+    lbuf_free(&b);
+    return str;
+}
+
+
+/**
+ * builtin_strref - Storage holding exactly the bytes of a string
+ *
+ * Returns a new reference: the storage of "v" itself when the view covers all
+ * of it, or a flat copy of the viewed bytes otherwise.
+ */
+static lstr_T* builtin_strref(lval_T* v)
+{
+    if (v->str_offset == 0 && v->str_length == v->string->length)
+        return lstr_retain(v->string);
+
+    return lstr_new(lval_strptr(v), v->str_length);
+}
+
+
+/**
+ * builtin_strfind - Substring search
+ *
+ * Returns the index of the first "needle" in "hay" at or after "from", or
+ * BUILTIN_STR_NOT_FOUND.
+ */
+static size_t builtin_strfind(const char* hay, size_t n, const char* needle, size_t m, size_t from)
+{
+    if (m == 0)
+        return from <= n ? from : BUILTIN_STR_NOT_FOUND;
+
+    while (from + m <= n)
+    {
+        const char* hit = memchr(hay + from, needle[0], n - m + 1 - from);
+
+        if (hit == NULL)
+            break;
+
+        from = (size_t)(hit - hay);
+        if (memcmp(hit, needle, m) == 0)
+            return from;
+
+        from++;
+    }
+
+    return BUILTIN_STR_NOT_FOUND;
+}
 
 
 /**
@@ -96,7 +192,7 @@ lval_T* builtin_eq(lenv_T* env, lval_T* args, char* op)
         r = !lval_eq(args->cell[0], args->cell[1]);
 
     lval_del(args);
-    return lval_num((double)r);
+    return lval_int(r);
 }
 
 
@@ -106,91 +202,293 @@ lval_T* builtin_eq(lenv_T* env, lval_T* args, char* op)
 lval_T* builtin_order(lenv_T* env, lval_T* args, char* op)
 {
     LASSERT_NUM(op, args, 2);
-    LASSERT_TYPE(op, args, 0, LTYPE_NUM);
-    LASSERT_TYPE(op, args, 1, LTYPE_NUM);
+    LASSERT_NUMERIC(op, args, 0);
+    LASSERT_NUMERIC(op, args, 1);
+
+    lval_T* x = args->cell[0];
+    lval_T* y = args->cell[1];
+
+    /* -1, 0 or 1; integers are compared exactly */
+    int c = lval_numcmp(x, y);
 
     int r = 0;
 
     if (strequ(op, "gt"))
-        r = (args->cell[0]->number > args->cell[1]->number);
+        r = (c > 0);
 
     if (strequ(op, "ge"))
-        r = (args->cell[0]->number >= args->cell[1]->number);
+        r = (c >= 0);
 
     if (strequ(op, "lt"))
-        r = (args->cell[0]->number < args->cell[1]->number);
+        r = (c < 0);
 
     if (strequ(op, "le"))
-        r = (args->cell[0]->number <= args->cell[1]->number);
+        r = (c <= 0);
 
     lval_del(args);
-    return lval_num((double)r);
+    return lval_int(r);
 }
 
 
 /**
- * builtin_numop - Built-in numeric operations
+ * builtin_fltop - Floating-point kernel of the numeric operations
+ *
+ * Applies "op" to "x" (turned into a floating-point number) and "y". Returns
+ * an error value, or NULL when "x" holds the result.
  */
-lval_T* builtin_numop(lenv_T* env, lval_T* args, const char* op)
+static lval_T* builtin_fltop(lval_T* x, double y, const char* op)
 {
-    for (size_t i = 0; i < args->counter; i++)
+    if (x->type == LTYPE_INT)
     {
-        LASSERT_TYPE(op, args, i, LTYPE_NUM);
+        x->type   = LTYPE_NUM;
+        x->number = (double)x->integer;
     }
 
-    lval_T* xval = lval_pop(args, 0);
+    if (x->type == LTYPE_BIGINT)
+    {
+        double n = big_to_double(x->bigint);
 
-    if (strequ(op, "-") && xval->counter == 0)
-        xval->number = -xval->number;
+        big_del(x->bigint);
+        x->type   = LTYPE_NUM;
+        x->number = n;
+    }
 
-    while (args->counter > 0)
-    {
-        lval_T* yval = lval_pop(args, 0);
+    if ((strequ(op, "div") || strequ(op, "mod")) && y == 0)
+        return lval_errs(&lerr_div_zero);
 
-        if (strequ(op, "add"))
-            xval->number += yval->number;
+    if (strequ(op, "add"))
+        x->number += y;
 
-        if (strequ(op, "sub"))
-            xval->number -= yval->number;
+    if (strequ(op, "sub"))
+        x->number -= y;
 
-        if (strequ(op, "mul"))
-            xval->number *= yval->number;
+    if (strequ(op, "mul"))
+        x->number *= y;
 
-        if (strequ(op, "div"))
-        {
-            if (yval->number == 0)
-            {
-                lval_del(xval);
-                lval_del(yval);
+    if (strequ(op, "div"))
+        x->number /= y;
 
-                xval = lval_err(TLERR_DIV_ZERO);
-                break;
-            }
+    if (strequ(op, "mod"))
+        x->number = fmod(x->number, y);
 
-            xval->number /= yval->number;
-        }
+    if (strequ(op, "pow"))
+        x->number = pow(x->number, y);
+
+    if (strequ(op, "min"))
+        x->number = x->number > y ? y : x->number;
+
+    if (strequ(op, "max"))
+        x->number = x->number > y ? x->number : y;
 
-        if (strequ(op, "mod"))
-            xval->number = fmodf(xval->number, yval->number);
+    return NULL;
+}
 
-        if (strequ(op, "pow"))
-            xval->number = powf(xval->number, yval->number);
 
-        if (strequ(op, "min"))
+/**
+ * builtin_bigop - Big integer kernel of the numeric operations
+ *
+ * Same as "builtin_intop" for integers of any size. Results that fit in 64
+ * bits again are narrowed back to plain integers.
+ */
+static lval_T* builtin_bigop(lval_T* x, lval_T* y, const char* op)
+{
+    lbig_T* a = x->type == LTYPE_BIGINT ? x->bigint : big_from_int(x->integer);
+    lbig_T* b = y->type == LTYPE_BIGINT ? y->bigint : big_from_int(y->integer);
+    lbig_T* r = NULL;
+    lbig_T* rem = NULL;
+    lval_T* err = NULL;
+    int64_t small;
+
+    if ((strequ(op, "div") || strequ(op, "mod")) && b->length == 0)
+        err = lval_errs(&lerr_div_zero);
+
+    else if (strequ(op, "add"))
+        r = big_add(a, b);
+
+    else if (strequ(op, "sub"))
+        r = big_sub(a, b);
+
+    else if (strequ(op, "mul"))
+        r = big_mul(a, b);
+
+    else if (strequ(op, "div"))
+    {
+        r = big_divmod(a, b, &rem);
+
+        if (rem->length > 0)
         {
-            xval->number = xval->number > yval->number
-                ? yval->number
-                : xval->number;
+            big_del(r);
+            r = NULL;
         }
 
-        if (strequ(op, "max"))
+        big_del(rem);
+    }
+
+    else if (strequ(op, "mod"))
+        big_del(big_divmod(a, b, &r));
+
+    /* the powers of 0, 1 and -1 stay exact for any exponent; for the other
+       bases, exponents whose result would not fit in memory overflow to
+       infinity */
+    else if (strequ(op, "pow"))
+    {
+        bool unit = a->length == 1 && a->limbs[0] == 1;
+        bool odd  = b->length > 0 && (b->limbs[0] & 1);
+
+        if (!b->negative && a->length == 0)
+            r = big_from_int(b->length == 0 ? 1 : 0);
+
+        else if (!b->negative && unit)
+            r = big_from_int(a->negative && odd ? -1 : 1);
+
+        else if (!b->negative && big_to_int(b, &small)
+            && log2(fabs(big_to_double(a))) * (double)small < BIGINT_POW_MAX_BITS)
+            r = big_pow(a, (uint64_t)small);
+    }
+
+    else if (strequ(op, "min"))
+        r = big_copy(big_cmp(a, b) > 0 ? b : a);
+
+    else if (strequ(op, "max"))
+        r = big_copy(big_cmp(a, b) > 0 ? a : b);
+
+    if (y->type != LTYPE_BIGINT)
+        big_del(b);
+
+    if (err != NULL || r == NULL)
+    {
+        if (x->type != LTYPE_BIGINT)
+            big_del(a);
+
+        return err != NULL ? err : builtin_fltop(x, LVAL_AS_DOUBLE(y), op);
+    }
+
+    big_del(a);
+
+    if (big_to_int(r, &small))
+    {
+        big_del(r);
+        x->type    = LTYPE_INT;
+        x->integer = small;
+    }
+    else
+    {
+        x->type   = LTYPE_BIGINT;
+        x->bigint = r;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * builtin_intop - Integer kernel of the numeric operations
+ *
+ * Same as "builtin_fltop" for two 64-bit integers. Overflowing results are
+ * computed with big integers, while the ones that are not integers (inexact
+ * divisions and negative powers) are computed in floating-point instead.
+ */
+static lval_T* builtin_intop(lval_T* x, lval_T* y, const char* op)
+{
+    int64_t a = x->integer;
+    int64_t b = y->integer;
+    int64_t r = 0;
+    bool overflow = FALSE;
+    bool inexact = FALSE;
+
+    if ((strequ(op, "div") || strequ(op, "mod")) && b == 0)
+        return lval_errs(&lerr_div_zero);
+
+    if (strequ(op, "add"))
+        overflow = NUM_ADD_OVERFLOW(a, b, &r);
+
+    if (strequ(op, "sub"))
+        overflow = NUM_SUB_OVERFLOW(a, b, &r);
+
+    if (strequ(op, "mul"))
+        overflow = NUM_MUL_OVERFLOW(a, b, &r);
+
+    if (strequ(op, "div"))
+    {
+        overflow = b == -1 && a == INT64_MIN;
+        inexact = !overflow && a % b != 0;
+        r = overflow || inexact ? 0 : a / b;
+    }
+
+    if (strequ(op, "mod"))
+        r = b == -1 ? 0 : a % b;
+
+    if (strequ(op, "pow"))
+    {
+        inexact = b < 0;
+        overflow = !inexact && num_pow_overflow(a, b, &r);
+    }
+
+    if (strequ(op, "min"))
+        r = a > b ? b : a;
+
+    if (strequ(op, "max"))
+        r = a > b ? a : b;
+
+    if (overflow)
+        return builtin_bigop(x, y, op);
+
+    if (inexact)
+        return builtin_fltop(x, (double)b, op);
+
+    x->integer = r;
+    return NULL;
+}
+
+
+/**
+ * builtin_numop - Built-in numeric operations
+ *
+ * Integers stay exact for as long as every operand is one: they start in 64
+ * bits and grow into big integers on overflow. Any floating-point operand or
+ * inexact division promotes the accumulator to floating-point.
+ */
+lval_T* builtin_numop(lenv_T* env, lval_T* args, const char* op)
+{
+    for (size_t i = 0; i < args->counter; i++)
+    {
+        LASSERT_NUMERIC(op, args, i);
+    }
+
+    lval_T* xval = lval_pop(args, 0);
+
+    /* a single operand of "sub" is negated */
+    if (strequ(op, "sub") && args->counter == 0)
+    {
+        if (xval->type == LTYPE_INT && xval->integer != INT64_MIN)
+            xval->integer = -xval->integer;
+        else if (LVAL_IS_INTEGER(xval))
         {
-            xval->number = xval->number > yval->number
-                ? xval->number
-                : yval->number;
+            lval_T* m = lval_int(-1);
+            builtin_bigop(xval, m, "mul");
+            lval_del(m);
         }
+        else
+            builtin_fltop(xval, -1, "mul");
+    }
+
+    while (args->counter > 0)
+    {
+        lval_T* yval = lval_pop(args, 0);
+        lval_T* err  = (xval->type == LTYPE_INT && yval->type == LTYPE_INT)
+            ? builtin_intop(xval, yval, op)
+            : (LVAL_IS_INTEGER(xval) && LVAL_IS_INTEGER(yval))
+            ? builtin_bigop(xval, yval, op)
+            : builtin_fltop(xval, LVAL_AS_DOUBLE(yval), op);
 
         lval_del(yval);
+
+        if (err != NULL)
+        {
+            lval_del(xval);
+            xval = err;
+            break;
+        }
     }
 
     lval_del(args);
@@ -331,10 +629,9 @@ lval_T* btinfn_min(lenv_T* env, lval_T* args)
 lval_T* btinfn_sqrt(lenv_T* env, lval_T* args)
 {
     LASSERT_NUM("sqrt", args, 1);
-    LASSERT_TYPE("sqrt", args, 0, LTYPE_NUM);
+    LASSERT_NUMERIC("sqrt", args, 0);
 
-    lval_T* val = lval_pop(args, 0);
-    val->number = sqrt(val->number);
+    lval_T* val = lval_num(sqrt(LVAL_AS_DOUBLE(args->cell[0])));
 
     lval_del(args);
     return val;
@@ -485,10 +782,12 @@ lval_T* btinfn_define(lenv_T* env, lval_T* qexpr, const char* fn)
         }
         else if (strequ(fn, "global"))
         {
+            LASSERT_IN_VM(fn, qexpr);
             p = lenv_putg(env, symbols->cell[i], qexpr->cell[i + 1], LCOND_DYNAMIC);
         }
         else  // if (strequ(fn, "globalc"))
         {
+            LASSERT_IN_VM(fn, qexpr);
             p = lenv_putg(env, symbols->cell[i], qexpr->cell[i + 1], LCOND_CONSTANT);
         }
 
@@ -528,14 +827,14 @@ lval_T* btinfn_lambda(lenv_T* env, lval_T* qexpr)
 lval_T* btinfn_if(lenv_T* env, lval_T* args)
 {
     LASSERT_NUM("if", args, 3);
-    LASSERT_TYPE("if", args, 0, LTYPE_NUM);
+    LASSERT_NUMERIC("if", args, 0);
     LASSERT_TYPE("if", args, 1, LTYPE_QEXPR);
     LASSERT_TYPE("if", args, 2, LTYPE_QEXPR);
 
     args->cell[1]->type = LTYPE_SEXPR;
     args->cell[2]->type = LTYPE_SEXPR;
 
-    lval_T* v = lval_eval(env, lval_pop(args, args->cell[0]->number ? 1 : 2));
+    lval_T* v = lval_eval(env, lval_pop(args, LVAL_AS_DOUBLE(args->cell[0]) ? 1 : 2));
 
     lval_del(args);
     return v;
@@ -544,60 +843,630 @@ lval_T* btinfn_if(lenv_T* env, lval_T* args)
 
 lval_T* btinfn_print(lenv_T* env, lval_T* args)
 {
+    char storage[LVAL_PRINT_BUFFER_BYTES];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+
     for (size_t i = 0; i < args->counter; i++)
     {
-        lval_print(env, args->cell[i]);
-        putchar(' ');
+        lval_render(&b, args->cell[i], env->exec_type == LEXEC_REPL);
+        lbuf_putc(&b, ' ');
     }
-    putchar('\n');
+    lbuf_putc(&b, '\n');
+
+    lbuf_flush(&b, stdout);
+    lbuf_free(&b);
 
     lval_del(args);
     return lval_sexpr();
 }
 
 
+/**
+ * btinfn_to_string - "to-string" built-in function
+ *
+ * Takes a value and returns what "print" would write for it (without colours)
+ * as a string. Strings are returned unchanged.
+ */
+lval_T* btinfn_to_string(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("to-string", args, 1);
+
+    if (args->cell[0]->type == LTYPE_STR)
+        return lval_take(args, 0);
+
+    lval_T* str = builtin_render(args->cell[0]);
+
+    lval_del(args);
+    return str;
+}
+
+
+/**
+ * btinfn_str_len - "str-len" built-in function
+ *
+ * Takes a string and returns its length in bytes.
+ */
+lval_T* btinfn_str_len(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("str-len", args, 1);
+    LASSERT_TYPE("str-len", args, 0, LTYPE_STR);
+
+    lval_T* len = lval_int((int64_t)args->cell[0]->str_length);
+
+    lval_del(args);
+    return len;
+}
+
+
+/**
+ * btinfn_str_concat - "str-concat" built-in function
+ *
+ * Takes one or more strings and returns them joined. Long results are ropes,
+ * so growing a string one piece at a time does not copy it on every step.
+ */
+lval_T* btinfn_str_concat(lenv_T* env, lval_T* args)
+{
+    LASSERT(args, (args->counter > 0),
+        "function '%s' has taken an incorrect number of arguments. "
+        "Got %i, expected at least %i", "str-concat", args->counter, 1);
+
+    for (size_t i = 0; i < args->counter; i++)
+    {
+        LASSERT_TYPE("str-concat", args, i, LTYPE_STR);
+    }
+
+    lstr_T* acc = builtin_strref(args->cell[0]);
+
+    for (size_t i = 1; i < args->counter; i++)
+        acc = lstr_concat(acc, builtin_strref(args->cell[i]));
+
+    lval_del(args);
+    return lval_strv(acc, 0, acc->length);
+}
+
+
+/**
+ * btinfn_substr - "substr" built-in function
+ *
+ * Takes a string, a start index and an optional length, and returns that
+ * part of the string. The result shares the bytes of the original one.
+ */
+lval_T* btinfn_substr(lenv_T* env, lval_T* args)
+{
+    LASSERT(args, (args->counter == 2 || args->counter == 3),
+        "function '%s' has taken an incorrect number of arguments. "
+        "Got %i, expected %i or %i", "substr", args->counter, 2, 3);
+    LASSERT_TYPE("substr", args, 0, LTYPE_STR);
+    LASSERT_TYPE("substr", args, 1, LTYPE_INT);
+
+    lval_T* str = args->cell[0];
+    int64_t len = (int64_t)str->str_length;
+    int64_t start = args->cell[1]->integer;
+    int64_t count = len - start;
+
+    if (args->counter == 3)
+    {
+        LASSERT_TYPE("substr", args, 2, LTYPE_INT);
+        count = args->cell[2]->integer;
+    }
+
+    LASSERT(args, (start >= 0 && start <= len && count >= 0 && count <= len - start),
+        "function '%s' has taken an out of range slice [%lld, +%lld) of a string of length %lld",
+        "substr", (long long)start, (long long)count, (long long)len);
+
+    /* ropes are flattened once, so the view can point into contiguous bytes */
+    lval_strptr(str);
+    lval_T* sub = lval_strv(lstr_retain(str->string), str->str_offset + (size_t)start, (size_t)count);
+
+    lval_del(args);
+    return sub;
+}
+
+
+/**
+ * btinfn_str_split - "str-split" built-in function
+ *
+ * Takes a string and a non-empty separator and returns a Q-Expression of the
+ * pieces between separators. Every piece shares the bytes of the original.
+ */
+lval_T* btinfn_str_split(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("str-split", args, 2);
+    LASSERT_TYPE("str-split", args, 0, LTYPE_STR);
+    LASSERT_TYPE("str-split", args, 1, LTYPE_STR);
+    LASSERT(args, (args->cell[1]->str_length > 0),
+        "function '%s' has taken an empty separator", "str-split");
+
+    lval_T* str = args->cell[0];
+    lval_T* sep = args->cell[1];
+    const char* bytes = lval_strptr(str);
+    const char* needle = lval_strptr(sep);
+
+    lval_T* pieces = lval_qexpr();
+    size_t from = 0;
+
+    for (;;)
+    {
+        size_t at = builtin_strfind(bytes, str->str_length, needle, sep->str_length, from);
+        size_t end = at == BUILTIN_STR_NOT_FOUND ? str->str_length : at;
+
+        lval_add(pieces, lval_strv(lstr_retain(str->string), str->str_offset + from, end - from));
+
+        if (at == BUILTIN_STR_NOT_FOUND)
+            break;
+
+        from = at + sep->str_length;
+    }
+
+    lval_del(args);
+    return pieces;
+}
+
+
+/**
+ * btinfn_str_join - "str-join" built-in function
+ *
+ * Takes a Q-Expression of strings and an optional separator, and returns the
+ * strings joined into a single flat one.
+ */
+lval_T* btinfn_str_join(lenv_T* env, lval_T* args)
+{
+    LASSERT(args, (args->counter == 1 || args->counter == 2),
+        "function '%s' has taken an incorrect number of arguments. "
+        "Got %i, expected %i or %i", "str-join", args->counter, 1, 2);
+    LASSERT_TYPE("str-join", args, 0, LTYPE_QEXPR);
+
+    lval_T* list = args->cell[0];
+    const char* sep = "";
+    size_t seplen = 0;
+
+    if (args->counter == 2)
+    {
+        LASSERT_TYPE("str-join", args, 1, LTYPE_STR);
+        sep = lval_strptr(args->cell[1]);
+        seplen = args->cell[1]->str_length;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < list->counter; i++)
+    {
+        LASSERT(args, (list->cell[i]->type == LTYPE_STR),
+            "function '%s' has taken a list with a '%s' at position %i, expected '%s'",
+            "str-join", ltype_nrepr(list->cell[i]->type), (int)(i + 1), ltype_nrepr(LTYPE_STR));
+
+        total += list->cell[i]->str_length + (i > 0 ? seplen : 0);
+    }
+
+    /* one allocation, sized up front */
+    lstr_T* joined = lstr_new(NULL, total);
+    char* out = joined->data;
+
+    for (size_t i = 0; i < list->counter; i++)
+    {
+        if (i > 0)
+        {
+            memcpy(out, sep, seplen);
+            out += seplen;
+        }
+
+        memcpy(out, lval_strptr(list->cell[i]), list->cell[i]->str_length);
+        out += list->cell[i]->str_length;
+    }
+
+    lval_del(args);
+    return lval_strv(joined, 0, total);
+}
+
+
+/**
+ * btinfn_str_find - "str-find" built-in function
+ *
+ * Takes a string, a substring and an optional start index, and returns the
+ * index of the first occurrence of the substring at or after it, or -1.
+ */
+lval_T* btinfn_str_find(lenv_T* env, lval_T* args)
+{
+    LASSERT(args, (args->counter == 2 || args->counter == 3),
+        "function '%s' has taken an incorrect number of arguments. "
+        "Got %i, expected %i or %i", "str-find", args->counter, 2, 3);
+    LASSERT_TYPE("str-find", args, 0, LTYPE_STR);
+    LASSERT_TYPE("str-find", args, 1, LTYPE_STR);
+
+    lval_T* str = args->cell[0];
+    lval_T* sub = args->cell[1];
+    int64_t from = 0;
+
+    if (args->counter == 3)
+    {
+        LASSERT_TYPE("str-find", args, 2, LTYPE_INT);
+        from = args->cell[2]->integer;
+
+        LASSERT(args, (from >= 0 && from <= (int64_t)str->str_length),
+            "function '%s' has taken an out of range start %lld for a string of length %lld",
+            "str-find", (long long)from, (long long)str->str_length);
+    }
+
+    size_t at = builtin_strfind(lval_strptr(str), str->str_length,
+        lval_strptr(sub), sub->str_length, (size_t)from);
+
+    lval_T* index = lval_int(at == BUILTIN_STR_NOT_FOUND ? -1 : (int64_t)at);
+
+    lval_del(args);
+    return index;
+}
+
+
+/**
+ * btinfn_str_to_num - "str->num" built-in function
+ *
+ * Takes a string holding a number, written as a literal would be, and
+ * returns that number.
+ */
+lval_T* btinfn_str_to_num(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("str->num", args, 1);
+    LASSERT_TYPE("str->num", args, 0, LTYPE_STR);
+
+    lval_T* str = args->cell[0];
+    const char* bytes = lval_strptr(str);
+    size_t len = str->str_length;
+    size_t i = (len > 0 && bytes[0] == '-') ? 1 : 0;
+    size_t digits = 0;
+
+    /* the same shape as the "number" rule of the grammar */
+    for (; i < len && isdigit((unsigned char)bytes[i]); i++)
+        digits++;
+
+    if (i < len && bytes[i] == '.')
+        for (i++; i < len && isdigit((unsigned char)bytes[i]); i++)
+            ;
+
+    LASSERT(args, (digits > 0 && i == len),
+        "function '%s' has taken a string that is not a number: \"%.*s\"",
+        "str->num", (int)len, bytes);
+
+    /* views are not NUL terminated */
+    char* literal = malloc(len + 1);
+    memcpy(literal, bytes, len);
+    literal[len] = '\0';
+
+    lval_T* num = lval_rnumstr(literal);
+
+    free(literal);
+    lval_del(args);
+    return num;
+}
+
+
+/**
+ * btinfn_num_to_str - "num->str" built-in function
+ *
+ * Takes a number and returns it written as a string.
+ */
+lval_T* btinfn_num_to_str(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("num->str", args, 1);
+    LASSERT_NUMERIC("num->str", args, 0);
+
+    lval_T* str = builtin_render(args->cell[0]);
+
+    lval_del(args);
+    return str;
+}
+
+
+/**
+ * btinfn_stats - "stats" built-in function
+ *
+ * Takes a Q-Expression of counter names and returns their {name value} pairs.
+ * An empty Q-Expression selects every counter.
+ */
+lval_T* btinfn_stats(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("stats", args, 1);
+    LASSERT_TYPE("stats", args, 0, LTYPE_QEXPR);
+    LASSERT(args, stats_enabled(),
+        "function '%s' is not available: lexy has been built without instrumentation",
+        "stats");
+
+    lval_T* names = lval_take(args, 0);
+    lval_T* pairs = stats_lval();
+
+    if (names->counter == 0)
+    {
+        lval_del(names);
+        return pairs;
+    }
+
+    lval_T* selected = lval_qexpr();
+    for (size_t i = 0; i < pairs->counter; i++)
+    {
+        for (size_t j = 0; j < names->counter; j++)
+        {
+            if (names->cell[j]->type == LTYPE_SYM &&
+                strequ(names->cell[j]->symbol, pairs->cell[i]->cell[0]->symbol))
+            {
+                selected = lval_add(selected, lval_copy(pairs->cell[i]));
+                break;
+            }
+        }
+    }
+
+    lval_del(names);
+    lval_del(pairs);
+
+    return selected;
+}
+
+
+/**
+ * btinfn_par - "par" built-in function
+ *
+ * Takes a function and Q-Expressions. The Q-Expressions are evaluated in
+ * parallel, as S-Expressions, and the function is called with their values.
+ */
+lval_T* btinfn_par(lenv_T* env, lval_T* args)
+{
+    LASSERT(args, (args->counter >= 1),
+        "function 'par' has taken an incorrect number of arguments. "
+        "Got %i, expected at least %i", args->counter, 1);
+
+    LASSERT_TYPE("par", args, 0, LTYPE_FUN);
+
+    for (size_t i = 1; i < args->counter; i++)
+        LASSERT_TYPE("par", args, i, LTYPE_QEXPR);
+
+    lval_T* func = lval_pop(args, 0);
+
+    for (size_t i = 0; i < args->counter; i++)
+        args->cell[i]->type = LTYPE_SEXPR;
+
+    lval_evpar(env, NULL, args, 0, 1);
+
+    for (size_t i = 0; i < args->counter; i++)
+    {
+        if (args->cell[i]->type == LTYPE_ERR)
+        {
+            lval_del(func);
+            return lval_take(args, i);
+        }
+    }
+
+    lval_T* res = lval_call(env, func, args);
+    lval_del(func);
+
+    return res;
+}
+
+
+/**
+ * btinfn_pmap - "pmap" built-in function
+ *
+ * Takes a function, a Q-Expression and, optionally, the number of worker
+ * threads. Returns the Q-Expression of the function applied to every value,
+ * in order; the calls are spread over the workers in chunks.
+ */
+lval_T* btinfn_pmap(lenv_T* env, lval_T* args)
+{
+    LASSERT(args, (args->counter == 2 || args->counter == 3),
+        "function 'pmap' has taken an incorrect number of arguments. "
+        "Got %i, expected %i or %i", args->counter, 2, 3);
+
+    LASSERT_TYPE("pmap", args, 0, LTYPE_FUN);
+    LASSERT_TYPE("pmap", args, 1, LTYPE_QEXPR);
+
+    size_t workers = pool_workers();
+    if (args->counter == 3)
+    {
+        LASSERT_NUMERIC("pmap", args, 2);
+        LASSERT(args, (LVAL_AS_DOUBLE(args->cell[2]) >= 1),
+            "function 'pmap' needs at least one worker. Got %g", LVAL_AS_DOUBLE(args->cell[2]));
+
+        workers = LVAL_AS_DOUBLE(args->cell[2]) < POOL_MAX_WORKERS
+            ? (size_t)LVAL_AS_DOUBLE(args->cell[2])
+            : POOL_MAX_WORKERS;
+    }
+
+    lval_T* func = lval_pop(args, 0);
+    lval_T* list = lval_take(args, 0);
+
+    /* a few chunks per worker, so the ones that finish early can steal */
+    size_t chunk = list->counter / (workers * PMAP_CHUNKS_PER_WORKER);
+    lval_evpar(env, func, list, workers, chunk);
+    lval_del(func);
+
+    for (size_t i = 0; i < list->counter; i++)
+    {
+        if (list->cell[i]->type == LTYPE_ERR)
+            return lval_take(list, i);
+    }
+
+    return list;
+}
+
+
 lval_T* btinfn_error(lenv_T* env, lval_T* args)
 {
     LASSERT_NUM("error", args, 1);
     LASSERT_TYPE("error", args, 0, LTYPE_STR);
 
-    lval_T* err = lval_err(args->cell[0]->string);
+    lval_T* err = lval_errc(LERR_USER, "%.*s", (int)args->cell[0]->str_length, lval_strptr(args->cell[0]));
 
     lval_del(args);
     return err;
 }
 
 
+/**
+ * btinfn_try - "try" built-in function
+ *
+ * Takes a Q-Expression and a handler function. The Q-Expression is evaluated
+ * and its value returned, unless it is an error: the handler is then called
+ * with the message of that error and its result is returned instead. Errors
+ * travel back as plain values, so nothing is unwound or copied on the way.
+ */
+lval_T* btinfn_try(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("try", args, 2);
+    LASSERT_TYPE("try", args, 0, LTYPE_QEXPR);
+    LASSERT_TYPE("try", args, 1, LTYPE_FUN);
+
+    args->cell[0]->type = LTYPE_SEXPR;
+
+    /* "exit" is not an error to handle; it keeps travelling out */
+    lval_T* res = lval_eval(env, lval_pop(args, 0));
+    if (res->type != LTYPE_ERR || res->error->code == LERR_EXIT)
+    {
+        lval_del(args);
+        return res;
+    }
+
+    char storage[LVAL_PRINT_BUFFER_BYTES];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+    lerr_format(&b, res->error);
+
+    /* some messages end with a newline meant for the terminal */
+    while (b.length > 0 && b.data[b.length - 1] == '\n')
+        b.length--;
+
+    lval_T* message = lval_strv(lstr_new(b.data, b.length), 0, b.length);
+
+    lbuf_free(&b);
+    lval_del(res);
+
+    lval_T* handler = lval_pop(args, 0);
+
+    res = lval_call(env, handler, lval_add(args, message));
+    lval_del(handler);
+
+    return res;
+}
+
+
+/**
+ * btinfn_catch - "catch" built-in function
+ *
+ * Takes the formals and the body of an error handler, like "lambda", and
+ * checks that the handler takes exactly the error message:
+ *
+ *     (try {div 1 0} (catch {e} {str-concat "failed: " e}))
+ */
+lval_T* btinfn_catch(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("catch", args, 2);
+    LASSERT_TYPE("catch", args, 0, LTYPE_QEXPR);
+    LASSERT(args, (args->cell[0]->counter == 1),
+        "function 'catch' has taken an incorrect number of formals. "
+        "Got %lu, expected 1", args->cell[0]->counter);
+
+    return btinfn_lambda(env, args);
+}
+
+
+/**
+ * btinfn_exit - "exit" built-in function
+ *
+ * Takes an integer status and ends the program with it. The status travels
+ * out as an error that "try" lets through, so every scope on the way is
+ * closed; the top level decides what ending means (the process exits, a
+ * batch run stops).
+ */
+lval_T* btinfn_exit(lenv_T* env, lval_T* args)
+{
+    LASSERT_NUM("exit", args, 1);
+    LASSERT_TYPE("exit", args, 0, LTYPE_INT);
+
+    int status = (int)args->cell[0]->integer;
+
+    lval_del(args);
+    return lval_errc(LERR_EXIT, TLERR_EXIT, status);
+}
+
+
+/**
+ * btinfn_load - "use" built-in function
+ *
+ * Takes a module name and evaluates the module in the calling environment.
+ * The name is searched as described in "lmod_resolve", and a module that was
+ * already used in the current VM is not evaluated again.
+ */
 lval_T* btinfn_load(lenv_T* env, lval_T* args)
 {
     LASSERT_NUM("use", args, 1);
     LASSERT_TYPE("use", args, 0, LTYPE_STR);
+    LASSERT_IN_VM("use", args);
+
+    lval_T* name = args->cell[0];
+    char* path = lmod_resolve(lval_strptr(name), name->str_length);
+
+    if (path == NULL)
+    {
+        lval_T* err = lval_errc(LERR_LOAD, "Could not load library %.*s: no such module in the search path",
+            (int)name->str_length, lval_strptr(name));
+
+        lval_del(args);
+        return err;
+    }
+
+    /* every module is evaluated once per VM, however many times it is used */
+    if (lmod_has(lexy_vm_current->modules, path))
+    {
+        free(path);
+        lval_del(args);
+        return lval_sexpr();
+    }
 
     mpc_result_t r;
-    if (mpc_parse_contents(strcat(args->cell[0]->string, ".lisp"), Lisp, &r))
+    int parsed = mpc_parse_contents(path, lexy_vm_current->parser.read, &r);
+
+    /* registered before it runs, so modules that use each other terminate */
+    if (parsed)
+        lmod_add(lexy_vm_current->modules, path);
+
+    free(path);
+
+    if (parsed)
     {
-        lval_T* expr = lval_read(r.output);
-        mpc_ast_delete(r.output);
+        lval_T* expr = r.output;
+        lval_T* res  = NULL;
+
+        /* what the module binds globally survives "lenv_reset" */
+        lenv_T* global = env;
+        while (global->parent)
+            global = global->parent;
+
+        global->loading++;
 
-        while (expr->counter)
+        while (expr->counter && res == NULL)
         {
+            lval_arena_begin();
+
             lval_T* e = lval_eval(env, lval_pop(expr, 0));
-            if (e->type == LTYPE_ERR)
+            if (e->type == LTYPE_ERR && e->error->code == LERR_EXIT)
+                res = lval_persist(e);
+            else if (e->type == LTYPE_ERR)
                 lval_print(env, e);
 
             lval_del(e);
+            lval_arena_end();
         }
 
+        global->loading--;
+
         lval_del(expr);
         lval_del(args);
 
-        return lval_sexpr();
+        return res != NULL ? res : lval_sexpr();
     }
 
     char* err_msg = mpc_err_string(r.error);
     mpc_err_delete(r.error);
 
-    lval_T* err = lval_err("Could not load library %s", err_msg);
+    lval_T* err = lval_errc(LERR_LOAD, "Could not load library %s", err_msg);
     free(err_msg);
 
     lval_del(args);
@@ -62,7 +62,73 @@
 #define BTIN_EVAL_DESCR    "evaluates a quoted value as an expression"   SEE_REF "eval"
 #define BTIN_LAMBDA_DESCR  "lambda (anonymous) function operator"        SEE_REF "lambda"
 #define BTIN_ERROR_DESCR   "raises an exception"                         SEE_REF "error"
+#define BTIN_TRY_DESCR     "hands the errors of some code to a handler"  SEE_REF "try"
+#define BTIN_CATCH_DESCR   "makes an error handler for \"try\""          SEE_REF "catch"
+#define BTIN_EXIT_DESCR    "ends the program with a status code"         SEE_REF "exit"
 #define BTIN_PRINT_DESCR   "sends a message to the STDOUT device"        SEE_REF "print"
+#define BTIN_STATS_DESCR   "gets the interpreter instrumentation counters" SEE_REF "stats"
+#define BTIN_PAR_DESCR     "evaluates quoted args in parallel, then calls" SEE_REF "par"
+#define BTIN_PMAP_DESCR    "applies a function to a list in parallel"    SEE_REF "pmap"
+#define BTIN_TOSTR_DESCR   "renders a value as a string"                 SEE_REF "to-string"
+#define BTIN_STRLEN_DESCR  "gets the length of a string"                 SEE_REF "str-len"
+#define BTIN_STRCAT_DESCR  "concatenates strings"                        SEE_REF "str-concat"
+#define BTIN_SUBSTR_DESCR  "gets a slice of a string"                    SEE_REF "substr"
+#define BTIN_SPLIT_DESCR   "splits a string on a separator"              SEE_REF "str-split"
+#define BTIN_STRJOIN_DESCR "joins a list of strings with a separator"    SEE_REF "str-join"
+#define BTIN_FIND_DESCR    "finds a substring within a string"           SEE_REF "str-find"
+#define BTIN_STRNUM_DESCR  "reads a number from a string"                SEE_REF "str->num"
+#define BTIN_NUMSTR_DESCR  "writes a number into a string"               SEE_REF "num->str"
+
+
+/*
+ * every built-in function, as X(name, description, function). The lookup table
+ * in "builtin_table.h" is generated from this list by "utils/write-builtins.py"
+ */
+#define BTIN_LIST(X) \
+    X("add",     BTIN_ADD_DESCR,     btinfn_add)     \
+    X("sub",     BTIN_SUB_DESCR,     btinfn_sub)     \
+    X("mul",     BTIN_MUL_DESCR,     btinfn_mul)     \
+    X("div",     BTIN_DIV_DESCR,     btinfn_div)     \
+    X("mod",     BTIN_MOD_DESCR,     btinfn_mod)     \
+    X("pow",     BTIN_POW_DESCR,     btinfn_pow)     \
+    X("max",     BTIN_MAX_DESCR,     btinfn_max)     \
+    X("min",     BTIN_MIN_DESCR,     btinfn_min)     \
+    X("sqrt",    BTIN_SQRT_DESCR,    btinfn_sqrt)    \
+    X("head",    BTIN_HEAD_DESCR,    btinfn_head)    \
+    X("tail",    BTIN_TAIL_DESCR,    btinfn_tail)    \
+    X("list",    BTIN_LIST_DESCR,    btinfn_list)    \
+    X("join",    BTIN_JOIN_DESCR,    btinfn_join)    \
+    X("if",      BTIN_IF_DESCR,      btinfn_if)      \
+    X("eq",      BTIN_EQ_DESCR,      btinfn_cmp_eq)  \
+    X("ne",      BTIN_NE_DESCR,      btinfn_cmp_ne)  \
+    X("gt",      BTIN_GT_DESCR,      btinfn_cmp_gt)  \
+    X("ge",      BTIN_GE_DESCR,      btinfn_cmp_ge)  \
+    X("lt",      BTIN_LT_DESCR,      btinfn_cmp_lt)  \
+    X("le",      BTIN_LE_DESCR,      btinfn_cmp_le)  \
+    X("let",     BTIN_LET_DESCR,     btinfn_let)     \
+    X("letc",    BTIN_LETC_DESCR,    btinfn_letc)    \
+    X("global",  BTIN_GLOBAL_DESCR,  btinfn_global)  \
+    X("globalc", BTIN_GLOBALC_DESCR, btinfn_globalc) \
+    X("use",     BTIN_USE_DESCR,     btinfn_load)    \
+    X("eval",    BTIN_EVAL_DESCR,    btinfn_eval)    \
+    X("lambda",  BTIN_LAMBDA_DESCR,  btinfn_lambda)  \
+    X("error",   BTIN_ERROR_DESCR,   btinfn_error)   \
+    X("try",     BTIN_TRY_DESCR,     btinfn_try)     \
+    X("catch",   BTIN_CATCH_DESCR,   btinfn_catch)   \
+    X("exit",    BTIN_EXIT_DESCR,    btinfn_exit)    \
+    X("print",   BTIN_PRINT_DESCR,   btinfn_print)   \
+    X("stats",   BTIN_STATS_DESCR,   btinfn_stats)   \
+    X("par",     BTIN_PAR_DESCR,     btinfn_par)     \
+    X("pmap",    BTIN_PMAP_DESCR,    btinfn_pmap)    \
+    X("to-string", BTIN_TOSTR_DESCR, btinfn_to_string) \
+    X("str-len",   BTIN_STRLEN_DESCR,  btinfn_str_len)    \
+    X("str-concat", BTIN_STRCAT_DESCR, btinfn_str_concat) \
+    X("substr",    BTIN_SUBSTR_DESCR,  btinfn_substr)     \
+    X("str-split", BTIN_SPLIT_DESCR,   btinfn_str_split)  \
+    X("str-join",  BTIN_STRJOIN_DESCR, btinfn_str_join)   \
+    X("str-find",  BTIN_FIND_DESCR,    btinfn_str_find)   \
+    X("str->num",  BTIN_STRNUM_DESCR,  btinfn_str_to_num) \
+    X("num->str",  BTIN_NUMSTR_DESCR,  btinfn_num_to_str)
 
 
 /* ... */
@@ -94,6 +160,21 @@ lval_T* btinfn_cmp_ne  (lenv_T* env, lval_T* args);
 lval_T* btinfn_if      (lenv_T* env, lval_T* args);
 lval_T* btinfn_load    (lenv_T* env, lval_T* args);
 lval_T* btinfn_error   (lenv_T* env, lval_T* args);
+lval_T* btinfn_try     (lenv_T* env, lval_T* args);
+lval_T* btinfn_catch   (lenv_T* env, lval_T* args);
+lval_T* btinfn_exit    (lenv_T* env, lval_T* args);
 lval_T* btinfn_print   (lenv_T* env, lval_T* args);
+lval_T* btinfn_stats   (lenv_T* env, lval_T* args);
+lval_T* btinfn_par     (lenv_T* env, lval_T* args);
+lval_T* btinfn_pmap    (lenv_T* env, lval_T* args);
+lval_T* btinfn_to_string (lenv_T* env, lval_T* args);
+lval_T* btinfn_str_len    (lenv_T* env, lval_T* args);
+lval_T* btinfn_str_concat (lenv_T* env, lval_T* args);
+lval_T* btinfn_substr     (lenv_T* env, lval_T* args);
+lval_T* btinfn_str_split  (lenv_T* env, lval_T* args);
+lval_T* btinfn_str_join   (lenv_T* env, lval_T* args);
+lval_T* btinfn_str_find   (lenv_T* env, lval_T* args);
+lval_T* btinfn_str_to_num (lenv_T* env, lval_T* args);
+lval_T* btinfn_num_to_str (lenv_T* env, lval_T* args);
 
 #endif
@@ -0,0 +1,63 @@
+/* this file is auto-generated by utils/write-builtins.py */
+/*                 DO NOT TOUCH IT                      */
+
+#ifndef LEXY_BUILTIN_TABLE
+#define LEXY_BUILTIN_TABLE
+
+#include "builtin.h"
+#include "type.h"
+
+#define BTIN_TABLE_SEED 11772u
+#define BTIN_TABLE_SIZE 128
+
+
+/* perfect hash table of every built-in function */
+static const lbtin_meta_T btin_table[BTIN_TABLE_SIZE] =
+{
+    [3]   = { "pow",        BTIN_POW_DESCR,     btinfn_pow },
+    [4]   = { "max",        BTIN_MAX_DESCR,     btinfn_max },
+    [8]   = { "str->num",   BTIN_STRNUM_DESCR,  btinfn_str_to_num },
+    [9]   = { "substr",     BTIN_SUBSTR_DESCR,  btinfn_substr },
+    [12]  = { "globalc",    BTIN_GLOBALC_DESCR, btinfn_globalc },
+    [13]  = { "catch",      BTIN_CATCH_DESCR,   btinfn_catch },
+    [15]  = { "list",       BTIN_LIST_DESCR,    btinfn_list },
+    [21]  = { "par",        BTIN_PAR_DESCR,     btinfn_par },
+    [22]  = { "mod",        BTIN_MOD_DESCR,     btinfn_mod },
+    [24]  = { "pmap",       BTIN_PMAP_DESCR,    btinfn_pmap },
+    [25]  = { "error",      BTIN_ERROR_DESCR,   btinfn_error },
+    [26]  = { "sqrt",       BTIN_SQRT_DESCR,    btinfn_sqrt },
+    [29]  = { "str-split",  BTIN_SPLIT_DESCR,   btinfn_str_split },
+    [33]  = { "str-join",   BTIN_STRJOIN_DESCR, btinfn_str_join },
+    [34]  = { "min",        BTIN_MIN_DESCR,     btinfn_min },
+    [37]  = { "global",     BTIN_GLOBAL_DESCR,  btinfn_global },
+    [38]  = { "le",         BTIN_LE_DESCR,      btinfn_cmp_le },
+    [39]  = { "ne",         BTIN_NE_DESCR,      btinfn_cmp_ne },
+    [42]  = { "gt",         BTIN_GT_DESCR,      btinfn_cmp_gt },
+    [46]  = { "str-len",    BTIN_STRLEN_DESCR,  btinfn_str_len },
+    [50]  = { "sub",        BTIN_SUB_DESCR,     btinfn_sub },
+    [51]  = { "tail",       BTIN_TAIL_DESCR,    btinfn_tail },
+    [55]  = { "num->str",   BTIN_NUMSTR_DESCR,  btinfn_num_to_str },
+    [57]  = { "letc",       BTIN_LETC_DESCR,    btinfn_letc },
+    [58]  = { "mul",        BTIN_MUL_DESCR,     btinfn_mul },
+    [59]  = { "try",        BTIN_TRY_DESCR,     btinfn_try },
+    [60]  = { "to-string",  BTIN_TOSTR_DESCR,   btinfn_to_string },
+    [61]  = { "if",         BTIN_IF_DESCR,      btinfn_if },
+    [63]  = { "head",       BTIN_HEAD_DESCR,    btinfn_head },
+    [66]  = { "div",        BTIN_DIV_DESCR,     btinfn_div },
+    [69]  = { "let",        BTIN_LET_DESCR,     btinfn_let },
+    [75]  = { "exit",       BTIN_EXIT_DESCR,    btinfn_exit },
+    [76]  = { "lambda",     BTIN_LAMBDA_DESCR,  btinfn_lambda },
+    [87]  = { "str-concat", BTIN_STRCAT_DESCR,  btinfn_str_concat },
+    [90]  = { "str-find",   BTIN_FIND_DESCR,    btinfn_str_find },
+    [95]  = { "join",       BTIN_JOIN_DESCR,    btinfn_join },
+    [97]  = { "eq",         BTIN_EQ_DESCR,      btinfn_cmp_eq },
+    [99]  = { "add",        BTIN_ADD_DESCR,     btinfn_add },
+    [101] = { "lt",         BTIN_LT_DESCR,      btinfn_cmp_lt },
+    [103] = { "stats",      BTIN_STATS_DESCR,   btinfn_stats },
+    [104] = { "eval",       BTIN_EVAL_DESCR,    btinfn_eval },
+    [105] = { "ge",         BTIN_GE_DESCR,      btinfn_cmp_ge },
+    [123] = { "print",      BTIN_PRINT_DESCR,   btinfn_print },
+    [125] = { "use",        BTIN_USE_DESCR,     btinfn_load },
+};
+
+#endif
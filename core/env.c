@@ -25,21 +25,25 @@
 
  */
 
+#include <stdint.h>
 #include <string.h>
 
 #include "env.h"
 
 #include "builtin.h"
+#include "builtin_table.h"
 #include "fmt.h"
+#include "stats.h"
 #include "type.h"
 
 
-void    lval_del   (lval_T* v);
-lval_T* lval_sym   (const char* s);
-lval_T* lval_err   (const char* fmt, ...);
-lval_T* lval_fun   (char* name, char* description, lbtin func);
-lval_T* lval_copy  (lval_T* val);
-lval_T* lval_sexpr (void);
+void    lval_del     (lval_T* v);
+lval_T* lval_sym     (const char* s);
+lval_T* lval_errc    (lerrcode_E code, const char* fmt, ...);
+lval_T* lval_fun     (const lbtin_meta_T* meta);
+lval_T* lval_copy    (lval_T* val);
+lval_T* lval_persist (lval_T* val);
+lval_T* lval_sexpr   (void);
 
 
 /**
@@ -52,69 +56,127 @@ lenv_T* lenv_new(void)
     lenv_T* e = malloc(sizeof(struct lenv_S));
 
     e->exec_type = LEXEC_UNDEF;
+    e->is_global = FALSE;
     e->counter   = 0;
     e->symbols   = NULL;
     e->values    = NULL;
     e->parent    = NULL;
+    e->library   = 0;
+    e->loading   = 0;
+    e->saved     = NULL;
 
     return e;
 }
 
 
 /**
- * lenv_incbin - TL environment include built-in
+ * btin_hash - Built-in name hashing
+ *
+ * FNV-1a, seeded so that every built-in name gets a distinct slot of the table
+ * generated by "utils/write-builtins.py". Both must be kept in sync.
+ */
+static uint32_t btin_hash(const char* name)
+{
+    uint32_t h = BTIN_TABLE_SEED;
+
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+
+    return h ^ (h >> 16);
+}
+
+
+/**
+ * lenv_btin - Built-in function lookup
+ *
+ * Returns the description of the built-in function called "name", if any.
  */
-void lenv_incb(lenv_T* env, char* fname, char* fdescr, lbtin fref)
+const lbtin_meta_T* lenv_btin(const char* name)
 {
-    lval_T* symb = lval_sym(fname);
-    lval_T* func = lval_fun(fname, fdescr, fref);
-    lenv_put(env, symb, func, LCOND_CONSTANT);
+    const lbtin_meta_T* meta = &btin_table[btin_hash(name) & (BTIN_TABLE_SIZE - 1)];
 
-    lval_del(symb);
-    lval_del(func);
+    return (meta->name != NULL && strequ(meta->name, name))
+        ? meta
+        : NULL;
 }
 
 
+/**
+ * lenv_init - Global environment initialization
+ *
+ * Built-in functions are not stored in the environment; they are resolved
+ * from a static table whenever a lookup reaches the global environment.
+ */
 void lenv_init(lenv_T* env)
 {
-    /* math operations */
-    lenv_incb(env, "add",  BTIN_ADD_DESCR,  btinfn_add);
-    lenv_incb(env, "sub",  BTIN_SUB_DESCR,  btinfn_sub);
-    lenv_incb(env, "mul",  BTIN_MUL_DESCR,  btinfn_mul);
-    lenv_incb(env, "div",  BTIN_DIV_DESCR,  btinfn_div);
-    lenv_incb(env, "mod",  BTIN_MOD_DESCR,  btinfn_mod);
-    lenv_incb(env, "pow",  BTIN_POW_DESCR,  btinfn_pow);
-    lenv_incb(env, "max",  BTIN_MAX_DESCR,  btinfn_max);
-    lenv_incb(env, "min",  BTIN_MIN_DESCR,  btinfn_min);
-    lenv_incb(env, "sqrt", BTIN_SQRT_DESCR, btinfn_sqrt);
-
-    /* list operations */
-    lenv_incb(env, "head", BTIN_HEAD_DESCR, btinfn_head);
-    lenv_incb(env, "tail", BTIN_TAIL_DESCR, btinfn_tail);
-    lenv_incb(env, "list", BTIN_LIST_DESCR, btinfn_list);
-    lenv_incb(env, "join", BTIN_JOIN_DESCR, btinfn_join);
-
-    /* logical operators */
-    lenv_incb(env, "if", BTIN_IF_DESCR, btinfn_if);
-    lenv_incb(env, "eq", BTIN_EQ_DESCR, btinfn_cmp_eq);
-    lenv_incb(env, "ne", BTIN_NE_DESCR, btinfn_cmp_ne);
-    lenv_incb(env, "gt", BTIN_GT_DESCR, btinfn_cmp_gt);
-    lenv_incb(env, "ge", BTIN_GE_DESCR, btinfn_cmp_ge);
-    lenv_incb(env, "lt", BTIN_LT_DESCR, btinfn_cmp_lt);
-    lenv_incb(env, "le", BTIN_LE_DESCR, btinfn_cmp_le);
-
-    /* variables declatation */
-    lenv_incb(env, "let",     BTIN_LET_DESCR,     btinfn_let);
-    lenv_incb(env, "letc",    BTIN_LETC_DESCR,    btinfn_letc);
-    lenv_incb(env, "global",  BTIN_GLOBAL_DESCR,  btinfn_global);
-    lenv_incb(env, "globalc", BTIN_GLOBALC_DESCR, btinfn_globalc);
-
-    /* functions, output etc */
-    lenv_incb(env, "use",    BTIN_USE_DESCR,    btinfn_load);
-    lenv_incb(env, "eval",   BTIN_EVAL_DESCR,   btinfn_eval);
-    lenv_incb(env, "lambda", BTIN_LAMBDA_DESCR, btinfn_lambda);
-    lenv_incb(env, "error",  BTIN_ERROR_DESCR,  btinfn_error);
-    lenv_incb(env, "print",  BTIN_PRINT_DESCR,  btinfn_print);
+    /* values bound here escape the evaluation arena and have to be promoted */
+    env->is_global = TRUE;
+}
+
+
+/**
+ * lenv_bind - Copy a value to be stored in an environment
+ *
+ * The global environment outlives any evaluation arena, so its values are
+ * always promoted to the heap.
+ */
+static lval_T* lenv_bind(lenv_T* env, lval_T* var, lval_T* value)
+{
+    if (!env->is_global)
+        return lval_copy(value);
+
+    lval_T* nval = lval_persist(value);
+
+    /* lambdas take the name of the first global they are bound to */
+    if (nval->type == LTYPE_FUN && !nval->builtin && nval->name == NULL)
+    {
+        nval->name = malloc(strlen(var->symbol) + 1);
+        strcpy(nval->name, var->symbol);
+    }
+
+    return nval;
+}
+
+
+/* moves the binding at "i" (never one of a module) to the end of the
+   module bindings, in place of the program's first one; lookups do not
+   depend on the order */
+static void lenv_keep(lenv_T* env, size_t i)
+{
+    size_t k = env->library++;
+
+    lval_T* v = env->values[k];
+    char*   s = env->symbols[k];
+
+    env->values[k]  = env->values[i];
+    env->symbols[k] = env->symbols[i];
+    env->values[i]  = v;
+    env->symbols[i] = s;
+
+    env->saved = realloc(env->saved, sizeof(lval_T*) * env->library);
+    env->saved[k] = NULL;
+}
+
+
+/* drops the value of the binding at "i" that is about to be replaced */
+static void lenv_replace(lenv_T* env, size_t i)
+{
+    /* the program rebinds a module binding: its first value is restored by
+       "lenv_reset" */
+    if (i < env->library && env->loading == 0 && env->saved[i] == NULL)
+    {
+        env->saved[i] = env->values[i];
+        return;
+    }
+
+    /* a module rebinds it: the new value is the module's one */
+    if (i < env->library && env->loading > 0 && env->saved[i] != NULL)
+    {
+        lval_del(env->saved[i]);
+        env->saved[i] = NULL;
+    }
+
+    lval_del(env->values[i]);
 }
 
 
@@ -123,18 +185,32 @@ void lenv_init(lenv_T* env)
  */
 lval_T* lenv_put(lenv_T* env, lval_T* var, lval_T* value, lcond_E cond)
 {
+    /* built-in functions behave as global constants */
+    if (env->is_global && lenv_btin(var->symbol) != NULL)
+    {
+        return cond != LCOND_CONSTANT
+            ? lval_errc(LERR_CONSTANT, "cannot reassign the variable condition")
+            : lval_errc(LERR_CONSTANT, "cannot assign to a constant variable");
+    }
+
     for (size_t i = 0; i < env->counter; i++)
     {
         if (strequ(env->symbols[i], var->symbol))
         {
             if (env->values[i]->condition != cond)
-                return lval_err("cannot reassign the variable condition");
+                return lval_errc(LERR_CONSTANT, "cannot reassign the variable condition");
 
             if (env->values[i]->condition == LCOND_CONSTANT)
-                return lval_err("cannot assign to a constant variable");
+                return lval_errc(LERR_CONSTANT, "cannot assign to a constant variable");
 
-            lval_del(env->values[i]);
-            env->values[i] = lval_copy(value);
+            if (value->condition == LCOND_UNSET)
+                value->condition = cond;
+
+            lenv_replace(env, i);
+            env->values[i] = lenv_bind(env, var, value);
+
+            if (env->loading > 0 && i >= env->library)
+                lenv_keep(env, i);
 
             return lval_sexpr();
         }
@@ -147,10 +223,14 @@ lval_T* lenv_put(lenv_T* env, lval_T* var, lval_T* value, lcond_E cond)
     if (value->condition == LCOND_UNSET)
         value->condition = cond;
 
-    env->values[env->counter - 1]  = lval_copy(value);
+    env->values[env->counter - 1]  = lenv_bind(env, var, value);
     env->symbols[env->counter - 1] = malloc(strlen(var->symbol) + 1);
 
     strcpy(env->symbols[env->counter - 1], var->symbol);
+
+    if (env->loading > 0)
+        lenv_keep(env, env->counter - 1);
+
     return lval_sexpr();
 }
 
@@ -167,6 +247,35 @@ lval_T* lenv_putg(lenv_T* env, lval_T* var, lval_T* value, lcond_E cond)
 }
 
 
+/**
+ * lenv_reset - Program bindings removal
+ *
+ * Drops the bindings that the program made in a global environment, keeping
+ * those of the modules it used (with the values the modules gave them); the
+ * modules stay loaded.
+ */
+void lenv_reset(lenv_T* env)
+{
+    for (size_t i = 0; i < env->library; i++)
+    {
+        if (env->saved[i] != NULL)
+        {
+            lval_del(env->values[i]);
+            env->values[i] = env->saved[i];
+            env->saved[i]  = NULL;
+        }
+    }
+
+    for (size_t i = env->library; i < env->counter; i++)
+    {
+        free(env->symbols[i]);
+        lval_del(env->values[i]);
+    }
+
+    env->counter = env->library;
+}
+
+
 /**
  * lenv_del - Environment creation
  */
@@ -178,8 +287,15 @@ void lenv_del(lenv_T* e)
         lval_del(e->values[i]);
     }
 
+    for (size_t i = 0; i < e->library; i++)
+    {
+        if (e->saved[i] != NULL)
+            lval_del(e->saved[i]);
+    }
+
     free(e->symbols);
     free(e->values);
+    free(e->saved);
     free(e);
 }
 
@@ -191,24 +307,50 @@ void lenv_del(lenv_T* e)
  */
 lval_T* lenv_get(lenv_T* env, lval_T* val)
 {
-    for (size_t i = 0; i < env->counter; i++)
+    size_t probes = 0;
+
+    for (; env != NULL; env = env->parent)
     {
-        if (strequ(val->symbol, env->symbols[i]))
-            return lval_copy(env->values[i]);
-    }
+        if (env->is_global)
+        {
+            const lbtin_meta_T* meta = lenv_btin(val->symbol);
+
+            if (meta != NULL)
+            {
+                STATS_PROBE(probes + 1);
+                return lval_fun(meta);
+            }
+        }
 
-    if (env->parent)
-        return lenv_get(env->parent, val);
+        for (size_t i = 0; i < env->counter; i++)
+        {
+            probes++;
 
-    return lval_err(TLERR_UNBOUND_SYM, val->symbol);
+            if (strequ(val->symbol, env->symbols[i]))
+            {
+                STATS_PROBE(probes);
+                return lval_copy(env->values[i]);
+            }
+        }
+    }
+
+    STATS_PROBE(probes);
+    return lval_errc(LERR_UNBOUND_SYM, TLERR_UNBOUND_SYM, val->symbol);
 }
 
 
 lenv_T* lenv_copy(lenv_T* env)
 {
+    STATS_INC(lenv_copy);
+
     lenv_T* nenv  = malloc(sizeof(struct lenv_S));
-    nenv->parent  = env->parent;
-    nenv->counter = env->counter;
+    nenv->parent    = env->parent;
+    nenv->exec_type = env->exec_type;
+    nenv->is_global = FALSE;
+    nenv->library   = 0;
+    nenv->loading   = 0;
+    nenv->saved     = NULL;
+    nenv->counter   = env->counter;
     nenv->symbols = malloc(sizeof(char*) * nenv->counter);
     nenv->values  = malloc(sizeof(struct lval_S) * nenv->counter);
 
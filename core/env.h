@@ -31,13 +31,15 @@
 #include "type.h"
 
 
-lenv_T* lenv_copy (lenv_T* env);
-void    lenv_del  (lenv_T* e);
-lval_T* lenv_get  (lenv_T* env, lval_T* val);
-void    lenv_incb (lenv_T* env, char* fname, char* fdescr, lbtin fref);
-void    lenv_init (lenv_T* env);
-lenv_T* lenv_new  (void);
-lval_T* lenv_put  (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
-lval_T* lenv_putg (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
+lenv_T* lenv_copy  (lenv_T* env);
+void    lenv_del   (lenv_T* e);
+lval_T* lenv_get   (lenv_T* env, lval_T* val);
+void    lenv_init  (lenv_T* env);
+lenv_T* lenv_new   (void);
+lval_T* lenv_put   (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
+lval_T* lenv_putg  (lenv_T* env, lval_T* var, lval_T* value, lcond_E cond);
+void    lenv_reset (lenv_T* env);
+
+const lbtin_meta_T* lenv_btin (const char* name);
 
 #endif
@@ -0,0 +1,406 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "error.h"
+
+
+/* room for a normalised conversion such as "%-12.*lld" */
+#define LERR_SPEC_BYTES 32
+
+
+/* one conversion of a template, with integers normalised to "ll" */
+typedef struct lerr_spec_S
+{
+    char format[LERR_SPEC_BYTES];
+    char conversion;
+    char length;
+    int  stars;
+    long precision;
+}
+lerr_spec_T;
+
+
+/* shared records of the errors that take no arguments */
+lerr_T lerr_bad_num          = LERR_STATIC(LERR_BAD_NUM,  TLERR_BAD_NUM);
+lerr_T lerr_div_zero         = LERR_STATIC(LERR_DIV_ZERO, TLERR_DIV_ZERO);
+lerr_T lerr_unbound_variadic = LERR_STATIC(LERR_BAD_ARGS, TLERR_UNBOUND_VARIADIC);
+
+
+static const char* lerr_spec    (const char* p, lerr_spec_T* spec);
+static size_t      lerr_capture (const char* template, va_list* va, lerr_T* e);
+
+
+/**
+ * lerr_spec - Template conversion parsing
+ *
+ * Reads the conversion that follows a '%' at "p" and returns where the text
+ * after it starts. Length modifiers are dropped from the normalised format;
+ * integer conversions get "ll" instead, matching how they are captured.
+ */
+static const char* lerr_spec(const char* p, lerr_spec_T* spec)
+{
+    size_t n = 0;
+
+    spec->stars = 0;
+    spec->length = 0;
+    spec->precision = -1;
+    spec->format[n++] = '%';
+
+    while (*p && strchr("-+ #0", *p) && n < LERR_SPEC_BYTES - 8)
+        spec->format[n++] = *p++;
+
+    while (*p && (*p == '*' || (*p >= '0' && *p <= '9')) && n < LERR_SPEC_BYTES - 8)
+    {
+        spec->stars += *p == '*';
+        spec->format[n++] = *p++;
+    }
+
+    if (*p == '.')
+    {
+        spec->format[n++] = *p++;
+        spec->precision = 0;
+
+        if (*p == '*')
+        {
+            spec->stars++;
+            spec->precision = -2;
+            spec->format[n++] = *p++;
+        }
+
+        while (*p >= '0' && *p <= '9' && n < LERR_SPEC_BYTES - 8)
+        {
+            spec->precision = spec->precision * 10 + (*p - '0');
+            spec->format[n++] = *p++;
+        }
+    }
+
+    /* hh and ll are folded into 'H' and 'L' */
+    while (*p && strchr("hlzjtL", *p))
+    {
+        spec->length = (spec->length == *p) ? (char)(*p - 32) : *p;
+        p++;
+    }
+
+    spec->conversion = *p;
+
+    if (*p && strchr("diouxX", *p))
+    {
+        spec->format[n++] = 'l';
+        spec->format[n++] = 'l';
+    }
+
+    spec->format[n++] = *p;
+    spec->format[n] = '\0';
+
+    return *p ? p + 1 : p;
+}
+
+
+/**
+ * lerr_capture - Template argument capture
+ *
+ * Walks the conversions of "template", taking their arguments from "va". When
+ * "e" is NULL nothing is stored and only the bytes needed for the copies of
+ * string arguments are counted; otherwise the arguments are stored in "e" and
+ * the strings copied after it. Returns the string bytes, or (size_t)-1 when
+ * there are more than LERR_MAX_ARGS arguments.
+ */
+static size_t lerr_capture(const char* template, va_list* va, lerr_T* e)
+{
+    size_t bytes = 0, nargs = 0;
+    const char* p = template;
+    lerr_spec_T spec;
+    int star = -1;
+
+    while ((p = strchr(p, '%')) != NULL)
+    {
+        if (p[1] == '%')
+        {
+            p += 2;
+            continue;
+        }
+
+        p = lerr_spec(p + 1, &spec);
+
+        if (spec.conversion == '\0' || spec.conversion == 'n' || !strchr("diouxXcsfFeEgGaAp", spec.conversion))
+            continue;
+
+        if (nargs + spec.stars + 1 > LERR_MAX_ARGS)
+            return (size_t)-1;
+
+        for (int i = 0; i < spec.stars; i++)
+        {
+            star = va_arg(*va, int);
+
+            if (e != NULL)
+                e->args[nargs].i = star;
+
+            nargs++;
+        }
+
+        lerr_arg_T arg;
+
+        switch (spec.conversion)
+        {
+            case 'd':
+            case 'i':
+                arg.i = spec.length == 'L' ? va_arg(*va, long long)
+                      : spec.length == 'l' ? va_arg(*va, long)
+                      : spec.length == 'z' ? (long long)va_arg(*va, size_t)
+                      : spec.length == 'j' ? (long long)va_arg(*va, intmax_t)
+                      : spec.length == 't' ? (long long)va_arg(*va, ptrdiff_t)
+                      : va_arg(*va, int);
+                break;
+
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                arg.u = spec.length == 'L' ? va_arg(*va, unsigned long long)
+                      : spec.length == 'l' ? va_arg(*va, unsigned long)
+                      : spec.length == 'z' ? va_arg(*va, size_t)
+                      : spec.length == 'j' ? (unsigned long long)va_arg(*va, uintmax_t)
+                      : spec.length == 't' ? (unsigned long long)va_arg(*va, ptrdiff_t)
+                      : va_arg(*va, unsigned int);
+                break;
+
+            case 'c':
+                arg.i = va_arg(*va, int);
+                break;
+
+            case 'p':
+                arg.p = va_arg(*va, void*);
+                break;
+
+            case 's':
+            {
+                const char* s = va_arg(*va, const char*);
+                long limit = spec.precision == -2 ? star : spec.precision;
+                size_t n = 0;
+
+                if (s == NULL)
+                    s = "(null)";
+
+                /* never read past the precision: the bytes need no NUL */
+                while ((limit < 0 || n < (size_t)limit) && s[n] != '\0')
+                    n++;
+
+                if (e != NULL)
+                {
+                    char* copy = e->strings + bytes;
+                    memcpy(copy, s, n);
+                    copy[n] = '\0';
+                    arg.s = copy;
+                }
+
+                bytes += n + 1;
+                break;
+            }
+
+            default:
+                arg.d = va_arg(*va, double);
+                break;
+        }
+
+        if (e != NULL)
+            e->args[nargs] = arg;
+
+        nargs++;
+    }
+
+    if (e != NULL)
+        e->nargs = nargs;
+
+    return bytes;
+}
+
+
+/**
+ * lerr_new - Error record creation
+ *
+ * Captures the arguments of "template" in a single allocation, along with
+ * copies of its string arguments. "template" itself is kept by reference and
+ * must outlive the record, as string literals do. Templates with too many
+ * arguments are formatted right away instead.
+ */
+lerr_T* lerr_new(lerrcode_E code, const char* template, va_list va)
+{
+    va_list sizing;
+    va_copy(sizing, va);
+    size_t bytes = lerr_capture(template, &sizing, NULL);
+    va_end(sizing);
+
+    lerr_T* e;
+
+    if (bytes != (size_t)-1)
+    {
+        e = malloc(sizeof(lerr_T) + bytes);
+        e->template = template;
+
+        va_list capture;
+        va_copy(capture, va);
+        lerr_capture(template, &capture, e);
+        va_end(capture);
+    }
+    else
+    {
+        va_list eager;
+        va_copy(eager, va);
+        int n = vsnprintf(NULL, 0, template, eager);
+        va_end(eager);
+
+        bytes = n > 0 ? (size_t)n + 1 : 1;
+        e = malloc(sizeof(lerr_T) + bytes);
+        e->strings[0] = '\0';
+
+        va_copy(eager, va);
+        vsnprintf(e->strings, bytes, template, eager);
+        va_end(eager);
+
+        e->template  = "%s";
+        e->nargs     = 1;
+        e->args[0].s = e->strings;
+    }
+
+    e->refs = 1;
+    e->code = code;
+
+    return e;
+}
+
+
+lerr_T* lerr_retain(lerr_T* e)
+{
+    if (e->refs > 0)
+        LEXY_REF_INC(e);
+
+    return e;
+}
+
+
+/**
+ * lerr_release - Error record reference dropping
+ *
+ * Static records (see LERR_STATIC) are never freed.
+ */
+void lerr_release(lerr_T* e)
+{
+    if (e->refs > 0 && LEXY_REF_DEC(e) == 0)
+        free(e);
+}
+
+
+#define LERR_PRINT(b, spec, star, value)                                            \
+    ((spec).stars == 0 ? lbuf_printf(b, (spec).format, value)                       \
+   : (spec).stars == 1 ? lbuf_printf(b, (spec).format, star[0], value)              \
+   :                     lbuf_printf(b, (spec).format, star[0], star[1], value))
+
+
+/**
+ * lerr_format - Error message rendering
+ *
+ * Writes the message of "e" into "b", formatting its template with the
+ * captured arguments.
+ */
+void lerr_format(lbuf_T* b, const lerr_T* e)
+{
+    const char* p = e->template;
+    const char* pct;
+    size_t k = 0;
+    lerr_spec_T spec;
+
+    while ((pct = strchr(p, '%')) != NULL)
+    {
+        lbuf_write(b, p, (size_t)(pct - p));
+
+        if (pct[1] == '%')
+        {
+            lbuf_putc(b, '%');
+            p = pct + 2;
+            continue;
+        }
+
+        p = lerr_spec(pct + 1, &spec);
+
+        if (spec.conversion == '\0' || spec.conversion == 'n' || !strchr("diouxXcsfFeEgGaAp", spec.conversion)
+            || k + spec.stars + 1 > e->nargs)
+            continue;
+
+        int star[2] = { 0, 0 };
+        for (int i = 0; i < spec.stars; i++)
+            star[i] = (int)e->args[k++].i;
+
+        lerr_arg_T arg = e->args[k++];
+
+        switch (spec.conversion)
+        {
+            case 'd':
+            case 'i':
+                LERR_PRINT(b, spec, star, arg.i);
+                break;
+
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                LERR_PRINT(b, spec, star, arg.u);
+                break;
+
+            case 'c':
+                LERR_PRINT(b, spec, star, (int)arg.i);
+                break;
+
+            case 's':
+                LERR_PRINT(b, spec, star, arg.s);
+                break;
+
+            case 'p':
+                LERR_PRINT(b, spec, star, arg.p);
+                break;
+
+            default:
+                LERR_PRINT(b, spec, star, arg.d);
+                break;
+        }
+    }
+
+    lbuf_puts(b, p);
+}
+
+
+/**
+ * lerr_status - Exit status of an error
+ *
+ * The status given to "exit" for the errors it makes, 1 for any other one.
+ */
+int lerr_status(const lerr_T* e)
+{
+    return e->code == LERR_EXIT ? (int)e->args[0].i : 1;
+}
@@ -0,0 +1,82 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_ERROR
+#define LEXY_ERROR
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "fmt.h"
+#include "type.h"
+
+
+/* arguments captured by an error; templates with more are formatted eagerly */
+#define LERR_MAX_ARGS 6
+
+/* an error without arguments, with static storage and no reference count */
+#define LERR_STATIC(code, template) { 0, code, template, 0, { { 0 } } }
+
+
+/* a captured "printf" argument; integers are widened and strings copied */
+typedef union lerr_arg_U
+{
+    long long          i;
+    unsigned long long u;
+    double             d;
+    const char*        s;
+    const void*        p;
+}
+lerr_arg_T;
+
+
+/* an error: what went wrong, and the pieces to tell it, formatted only when
+   printed. Records are immutable and shared by every copy of the value */
+struct lerr_S
+{
+    size_t         refs;
+    lerrcode_E     code;
+    const char*    template;
+    size_t         nargs;
+    lerr_arg_T     args[LERR_MAX_ARGS];
+
+    char strings[];
+};
+
+
+extern lerr_T lerr_bad_num;
+extern lerr_T lerr_div_zero;
+extern lerr_T lerr_unbound_variadic;
+
+
+lerr_T* lerr_new     (lerrcode_E code, const char* template, va_list va);
+lerr_T* lerr_retain  (lerr_T* e);
+void    lerr_release (lerr_T* e);
+void    lerr_format  (lbuf_T* b, const lerr_T* e);
+int     lerr_status  (const lerr_T* e);
+
+#endif
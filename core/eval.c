@@ -27,32 +27,43 @@
 
 #include "eval.h"
 
+#include "arena.h"
 #include "env.h"
+#include "error.h"
 #include "fmt.h"
+#include "pool.h"
+#include "prof.h"
+#include "stats.h"
+#include "str.h"
 #include "type.h"
+#include "vm.h"
 
 
 char*   ltype_nrepr (int type);
 lval_T* lval_add    (lval_T* v, lval_T* x);
+lval_T* lval_call   (lenv_T* env, lval_T* func, lval_T* args);
 lval_T* lval_new    (void);
 lval_T* lval_copy   (lval_T* val);
 void    lval_del    (lval_T* v);
 lval_T* lval_err    (const char* fmt, ...);
+lval_T* lval_errc   (lerrcode_E code, const char* fmt, ...);
+lval_T* lval_errs   (lerr_T* e);
 lval_T* lval_eval   (lenv_T* env, lval_T* value);
 lval_T* lval_evsexp (lenv_T* env, lval_T* val);
-lval_T* lval_fun    (char* name, char* description, lbtin func);
+lval_T* lval_fun    (const lbtin_meta_T* meta);
 lval_T* lval_join   (lval_T* x, lval_T* y);
 lval_T* lval_lambda (lval_T* formals, lval_T* body);
 lval_T* lval_num    (double n);
+lval_T* lval_int    (int64_t n);
+lval_T* lval_big    (lbig_T* n);
 lval_T* lval_pop    (lval_T* t, size_t i);
 lval_T* lval_qexpr  (void);
-lval_T* lval_read   (mpc_ast_t* t);
-lval_T* lval_rnum   (mpc_ast_t* t);
-lval_T* lval_rstr   (mpc_ast_t* t);
+lval_T* lval_rnumstr(const char* s);
 lval_T* lval_sexpr  (void);
 lval_T* lval_sym    (const char* s);
 lval_T* lval_take   (lval_T* t, size_t i);
 lval_T* lval_str    (char* s);
+lval_T* lval_strv   (lstr_T* s, size_t offset, size_t length);
 lval_T* btinfn_eval (lenv_T* env, lval_T* qexpr);
 lval_T* btinfn_list (lenv_T* env, lval_T* sexpr);
 
@@ -64,45 +75,121 @@ char* ltype_nrepr(int type)
 {
     switch(type)
     {
-        case LTYPE_FUN:   return "Function";
-        case LTYPE_NUM:   return "Number";
-        case LTYPE_STR:   return "String";
-        case LTYPE_ERR:   return "Error";
-        case LTYPE_SYM:   return "Symbol";
-        case LTYPE_SEXPR: return "S-Expression";
-        case LTYPE_QEXPR: return "Q-Expression";
-        default:          return "Unknown";
+        case LTYPE_FUN:     return "Function";
+        case LTYPE_NUM:     return "Number";
+        case LTYPE_INT:     return "Integer";
+        case LTYPE_BIGINT:  return "Integer";
+        case LTYPE_STR:     return "String";
+        case LTYPE_ERR:     return "Error";
+        case LTYPE_SYM:     return "Symbol";
+        case LTYPE_SEXPR:   return "S-Expression";
+        case LTYPE_QEXPR:   return "Q-Expression";
+        default:            return "Unknown";
     }
 }
 
 
+/**
+ * lval_arena_begin - Evaluation arena scope opening
+ *
+ * Every value created until the matching "lval_arena_end" is allocated in the
+ * evaluation arena of the current VM instead of the heap. Scopes may be
+ * nested; only the outermost one owns the arena contents.
+ */
+void lval_arena_begin(void)
+{
+    lexy_vm_current->arena_depth++;
+}
+
+
+/**
+ * lval_arena_end - Evaluation arena scope closing
+ *
+ * When the outermost scope is closed, every value allocated inside of it is
+ * released at once. No value created in the scope may be referenced afterwards
+ * unless it has been promoted with "lval_persist".
+ */
+void lval_arena_end(void)
+{
+    lexy_vm_T* vm = lexy_vm_current;
+
+    if (--vm->arena_depth == 0)
+        arena_reset(vm->arena);
+}
+
+
 lval_T* lval_new(void)
 {
-    lval_T* v    = malloc(sizeof(struct lval_S));
+    lval_T* v;
+    lexy_vm_T* vm = lexy_vm_current;
+
+    /* values created outside of any VM (or being persisted) go to the heap */
+    if (vm != NULL && vm->arena_depth > 0 && vm->persist_depth == 0)
+    {
+        v = arena_alloc(vm->arena);
+        v->in_arena = TRUE;
+    }
+    else
+    {
+        v = malloc(sizeof(struct lval_S));
+        v->in_arena = FALSE;
+    }
+
     v->condition = LCOND_UNSET;
     v->error     = NULL;
+    v->name      = NULL;
 
+    STATS_INC(lval_new);
     return v;
 }
 
 
 /**
- * lval_fun - TL function representation
+ * lval_free - TL value node release
  *
- * Constructs a pointer to a new TL function representation.
+ * Gives the node memory back to wherever it came from (arena or heap).
  */
-lval_T* lval_fun(char* name, char* description, lbtin func)
+static void lval_free(lval_T* v)
 {
-    lval_T* v  = lval_new();
-    v->type    = LTYPE_FUN;
-    v->builtin = func;
+    if (v->in_arena)
+        arena_release(lexy_vm_current->arena, v);
+    else
+        free(v);
+}
 
-    v->btin_meta = malloc(sizeof(struct lbtin_meta_S));
-    v->btin_meta->name = malloc(strlen(name) + 1);
-    v->btin_meta->description = malloc(strlen(description) + 1);
 
-    strcpy(v->btin_meta->name, name);
-    strcpy(v->btin_meta->description, description);
+/**
+ * lval_persist - TL value promotion
+ *
+ * Deep copies a value onto the heap, so it outlives the evaluation arena.
+ */
+lval_T* lval_persist(lval_T* val)
+{
+    lexy_vm_T* vm = lexy_vm_current;
+    if (vm == NULL)
+        return lval_copy(val);
+
+    vm->persist_depth++;
+    lval_T* nval = lval_copy(val);
+    vm->persist_depth--;
+
+    return nval;
+}
+
+
+/**
+ * lval_fun - TL function representation
+ *
+ * Constructs a pointer to a new TL built-in function representation. The
+ * description is static, so it is shared (and never copied) by every value.
+ */
+lval_T* lval_fun(const lbtin_meta_T* meta)
+{
+    lval_T* v    = lval_new();
+    v->type      = LTYPE_FUN;
+    v->condition = LCOND_CONSTANT;
+    v->builtin   = meta->function;
+    v->btin_meta = meta;
 
     return v;
 }
@@ -118,6 +205,7 @@ lval_T* lval_lambda(lval_T* formals, lval_T* body)
     lval_T* v      = lval_new();
     v->type        = LTYPE_FUN;
     v->builtin     = NULL;
+    v->name        = NULL;
     v->formals     = formals;
     v->body        = body;
     v->environment = lenv_new();
@@ -141,35 +229,130 @@ lval_T* lval_num(double n)
 }
 
 
-lval_T* lval_str(char* s)
+/**
+ * lval_int - TL integer representation
+ *
+ * Constructs a pointer to a new TL 64-bit integer representation.
+ */
+lval_T* lval_int(int64_t n)
 {
+    lval_T* v  = lval_new();
+    v->type    = LTYPE_INT;
+    v->integer = n;
+
+    return v;
+}
+
+
+/**
+ * lval_big - TL big integer representation
+ *
+ * Takes ownership of "n". Values that fit in 64 bits are narrowed back to a
+ * plain integer, so a big integer always lies outside of that range.
+ */
+lval_T* lval_big(lbig_T* n)
+{
+    int64_t small;
+
+    if (big_to_int(n, &small))
+    {
+        big_del(n);
+        return lval_int(small);
+    }
+
     lval_T* v = lval_new();
-    v->type   = LTYPE_STR;
-    v->string = malloc(strlen(s) + 1);
+    v->type   = LTYPE_BIGINT;
+    v->bigint = n;
 
-    strcpy(v->string, s);
     return v;
 }
 
 
+lval_T* lval_str(char* s)
+{
+    size_t length = strlen(s);
+    return lval_strv(lstr_new(s, length), 0, length);
+}
+
+
+/**
+ * lval_strv - TL string view representation
+ *
+ * Constructs a string over "length" bytes of "s" starting at "offset", taking
+ * over the reference to "s". Views share their storage, so substrings and
+ * copies never copy bytes.
+ */
+lval_T* lval_strv(lstr_T* s, size_t offset, size_t length)
+{
+    lval_T* v     = lval_new();
+    v->type       = LTYPE_STR;
+    v->string     = s;
+    v->str_offset = offset;
+    v->str_length = length;
+
+    return v;
+}
+
+
+/**
+ * lval_strptr - TL string contents
+ *
+ * Returns the first of the "str_length" bytes of a string, flattening its
+ * storage first when it is a rope. The bytes are not NUL terminated.
+ */
+const char* lval_strptr(lval_T* v)
+{
+    if (v->string->left != NULL)
+        v->string = lstr_flatten(v->string);
+
+    return v->string->data + v->str_offset;
+}
+
+
 /**
  * lval_err - TL error representation
  *
- * Constructs a pointer to a new TL error representation.
+ * Constructs a pointer to a new TL error representation. The message is only
+ * formatted when printed, so "fmt" must be a string literal (or otherwise
+ * outlive the error); its arguments are captured right away.
  */
 lval_T* lval_err(const char* fmt, ...)
 {
-    lval_T* v = lval_new();
-    v->type   = LTYPE_ERR;
+    va_list va;
+    va_start(va, fmt);
+
+    lval_T* v = lval_errs(lerr_new(LERR_GENERIC, fmt, va));
+
+    va_end(va);
+    return v;
+}
 
+
+/**
+ * lval_errc - TL error representation, with an error code
+ */
+lval_T* lval_errc(lerrcode_E code, const char* fmt, ...)
+{
     va_list va;
     va_start(va, fmt);
 
-    v->error = malloc(ERROR_MESSAGE_BYTE_LENGTH);
-    vsnprintf(v->error, (ERROR_MESSAGE_BYTE_LENGTH - 1), fmt, va);
+    lval_T* v = lval_errs(lerr_new(code, fmt, va));
 
-    v->error = realloc(v->error, strlen(v->error) + 1);
     va_end(va);
+    return v;
+}
+
+
+/**
+ * lval_errs - TL error representation, from an error record
+ *
+ * Takes over the reference to "e"; static records cost no allocation at all.
+ */
+lval_T* lval_errs(lerr_T* e)
+{
+    lval_T* v = lval_new();
+    v->type   = LTYPE_ERR;
+    v->error  = e;
 
     return v;
 }
@@ -224,69 +407,32 @@ lval_T* lval_qexpr(void)
 
 
 /**
- * lval_read - TL value reading
+ * lval_rnumstr - TL numeric value parsing
+ *
+ * Reads a number written as a literal from a NUL-terminated string.
  */
-lval_T* lval_read(mpc_ast_t* t)
+lval_T* lval_rnumstr(const char* s)
 {
-    if (strstr(t->tag, "number"))
-        return lval_rnum(t);
-
-    if (strstr(t->tag, "string"))
-        return lval_rstr(t);
-
-    if (strstr(t->tag, "symbol"))
-        return lval_sym(t->contents);
-
-    lval_T* x = NULL;
-    if (strequ(t->tag, ">") || strstr(t->tag, "sexpr"))
-        x = lval_sexpr();
-
-    if (strstr(t->tag, "qexpr"))
-        x = lval_qexpr();
+    errno = 0;
 
-    for (int i = 0; i < t->children_num; i++)
+    /* literals without a fractional part are exact integers, and only the
+       ones that do not fit in 64 bits pay for a big integer */
+    if (strchr(s, '.') == NULL)
     {
-        if (strequ(t->children[i]->contents, "("))  continue;
-        if (strequ(t->children[i]->contents, ")"))  continue;
-        if (strequ(t->children[i]->contents, "{"))  continue;
-        if (strequ(t->children[i]->contents, "}"))  continue;
-        if (strequ(t->children[i]->tag, "regex"))   continue;
-        if (strstr(t->children[i]->tag, "comment")) continue;
-
-        x = lval_add(x, lval_read(t->children[i]));
-    }
-
-    return x;
-}
+        long long n = strtoll(s, NULL, 10);
 
+        return errno != ERANGE
+            ? lval_int(n)
+            : lval_big(big_from_str(s));
+    }
 
-/**
- * lval_rnum - TL numeric value reading
- */
-lval_T* lval_rnum(mpc_ast_t* t)
-{
-    errno = 0;
-    double f = strtof(t->contents, NULL);
+    double f = strtod(s, NULL);
 
     return errno != ERANGE
         ? lval_num(f)
-        : lval_err(TLERR_BAD_NUM);
+        : lval_errs(&lerr_bad_num);
 }
 
-lval_T* lval_rstr(mpc_ast_t* t)
-{
-    t->contents[strlen(t->contents) - 1] = '\0';
-    char* unescaped = malloc(strlen(t->contents + 1) + 1);
-    strcpy(unescaped, t->contents + 1);
-
-    unescaped = mpcf_unescape(unescaped);
-    lval_T* str = lval_str(unescaped);
-
-    free(unescaped);
-    return str;
-}
-
-
 /**
  * lval_add - TL value addition
  *
@@ -311,7 +457,12 @@ void lval_del(lval_T* v)
 {
     switch(v->type)
     {
-        case LTYPE_NUM: break;
+        case LTYPE_NUM:
+        case LTYPE_INT: break;
+
+        case LTYPE_BIGINT:
+            big_del(v->bigint);
+            break;
 
         case LTYPE_FUN:
             if (!v->builtin)
@@ -319,15 +470,16 @@ void lval_del(lval_T* v)
                 lenv_del(v->environment);
                 lval_del(v->formals);
                 lval_del(v->body);
+                free(v->name);
             }
             break;
 
         case LTYPE_STR:
-            free(v->string);
+            lstr_release(v->string);
             break;
 
         case LTYPE_ERR:
-            free(v->error);
+            lerr_release(v->error);
             break;
 
         case LTYPE_SYM:
@@ -343,7 +495,8 @@ void lval_del(lval_T* v)
             break;
     }
 
-    free(v);
+    STATS_INC(lval_del);
+    lval_free(v);
 }
 
 
@@ -354,10 +507,12 @@ void lval_del(lval_T* v)
  */
 lval_T* lval_copy(lval_T* val)
 {
-    lval_T* nval = malloc(sizeof(struct lval_S));
+    lval_T* nval = lval_new();
     nval->type = val->type;
     nval->condition = val->condition;
 
+    STATS_INC(lval_copy);
+
     switch(val->type)
     {
         case LTYPE_FUN:
@@ -372,6 +527,13 @@ lval_T* lval_copy(lval_T* val)
                 nval->environment = lenv_copy(val->environment);
                 nval->formals     = lval_copy(val->formals);
                 nval->body        = lval_copy(val->body);
+                nval->name        = NULL;
+
+                if (val->name != NULL)
+                {
+                    nval->name = malloc(strlen(val->name) + 1);
+                    strcpy(nval->name, val->name);
+                }
             }
             break;
 
@@ -379,14 +541,22 @@ lval_T* lval_copy(lval_T* val)
             nval->number = val->number;
             break;
 
+        case LTYPE_INT:
+            nval->integer = val->integer;
+            break;
+
+        case LTYPE_BIGINT:
+            nval->bigint = big_copy(val->bigint);
+            break;
+
         case LTYPE_STR:
-            nval->string = malloc(strlen(val->string) +1);
-            strcpy(nval->string, val->string);
+            nval->string     = lstr_retain(val->string);
+            nval->str_offset = val->str_offset;
+            nval->str_length = val->str_length;
             break;
 
         case LTYPE_ERR:
-            nval->error = malloc(strlen(val->error) + 1);
-            strcpy(nval->error, val->error);
+            nval->error = lerr_retain(val->error);
             break;
 
         case LTYPE_SYM:
@@ -461,7 +631,17 @@ lval_T* lval_join(lval_T* x, lval_T* y)
 lval_T* lval_call(lenv_T* env, lval_T* func, lval_T* args)
 {
     if (func->builtin)
-        return func->builtin(env, args);
+    {
+        STATS_CALL(func->btin_meta->name, TRUE);
+        PROF_ENTER(func->btin_meta->name);
+
+        lval_T* res = func->builtin(env, args);
+
+        PROF_LEAVE();
+        return res;
+    }
+
+    STATS_CALL(func->name ? func->name : STATS_ANONYMOUS_FN, FALSE);
 
     size_t given = args->counter;
     size_t total = func->formals->counter;
@@ -471,7 +651,7 @@ lval_T* lval_call(lenv_T* env, lval_T* func, lval_T* args)
         if (func->formals->counter == 0)
         {
             lval_del(args);
-            return lval_err(
+            return lval_errc(LERR_BAD_ARGS,
                 "function has taken too many arguments."
                 "Got %lu, expected %lu", given, total);
         }
@@ -483,11 +663,12 @@ lval_T* lval_call(lenv_T* env, lval_T* func, lval_T* args)
             if (func->formals->counter != 1)
             {
                 lval_del(args);
-                return lval_err(TLERR_UNBOUND_VARIADIC);
+                return lval_errs(&lerr_unbound_variadic);
             }
 
+            /* the list is "args" itself, deleted after the loop */
             lval_T* nsym = lval_pop(func->formals, 0);
-            lenv_put(func->environment, nsym, btinfn_list(env, args), LCOND_DYNAMIC);
+            lval_del(lenv_put(func->environment, nsym, btinfn_list(env, args), LCOND_DYNAMIC));
 
             lval_del(symbol);
             lval_del(nsym);
@@ -497,7 +678,7 @@ lval_T* lval_call(lenv_T* env, lval_T* func, lval_T* args)
 
         lval_T* value  = lval_pop(args, 0);
 
-        lenv_put(func->environment, symbol, value, value->condition);
+        lval_del(lenv_put(func->environment, symbol, value, value->condition));
 
         lval_del(symbol);
         lval_del(value);
@@ -508,14 +689,14 @@ lval_T* lval_call(lenv_T* env, lval_T* func, lval_T* args)
     if (func->formals->counter > 0 && strequ(func->formals->cell[0]->symbol, "&"))
     {
         if (func->formals->counter != 2)
-            return lval_err(TLERR_UNBOUND_VARIADIC);
+            return lval_errs(&lerr_unbound_variadic);
 
         lval_del(lval_pop(func->formals, 0));
 
         lval_T* symbol = lval_pop(func->formals, 0);
         lval_T* value  = lval_qexpr();
 
-        lenv_put(func->environment, symbol, value, LCOND_DYNAMIC);
+        lval_del(lenv_put(func->environment, symbol, value, LCOND_DYNAMIC));
 
         lval_del(symbol);
         lval_del(value);
@@ -524,7 +705,12 @@ lval_T* lval_call(lenv_T* env, lval_T* func, lval_T* args)
     if (func->formals->counter == 0)
     {
         func->environment->parent = env;
-        return btinfn_eval(func->environment, lval_add(lval_sexpr(), lval_copy(func->body)));
+        PROF_ENTER(func->name ? func->name : STATS_ANONYMOUS_FN);
+
+        lval_T* res = btinfn_eval(func->environment, lval_add(lval_sexpr(), lval_copy(func->body)));
+
+        PROF_LEAVE();
+        return res;
     }
 
     return lval_copy(func);
@@ -552,15 +738,19 @@ lval_T* lval_eval(lenv_T* env, lval_T* value)
 
 /**
  * lval_evsexp - TL S-Expression evaluation
+ *
+ * Cells are evaluated from left to right and the first error is returned at
+ * once: the cells after it are discarded without being evaluated.
  */
 lval_T* lval_evsexp(lenv_T* env, lval_T* val)
 {
     for (size_t i = 0; i < val->counter; i++)
+    {
         val->cell[i] = lval_eval(env, val->cell[i]);
 
-    for (size_t i = 0; i < val->counter; i++)
         if (val->cell[i]->type == LTYPE_ERR)
             return lval_take(val, i);
+    }
 
     if (val->counter == 0)
         return val;
@@ -571,7 +761,7 @@ lval_T* lval_evsexp(lenv_T* env, lval_T* val)
     lval_T* element = lval_pop(val, 0);
     if (element->type != LTYPE_FUN)
     {
-        lval_T* err = lval_err(
+        lval_T* err = lval_errc(LERR_NOT_FUNCTION,
             "S-Expression start with incorrect type. "
             "Got '%s', expected '%s'.",
             ltype_nrepr(element->type), ltype_nrepr(LTYPE_FUN));
@@ -589,16 +779,144 @@ lval_T* lval_evsexp(lenv_T* env, lval_T* val)
 }
 
 
+/* cells being evaluated by a parallel loop, and the environment they share */
+typedef struct lval_par_S
+{
+    lenv_T*  env;
+    lval_T*  func;
+    lval_T** cells;
+}
+lval_par_T;
+
+
+static void lval_evpar_task(void* data, size_t i)
+{
+    lval_par_T* par = data;
+
+    lenv_T* child    = lenv_new();
+    child->parent    = par->env;
+    child->exec_type = par->env->exec_type;
+
+    if (par->func == NULL)
+        par->cells[i] = lval_eval(child, par->cells[i]);
+    else
+    {
+        lval_T* func = lval_copy(par->func);
+        par->cells[i] = lval_call(child, func, lval_add(lval_sexpr(), par->cells[i]));
+        lval_del(func);
+    }
+
+    lenv_del(child);
+}
+
+
+/**
+ * lval_evpar - TL parallel evaluation
+ *
+ * Evaluates every cell of "val" in place, each one in its own child of "env",
+ * over "workers" threads (0 for the default), "chunk" cells at a time. When
+ * "func" is given, each cell is instead replaced by "func" called with it.
+ *
+ * Tasks run outside of the VM: what they create lives on the heap, and they
+ * can read the environment but must not define globals, so the cells (and
+ * "func") are detached from the arena first.
+ */
+void lval_evpar(lenv_T* env, lval_T* func, lval_T* val, size_t workers, size_t chunk)
+{
+    for (size_t i = 0; i < val->counter; i++)
+    {
+        lval_T* cell = lval_persist(val->cell[i]);
+        lval_del(val->cell[i]);
+        val->cell[i] = cell;
+    }
+
+    lval_par_T par = { env, func ? lval_persist(func) : NULL, val->cell };
+
+    lexy_vm_T* vm = lexy_vm_enter(NULL);
+    pool_for(val->counter, chunk, workers, lval_evpar_task, &par);
+    lexy_vm_leave(vm);
+
+    if (par.func != NULL)
+        lval_del(par.func);
+}
+
+
+/**
+ * lval_numcmp - TL numeric value comparison
+ *
+ * Returns -1, 0 or 1. Integers are compared exactly; anything involving a
+ * floating-point number is compared as doubles.
+ */
+int lval_numcmp(lval_T* a, lval_T* b)
+{
+    double x, y;
+
+    if (a->type == LTYPE_INT && b->type == LTYPE_INT)
+        return (a->integer > b->integer) - (a->integer < b->integer);
+
+    if (a->type == LTYPE_BIGINT && b->type == LTYPE_BIGINT)
+        return big_cmp(a->bigint, b->bigint);
+
+    /* a big integer is always out of the 64-bit range, so its sign decides */
+    if (a->type == LTYPE_BIGINT && b->type == LTYPE_INT)
+        return a->bigint->negative ? -1 : 1;
+
+    if (a->type == LTYPE_INT && b->type == LTYPE_BIGINT)
+        return b->bigint->negative ? 1 : -1;
+
+    x = LVAL_AS_DOUBLE(a);
+    y = LVAL_AS_DOUBLE(b);
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * lval_erreq - TL error equality
+ *
+ * Errors are equal when they have the same code and the same message.
+ */
+static int lval_erreq(lerr_T* a, lerr_T* b)
+{
+    char sa[LVAL_PRINT_BUFFER_BYTES], sb[LVAL_PRINT_BUFFER_BYTES];
+    lbuf_T x, y;
+
+    if (a == b)
+        return 1;
+
+    if (a->code != b->code)
+        return 0;
+
+    lbuf_init(&x, sa, sizeof(sa));
+    lbuf_init(&y, sb, sizeof(sb));
+    lerr_format(&x, a);
+    lerr_format(&y, b);
+
+    int equal = strequ(x.data, y.data);
+
+    lbuf_free(&x);
+    lbuf_free(&y);
+    return equal;
+}
+
+
 int lval_eq(lval_T* a, lval_T* b)
 {
+    if (LVAL_IS_NUMERIC(a) && LVAL_IS_NUMERIC(b) && a->type != b->type)
+        return lval_numcmp(a, b) == 0;
+
     if (a->type != b->type)
         return 0;
 
     switch(a->type)
     {
         case LTYPE_NUM: return a->number == b->number;
-        case LTYPE_STR: return strequ(a->string, b->string);
-        case LTYPE_ERR: return strequ(a->error, b->error);
+        case LTYPE_INT: return a->integer == b->integer;
+        case LTYPE_BIGINT: return big_cmp(a->bigint, b->bigint) == 0;
+        case LTYPE_STR:
+            return a->str_length == b->str_length
+                && memcmp(lval_strptr(a), lval_strptr(b), a->str_length) == 0;
+
+        case LTYPE_ERR: return lval_erreq(a->error, b->error);
         case LTYPE_SYM: return strequ(a->symbol, b->symbol);
 
         case LTYPE_FUN:
@@ -621,72 +939,148 @@ int lval_eq(lval_T* a, lval_T* b)
     return 0;
 }
 
-void lval_exp_print(lenv_T* e, lval_T* t)
+/**
+ * lval_render_paint - Coloured token rendering
+ */
+static void lval_render_paint(lbuf_T* b, bool colours, const char* colour, const char* text)
+{
+    if (colours)
+        lbuf_puts(b, colour);
+
+    lbuf_puts(b, text);
+
+    if (colours)
+        lbuf_puts(b, ANSI_RESET);
+}
+
+
+static void lval_render_exp(lbuf_T* b, lval_T* t, bool colours)
 {
     for (size_t i = 0; i < t->counter; i++)
     {
-        lval_print(e, t->cell[i]);
+        lval_render(b, t->cell[i], colours);
         if (i != (t->counter - 1))
-            printf(" ");
+            lbuf_putc(b, ' ');
     }
 }
 
 
-void lval_print(lenv_T* e, lval_T* t)
+/**
+ * lval_render - TL value serialization
+ *
+ * Appends the printed representation of a value to a text buffer, with the
+ * REPL colours when "colours" is set.
+ */
+void lval_render(lbuf_T* b, lval_T* t, bool colours)
 {
-    unsigned short int exec_is_repl = e->exec_type == LEXEC_REPL;
+    char* digits;
 
     switch(t->type)
     {
         case LTYPE_FUN:
             if (t->builtin)
             {
-                printf("<builtin(%s): %s>", t->btin_meta->name, t->btin_meta->description);
+                lbuf_printf(b, "<builtin(%s): %s>", t->btin_meta->name, t->btin_meta->description);
                 return;
             }
 
-            CYAN_TXT(exec_is_repl, "%s", "(");
-            printf("lambda ");
+            lval_render_paint(b, colours, ANSI_COLOR_CYAN, "(");
+            lbuf_puts(b, "lambda ");
 
-            lval_print(e, t->formals);
-            printf(" ");
+            lval_render(b, t->formals, colours);
+            lbuf_putc(b, ' ');
 
-            lval_print(e, t->body);
-            CYAN_TXT(exec_is_repl, "%s", ")");
+            lval_render(b, t->body, colours);
+            lval_render_paint(b, colours, ANSI_COLOR_CYAN, ")");
             break;
 
         case LTYPE_NUM:
-            if (isvint(t->number)) {
-                GREEN_TXT(exec_is_repl, "%ld", (long)round(t->number));
-                break;
-            }
+            if (colours)
+                lbuf_puts(b, ANSI_COLOR_GREEN);
+
+            if (isvint(t->number) && fabs(t->number) < INTEGER_PRINT_LIMIT)
+                lbuf_printf(b, "%ld", (long)round(t->number));
+            else if (isvint(t->number))
+                lbuf_printf(b, "%.0f", t->number);
+            else
+                lbuf_printf(b, "%lf", t->number);
 
-            GREEN_TXT(exec_is_repl, "%lf", t->number);
+            if (colours)
+                lbuf_puts(b, ANSI_RESET);
+            break;
+
+        case LTYPE_INT:
+            if (colours)
+                lbuf_puts(b, ANSI_COLOR_GREEN);
+
+            lbuf_printf(b, "%lld", (long long)t->integer);
+
+            if (colours)
+                lbuf_puts(b, ANSI_RESET);
+            break;
+
+        case LTYPE_BIGINT:
+            if (colours)
+                lbuf_puts(b, ANSI_COLOR_GREEN);
+
+            digits = big_to_str(t->bigint);
+            lbuf_puts(b, digits);
+            free(digits);
+
+            if (colours)
+                lbuf_puts(b, ANSI_RESET);
             break;
 
         case LTYPE_STR:
-            BLUE_TXT(exec_is_repl, "\"%s\"", t->string);
+            if (colours)
+                lbuf_puts(b, ANSI_COLOR_BLUE);
+
+            lbuf_putc(b, '"');
+            lbuf_write(b, lval_strptr(t), t->str_length);
+            lbuf_putc(b, '"');
+
+            if (colours)
+                lbuf_puts(b, ANSI_RESET);
             break;
 
         case LTYPE_ERR:
-            RED_TXT(exec_is_repl, "%s", "ILLEGAL INSTRUCTION: ");
-            printf("%s", t->error);
+            lval_render_paint(b, colours, ANSI_COLOR_RED, "ILLEGAL INSTRUCTION: ");
+            lerr_format(b, t->error);
             break;
 
         case LTYPE_SYM:
-            printf("%s", t->symbol);
+            lbuf_puts(b, t->symbol);
             break;
 
         case LTYPE_QEXPR:
-            YELLOW_TXT(exec_is_repl, "%s", "{");
-            lval_exp_print(e, t);
-            YELLOW_TXT(exec_is_repl, "%s", "}");
+            lval_render_paint(b, colours, ANSI_COLOR_YELLOW, "{");
+            lval_render_exp(b, t, colours);
+            lval_render_paint(b, colours, ANSI_COLOR_YELLOW, "}");
             break;
 
         case LTYPE_SEXPR:
-            CYAN_TXT(exec_is_repl, "%s", "(");
-            lval_exp_print(e, t);
-            CYAN_TXT(exec_is_repl, "%s", ")");
+            lval_render_paint(b, colours, ANSI_COLOR_CYAN, "(");
+            lval_render_exp(b, t, colours);
+            lval_render_paint(b, colours, ANSI_COLOR_CYAN, ")");
             break;
     }
 }
+
+
+/**
+ * lval_print - TL value printing
+ *
+ * Renders the whole value first and writes it to STDOUT at once.
+ */
+void lval_print(lenv_T* e, lval_T* t)
+{
+    char storage[LVAL_PRINT_BUFFER_BYTES];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+
+    lval_render(&b, t, e->exec_type == LEXEC_REPL);
+
+    lbuf_flush(&b, stdout);
+    lbuf_free(&b);
+}
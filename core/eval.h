@@ -28,11 +28,24 @@
 #ifndef LEXY_EVAL
 #define LEXY_EVAL
 
+#include "bigint.h"
+#include "error.h"
+#include "fmt.h"
 #include "mpc.h"
+#include "str.h"
 #include "type.h"
 
 
-#define ERROR_MESSAGE_BYTE_LENGTH 512
+/* numeric values: floating-point numbers and exact integers, which are kept
+   in 64 bits and only spill to a big integer when they do not fit */
+#define LVAL_IS_INTEGER(v) ((v)->type == LTYPE_INT || (v)->type == LTYPE_BIGINT)
+#define LVAL_IS_NUMERIC(v) ((v)->type == LTYPE_NUM || LVAL_IS_INTEGER(v))
+#define LVAL_AS_DOUBLE(v)  ((v)->type == LTYPE_INT    ? (double)(v)->integer        \
+                          : (v)->type == LTYPE_BIGINT ? big_to_double((v)->bigint) \
+                          : (v)->number)
+
+/* bytes rendered on the stack before "lval_print" moves to the heap */
+#define LVAL_PRINT_BUFFER_BYTES 512
 
 int     lval_eq    (lval_T* a, lval_T* b);
 void    lval_print (lenv_T* e, lval_T* t);
@@ -41,10 +54,25 @@ void    lval_del   (lval_T* v);
 lenv_T* lenv_new   (void);
 lval_T* lval_new   (void);
 lval_T* lval_sexpr (void);
-lval_T* lval_read  (mpc_ast_t* t);
 lval_T* lval_add   (lval_T* v, lval_T* x);
 lval_T* lval_eval  (lenv_T* env, lval_T* value);
 lval_T* lval_err   (const char* fmt, ...);
+lval_T* lval_errc  (lerrcode_E code, const char* fmt, ...);
+lval_T* lval_errs  (lerr_T* e);
 lval_T* lval_str   (char* s);
+lval_T* lval_strv  (lstr_T* s, size_t offset, size_t length);
+lval_T* lval_int   (int64_t n);
+lval_T* lval_big   (lbig_T* n);
+lval_T* lval_num   (double n);
+
+void    lval_arena_begin (void);
+void    lval_arena_end   (void);
+lval_T* lval_persist     (lval_T* val);
+void    lval_render      (lbuf_T* b, lval_T* t, bool colours);
+void    lval_evpar       (lenv_T* env, lval_T* func, lval_T* val, size_t workers, size_t chunk);
+lval_T* lval_rnumstr     (const char* s);
+int     lval_numcmp      (lval_T* a, lval_T* b);
+
+const char* lval_strptr  (lval_T* v);
 
 #endif
@@ -26,7 +26,9 @@
  */
 
 #include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "fmt.h"
@@ -52,3 +54,115 @@ unsigned short int isvint(const double d)
 {
     return fabs(round(d) - d) <= INTEGER_FLOAT_EPSILON;
 }
+
+
+/**
+ * lbuf_init - text buffer initialization
+ *
+ * "storage" (of "size" bytes, at least one) is used until the text outgrows it
+ */
+void lbuf_init(lbuf_T* b, char* storage, size_t size)
+{
+    b->data     = storage;
+    b->length   = 0;
+    b->capacity = size;
+    b->on_heap  = 0;
+
+    b->data[0] = '\0';
+}
+
+
+void lbuf_free(lbuf_T* b)
+{
+    if (b->on_heap)
+        free(b->data);
+
+    b->data = NULL;
+}
+
+
+/* makes room for "extra" more bytes plus the terminator */
+static void lbuf_reserve(lbuf_T* b, size_t extra)
+{
+    if (b->length + extra < b->capacity)
+        return;
+
+    size_t ncapacity = b->capacity * 2;
+    while (b->length + extra >= ncapacity)
+        ncapacity *= 2;
+
+    if (b->on_heap)
+        b->data = realloc(b->data, ncapacity);
+    else
+    {
+        char* data = malloc(ncapacity);
+        memcpy(data, b->data, b->length + 1);
+
+        b->data    = data;
+        b->on_heap = 1;
+    }
+
+    b->capacity = ncapacity;
+}
+
+
+void lbuf_putc(lbuf_T* b, char c)
+{
+    lbuf_reserve(b, 1);
+
+    b->data[b->length++] = c;
+    b->data[b->length]   = '\0';
+}
+
+
+void lbuf_puts(lbuf_T* b, const char* s)
+{
+    lbuf_write(b, s, strlen(s));
+}
+
+
+void lbuf_write(lbuf_T* b, const char* s, size_t n)
+{
+    lbuf_reserve(b, n);
+
+    memcpy(b->data + b->length, s, n);
+    b->length += n;
+    b->data[b->length] = '\0';
+}
+
+
+void lbuf_printf(lbuf_T* b, const char* fmt, ...)
+{
+    va_list va, retry;
+    va_start(va, fmt);
+    va_copy(retry, va);
+
+    size_t room = b->capacity - b->length;
+    int n = vsnprintf(b->data + b->length, room, fmt, va);
+
+    if (n > 0 && (size_t)n >= room)
+    {
+        lbuf_reserve(b, n);
+        vsnprintf(b->data + b->length, b->capacity - b->length, fmt, retry);
+    }
+
+    if (n > 0)
+        b->length += n;
+
+    va_end(retry);
+    va_end(va);
+}
+
+
+/**
+ * lbuf_flush - text buffer output
+ *
+ * writes the whole text with a single call and empties the buffer
+ */
+void lbuf_flush(lbuf_T* b, FILE* out)
+{
+    fwrite(b->data, 1, b->length, out);
+
+    b->length  = 0;
+    b->data[0] = '\0';
+}
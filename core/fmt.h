@@ -28,10 +28,16 @@
 #ifndef LEXY_FMT
 #define LEXY_FMT
 
+#include <stddef.h>
+#include <stdio.h>
+
 
 /* maximum tolerance value for what constitutes a "whole number" */
 #define INTEGER_FLOAT_EPSILON 0.000001
 
+/* whole numbers beyond this magnitude do not fit in a "long" when printed */
+#define INTEGER_PRINT_LIMIT 1e18
+
 #ifdef LEXY_NO_COLORS
 /* --- */
 #define COLOURED_TXT(must_apply, colour, text, ...) \
@@ -96,6 +102,28 @@
 #define BOLD_TXT(must_apply, text, ...) \
     COLOURED_TXT(must_apply, ANSI_STYLE_BOLD, text, __VA_ARGS__);
 
+/* growable text buffer; starts on storage given by the caller (usually the
+   stack) and only moves to the heap when it outgrows it */
+typedef struct lbuf_S
+{
+    char*  data;
+    size_t length;
+    size_t capacity;
+
+    unsigned short int on_heap;
+}
+lbuf_T;
+
+
+/* ... */
+void lbuf_init   (lbuf_T* b, char* storage, size_t size);
+void lbuf_free   (lbuf_T* b);
+void lbuf_putc   (lbuf_T* b, char c);
+void lbuf_puts   (lbuf_T* b, const char* s);
+void lbuf_write  (lbuf_T* b, const char* s, size_t n);
+void lbuf_printf (lbuf_T* b, const char* fmt, ...);
+void lbuf_flush  (lbuf_T* b, FILE* out);
+
 /* ... */
 unsigned short int strequ(const char* ref, const char* txt);
 unsigned short int isvint(double f);
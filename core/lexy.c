@@ -27,15 +27,21 @@
 
 #include <getopt.h>
 #include <signal.h>
+#include <string.h>
 
 #include "meta.h"
 
+#include "env.h"
 #include "eval.h"
-#include "parser.h"
 #include "fmt.h"
+#include "prof.h"
+#include "reader.h"
+#include "stats.h"
 #include "type.h"
+#include "vm.h"
 
 #define PROMPT_DISPLAY  " ] "
+#define PROMPT_CONTINUE " . "
 #define PROMPT_RESPONSE "~> "
 
 
@@ -43,53 +49,85 @@
 #include <editline/readline.h>
 
 #else
-#include <string.h>
-
-static char buffer[2048];
-
 void add_history(char* unused) {}
 
 char* readline(char* prompt)
 {
     fputs(prompt, stdout);
-    fgets(buffer, 2048, stdin);
-
-    char* cpy = malloc(strlen(buffer) + 1);
-    strcpy(cpy, buffer);
-    cpy[strlen(cpy) -1] = '\0';
+    fflush(stdout);
 
-    return cpy;
+    return lreader_getline(stdin);
 }
 #endif
 
 
-lenv_T* lexy_current_env = NULL;
+/* characters that separate the arguments of a "--batch" line */
+#define BATCH_ARG_DELIMS " \t\r"
+
+
+lexy_vm_T* lexy_vm = NULL;
 
 lval_T* btinfn_load (lenv_T* env, lval_T* args);
+lval_T* lval_copy   (lval_T* v);
 lval_T* lval_pop    (lval_T* t, size_t i);
+lval_T* lval_qexpr  (void);
+lval_T* lval_sym    (const char* s);
 
 
 static void lexy_clean_exit(int sign)
 {
-    parser_safe_cleanup();
-
-    if (lexy_current_env != NULL)
-        free(lexy_current_env);
+    if (lexy_vm != NULL)
+        lexy_vm_del(lexy_vm);
 
     exit(0);
 }
 
 
+static void lexy_debug_report(void)
+{
+    stats_report(stderr);
+}
+
+
+static void lexy_prof_report(void)
+{
+    prof_stop();
+
+    FILE* folded = fopen(PROF_FOLDED_FILE, "w");
+    if (folded == NULL)
+        fprintf(stderr, "\ncould not write the folded stacks to '%s'\n", PROF_FOLDED_FILE);
+
+    prof_report(folded, stderr);
+
+    if (folded != NULL)
+    {
+        fclose(folded);
+        fprintf(stderr, "\nfolded stacks written to '%s'\n", PROF_FOLDED_FILE);
+    }
+}
+
+
+static bool lexy_is_exit(lval_T* v)
+{
+    return v != NULL && v->type == LTYPE_ERR && v->error->code == LERR_EXIT;
+}
+
+
 static int lexy_help_message(int ret_code, char* bin_filename)
 {
-    printf("\nUsage %s [options] [script.lisp] [arguments]\n\n"
+    printf("\nUsage %s [options] [script.lisp | -] [arguments]\n"
+           "      %s --batch script.lisp < argument-lines\n\n"
            "-h : show this help\n"
            "-v : print the lexy version\n"
            "-r : print release information\n"
-           "-d : enable the debug mode\n"
+           "-d : enable the debug mode (instrumentation report at exit)\n"
+           "-p : profile the program (folded stacks written to " PROF_FOLDED_FILE ")\n"
            "-e code : evaluate and execute a string of lexy\n"
+           "-       : read the program from the standard input\n"
+           "--batch : run the script once per line of the standard input, with\n"
+           "          the words of the line as arguments\n"
            "\nThis project can be found at <https://github.com/caian-org/lexy>\n\n",
-           bin_filename);
+           bin_filename, bin_filename);
 
     return ret_code;
 }
@@ -113,31 +151,69 @@ static int lexy_release()
 }
 
 
+/**
+ * lexy_set_argv - Program arguments
+ *
+ * Binds "argv" to a Q-expression of strings: how the program was given
+ * ("-e", "-" or the script path) followed by its arguments. It is empty in
+ * the REPL.
+ */
+static void lexy_set_argv(char* program, int argc, char** argv)
+{
+    lval_T* list = lval_qexpr();
+
+    if (program != NULL)
+        lval_add(list, lval_str(program));
+
+    for (int i = 0; i < argc; i++)
+        lval_add(list, lval_str(argv[i]));
+
+    lval_T* sym = lval_sym("argv");
+    lval_del(lenv_put(lexy_vm->env, sym, list, LCOND_CONSTANT));
+
+    lval_del(sym);
+    lval_del(list);
+}
+
+
 static void lexy_ast_parse(char* input, void (*inline_routine)(lval_T*, lval_T**), lval_T** err)
 {
     mpc_result_t r;
-    if (mpc_parse("<stdin>", input, Lisp, &r))
+    if (mpc_parse("<stdin>", input, lexy_vm->parser.read, &r))
     {
-        lval_T* parsed_input = lval_read(r.output);
-        mpc_ast_delete(r.output);
-
-        inline_routine(parsed_input, err);
+        inline_routine(r.output, err);
         return;
     }
 
-    *err = lval_err(mpc_err_string(r.error));
+    char* err_msg = mpc_err_string(r.error);
     mpc_err_delete(r.error);
+
+    *err = lval_err("%s", err_msg);
+    free(err_msg);
 }
 
 
 static void lexy_repl_inline_seg(lval_T* parsed_input, lval_T** err)
 {
-    lval_T* t = lval_eval(lexy_current_env, parsed_input);
+    lval_arena_begin();
+    lval_T* t = lval_eval(lexy_vm->env, parsed_input);
+
+    if (lexy_is_exit(t))
+    {
+        int status = lerr_status(t->error);
+
+        lval_del(t);
+        lval_arena_end();
+        lexy_vm_del(lexy_vm);
+
+        exit(status);
+    }
 
     GREY_TXT(1, "%s", PROMPT_RESPONSE);
-    lval_print(lexy_current_env, t);
+    lval_print(lexy_vm->env, t);
 
     lval_del(t);
+    lval_arena_end();
 }
 
 
@@ -148,44 +224,72 @@ static void lexy_repl_start()
 
     GREY_TXT(TRUE, "%s", "press CTRL+c to exit");
 
-    lexy_current_env->exec_type = LEXEC_REPL;
+    lexy_vm->env->exec_type = LEXEC_REPL;
+
+    /* lines are buffered until the forms they hold are whole, so a form can
+       span several of them; each line is only scanned once */
+    lreader_T reader;
+    lreader_init(&reader);
 
     while (TRUE)
     {
-        printf("\n\n");
+        bool continued = !lreader_empty(&reader);
+        if (!continued)
+            printf("\n\n");
+
+        char* line = readline(continued
+            ? ANSI_STYLE_BOLD PROMPT_CONTINUE ANSI_RESET
+            : ANSI_STYLE_BOLD PROMPT_DISPLAY ANSI_RESET);
+
+        if (line == NULL)
+            break;
 
-        char* input = readline(ANSI_STYLE_BOLD PROMPT_DISPLAY ANSI_RESET);
-        add_history(input);
+        add_history(line);
+        lreader_feed(&reader, line, strlen(line));
+        lreader_feed(&reader, "\n", 1);
+        free(line);
+
+        if (!lreader_ready(&reader))
+            continue;
+
+        char* input = lreader_take(&reader, FALSE);
 
         lval_T* err = NULL;
         lexy_ast_parse(input, lexy_repl_inline_seg, &err);
 
         if (err != NULL) {
-            lval_print(lexy_current_env, err);
+            lval_print(lexy_vm->env, err);
             lval_del(err);
         }
 
         free(input);
     }
+
+    lreader_free(&reader);
+    printf("\n");
 }
 
 
 static void lexy_cli_eval_inline_seg(lval_T* parsed_input, lval_T** err)
 {
-    while (parsed_input->counter)
+    while (parsed_input->counter && !lexy_is_exit(*err))
     {
-        lval_T* e = lval_eval(lexy_current_env, lval_pop(parsed_input, 0));
+        lval_arena_begin();
+        lval_T* e = lval_eval(lexy_vm->env, lval_pop(parsed_input, 0));
 
         if (e->type == LTYPE_ERR)
         {
             if (*err != NULL)
                 lval_del(*err);
 
-            *err = lval_err(e->error);
+            *err = lval_persist(e);
         }
 
         lval_del(e);
+        lval_arena_end();
     }
+
+    lval_del(parsed_input);
 }
 
 static int lexy_cli_eval_code(char* input)
@@ -193,47 +297,173 @@ static int lexy_cli_eval_code(char* input)
     lval_T* err = NULL;
     lexy_ast_parse(input, lexy_cli_eval_inline_seg, &err);
 
-    if (err != NULL)
-    {
-        lval_print(lexy_current_env, err);
-        lval_del(err);
+    if (err == NULL)
+        return 0;
 
-        return 1;
-    }
+    int status = lerr_status(err->error);
 
-    return 0;
+    if (!lexy_is_exit(err))
+        lval_print(lexy_vm->env, err);
+
+    lval_del(err);
+    return status;
+}
+
+
+/**
+ * lexy_stdin_exec - Standard input streaming
+ */
+static int lexy_stdin_exec(void)
+{
+    lexy_vm->env->exec_type = LEXEC_FILE;
+    return lexy_vm_eval_stream(lexy_vm, "<stdin>", stdin, stdout);
 }
 
 
 static int lexy_file_exec(char* filep)
 {
-    lexy_current_env->exec_type = LEXEC_FILE;
+    lexy_vm->env->exec_type = LEXEC_FILE;
 
     lval_T* args = lval_add(lval_sexpr(), lval_str(filep));
-    lval_T* res  = btinfn_load(lexy_current_env, args);
+    lval_T* res  = btinfn_load(lexy_vm->env, args);
 
-    if (res->type == LTYPE_ERR)
-        lval_print(lexy_current_env, res);
+    if (res->type == LTYPE_ERR && !lexy_is_exit(res))
+        lval_print(lexy_vm->env, res);
 
-    int retcode = res->error != NULL ? 1 : 0;
+    int retcode = res->type == LTYPE_ERR ? lerr_status(res->error) : 0;
 
     lval_del(res);
     return retcode;
 }
 
 
+/**
+ * lexy_batch_run - One run of a batch script
+ *
+ * Evaluates a copy of the script forms the way "use" does: errors are
+ * printed and the run goes on, "exit" ends it with its status.
+ */
+static int lexy_batch_run(lval_T* forms)
+{
+    lval_T* expr = lval_copy(forms);
+    int retcode  = 0;
+
+    while (expr->counter)
+    {
+        lval_arena_begin();
+
+        lval_T* e = lval_eval(lexy_vm->env, lval_pop(expr, 0));
+        bool exited = lexy_is_exit(e);
+
+        if (exited)
+            retcode = lerr_status(e->error);
+        else if (e->type == LTYPE_ERR)
+            lval_print(lexy_vm->env, e);
+
+        lval_del(e);
+        lval_arena_end();
+
+        if (exited)
+            break;
+    }
+
+    lval_del(expr);
+    return retcode;
+}
+
+
+/**
+ * lexy_batch_exec - Batch execution
+ *
+ * Parses the script once and runs it for every line of the standard input,
+ * with the words of the line as its arguments. Between runs only the
+ * program's own globals are dropped: the modules it used stay loaded. The
+ * status is the one of the last run that failed.
+ */
+static int lexy_batch_exec(char* filep)
+{
+    lexy_vm->env->exec_type = LEXEC_FILE;
+
+    char* path = lmod_resolve(filep, strlen(filep));
+    if (path == NULL)
+    {
+        RED_TXT(TRUE, "\nCould not load script %s: no such module in the search path\n", filep);
+        return 1;
+    }
+
+    mpc_result_t r;
+    if (!mpc_parse_contents(path, lexy_vm->parser.read, &r))
+    {
+        char* err_msg = mpc_err_string(r.error);
+        mpc_err_delete(r.error);
+
+        RED_TXT(TRUE, "\nCould not load script %s\n", err_msg);
+
+        free(err_msg);
+        free(path);
+        return 1;
+    }
+
+    lval_T* forms = r.output;
+    int retcode   = 0;
+
+    size_t capacity = 8;
+    char** args     = malloc(sizeof(char*) * capacity);
+
+    char* line;
+    while ((line = lreader_getline(stdin)) != NULL)
+    {
+        int argc = 0;
+
+        for (char* w = strtok(line, BATCH_ARG_DELIMS); w != NULL; w = strtok(NULL, BATCH_ARG_DELIMS))
+        {
+            if ((size_t)argc == capacity)
+            {
+                capacity *= 2;
+                args = realloc(args, sizeof(char*) * capacity);
+            }
+
+            args[argc++] = w;
+        }
+
+        lexy_set_argv(filep, argc, args);
+
+        int status = lexy_batch_run(forms);
+        if (status != 0)
+            retcode = status;
+
+        lenv_reset(lexy_vm->env);
+        free(line);
+    }
+
+    free(args);
+    lval_del(forms);
+    free(path);
+
+    return retcode;
+}
+
+
 int main(int argc, char** argv)
 {
     signal(SIGINT, lexy_clean_exit);
 
     char* input_code = NULL;
     bool cli_flag_debug = FALSE;
+    bool cli_flag_prof  = FALSE;
+
+    char* batch_script = NULL;
 
     char* bin_filename = argv[0];
     int choice;
 
-    /* ... */
-    while ((choice = getopt(argc, argv, ":hvrde:")) != -1)
+    static struct option long_options[] = {
+        { "batch", required_argument, NULL, 'b' },
+        { NULL,    0,                 NULL,  0  }
+    };
+
+    /* "+" stops at the first operand, so the options of a script are its own */
+    while ((choice = getopt_long(argc, argv, "+:hvrdpe:", long_options, NULL)) != -1)
     {
         switch(choice)
         {
@@ -250,12 +480,24 @@ int main(int argc, char** argv)
                 cli_flag_debug = TRUE;
                 break;
 
+            case 'p':
+                cli_flag_prof = TRUE;
+                break;
+
             case 'e':
                 input_code = optarg;
                 break;
 
-            case ':': /* -e without operand */
-                printf("\nOption -%c requires a string operand\n", optopt);
+            case 'b':
+                batch_script = optarg;
+                break;
+
+            case ':': /* -e or --batch without operand */
+                if (optopt == 'b')
+                    printf("\nOption --batch requires a script\n");
+                else
+                    printf("\nOption -%c requires a string operand\n", optopt);
+
                 return lexy_help_message(2, bin_filename);
 
             case '?':
@@ -265,33 +507,49 @@ int main(int argc, char** argv)
     }
 
     /* ... */
-    lexy_current_env = lenv_new();
-    lenv_init(lexy_current_env);
-    parser_init();
+    if (cli_flag_debug)
+        atexit(lexy_debug_report);
+
+    if (cli_flag_prof)
+    {
+        if (!prof_start())
+            fprintf(stderr, "could not start the sampling timer; only calls will be counted\n");
+
+        atexit(lexy_prof_report);
+    }
+
+    /* ... */
+    lmod_set_home(bin_filename);
+
+    lexy_vm = lexy_vm_new();
+    lexy_vm_enter(lexy_vm);
+
+    /* ... */
+    if (batch_script != NULL)
+        return lexy_batch_exec(batch_script);
 
     /* ... */
     if (input_code != NULL) {
+        lexy_set_argv("-e", argc - optind, argv + optind);
         int retcode = lexy_cli_eval_code(input_code);
 
         return retcode;
     }
 
     /* ... */
-    short int remaining_args = argc - optind;
-    switch(remaining_args)
+    if (optind == argc)
     {
-        case 0:
-            lexy_repl_start();
-            break;
-
-        case 1:
-            return lexy_file_exec(argv[argc - 1]);
+        lexy_set_argv(NULL, 0, NULL);
+        lexy_repl_start();
 
-        default:
-            RED_TXT(TRUE, "\n%s\n", "Arguments to lexy programs are not implemented yet.");
-            exit(2);
-            break;
+        return 0;
     }
 
-    return 0;
+    char* program = argv[optind];
+    lexy_set_argv(program, argc - optind - 1, argv + optind + 1);
+
+    if (strequ(program, "-"))
+        return lexy_stdin_exec();
+
+    return lexy_file_exec(program);
 }
@@ -0,0 +1,14 @@
+/* this file is auto-generated */
+/*       DO NOT TOUCH IT       */
+
+#ifndef LEXY_META
+#define LEXY_META
+
+#define PROGRAM_VERSION  "UNRELEASED"
+#define TARGET_ARCH      "x86_64"
+#define TARGET_KERNEL    "Linux"
+#define COMPILED_WITH    "cc (Debian 12.2.0-14+deb12u1) 12.2.0"
+#define COMPILATION_DATE "2026-10-19"
+#define COMPILATION_TIME "15:30:44"
+
+#endif
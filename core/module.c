@@ -0,0 +1,262 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmt.h"
+#include "module.h"
+
+#ifdef _WIN32
+#define realpath(path, resolved) _fullpath(resolved, path, 0)
+#endif
+
+
+/* "lib" directory next to the interpreter binary, when known */
+static char* lmod_home = NULL;
+
+
+static uint32_t lmod_hash     (const char* path);
+static void     lmod_insert   (lmod_T* m, char* path);
+static char*    lmod_try      (const char* dir, size_t dirlen, const char* name, size_t length);
+
+
+lmod_T* lmod_new(void)
+{
+    lmod_T* m = malloc(sizeof(lmod_T));
+
+    m->capacity = LMOD_INITIAL_SLOTS;
+    m->count    = 0;
+    m->slots    = calloc(m->capacity, sizeof(char*));
+
+    return m;
+}
+
+
+void lmod_del(lmod_T* m)
+{
+    lmod_clear(m);
+    free(m->slots);
+    free(m);
+}
+
+
+/**
+ * lmod_clear - Module registry reset
+ *
+ * Forgets every loaded module, so the next "use" of each one loads it again.
+ */
+void lmod_clear(lmod_T* m)
+{
+    for (size_t i = 0; i < m->capacity; i++)
+    {
+        free(m->slots[i]);
+        m->slots[i] = NULL;
+    }
+
+    m->count = 0;
+}
+
+
+/**
+ * lmod_hash - Resolved path hashing (FNV-1a)
+ */
+static uint32_t lmod_hash(const char* path)
+{
+    uint32_t h = 2166136261u;
+
+    while (*path)
+    {
+        h ^= (unsigned char)*path++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+static void lmod_insert(lmod_T* m, char* path)
+{
+    size_t i = lmod_hash(path) & (m->capacity - 1);
+
+    while (m->slots[i] != NULL)
+        i = (i + 1) & (m->capacity - 1);
+
+    m->slots[i] = path;
+    m->count++;
+}
+
+
+/**
+ * lmod_has - Module registration lookup
+ */
+bool lmod_has(lmod_T* m, const char* path)
+{
+    size_t i = lmod_hash(path) & (m->capacity - 1);
+
+    for (; m->slots[i] != NULL; i = (i + 1) & (m->capacity - 1))
+        if (strequ(m->slots[i], path))
+            return TRUE;
+
+    return FALSE;
+}
+
+
+/**
+ * lmod_add - Module registration
+ *
+ * Records "path" as loaded. Returns FALSE, and records nothing, when it
+ * already was.
+ */
+bool lmod_add(lmod_T* m, const char* path)
+{
+    if (lmod_has(m, path))
+        return FALSE;
+
+    /* keep the load factor under 3/4 */
+    if ((m->count + 1) * 4 > m->capacity * 3)
+    {
+        char** old = m->slots;
+        size_t capacity = m->capacity;
+
+        m->capacity *= 2;
+        m->count = 0;
+        m->slots = calloc(m->capacity, sizeof(char*));
+
+        for (size_t j = 0; j < capacity; j++)
+            if (old[j] != NULL)
+                lmod_insert(m, old[j]);
+
+        free(old);
+    }
+
+    char* key = malloc(strlen(path) + 1);
+    strcpy(key, path);
+    lmod_insert(m, key);
+
+    return TRUE;
+}
+
+
+/**
+ * lmod_try - Module lookup in a single directory
+ *
+ * Returns the resolved path of "dir/name.lisp" (just "name.lisp" when "dir"
+ * is empty), or NULL when there is no such file.
+ */
+static char* lmod_try(const char* dir, size_t dirlen, const char* name, size_t length)
+{
+    char* candidate = malloc(dirlen + 1 + length + sizeof(LMOD_EXTENSION));
+    size_t n = 0;
+
+    if (dirlen > 0)
+    {
+        memcpy(candidate, dir, dirlen);
+        n = dirlen;
+        candidate[n++] = '/';
+    }
+
+    memcpy(candidate + n, name, length);
+    strcpy(candidate + n + length, LMOD_EXTENSION);
+
+    char* resolved = realpath(candidate, NULL);
+
+    free(candidate);
+    return resolved;
+}
+
+
+/**
+ * lmod_resolve - Module search
+ *
+ * Looks "name" (which need not be NUL terminated) up relative to the working
+ * directory, then in every directory of LEXY_PATH and finally in the "lib"
+ * directory next to the binary. Absolute names are only looked up as they
+ * are. Returns the canonical path of the first match, which is the key of the
+ * module in a registry, or NULL.
+ */
+char* lmod_resolve(const char* name, size_t length)
+{
+    char* resolved = lmod_try("", 0, name, length);
+
+    if (resolved != NULL || (length > 0 && name[0] == '/'))
+        return resolved;
+
+    const char* dirs = getenv(LMOD_PATH_ENV);
+
+    while (dirs != NULL && *dirs != '\0')
+    {
+        const char* end = strchr(dirs, LMOD_PATH_SEP);
+        size_t dirlen = end != NULL ? (size_t)(end - dirs) : strlen(dirs);
+
+        if (dirlen > 0 && (resolved = lmod_try(dirs, dirlen, name, length)) != NULL)
+            return resolved;
+
+        dirs = end != NULL ? end + 1 : NULL;
+    }
+
+    if (lmod_home != NULL)
+        return lmod_try(lmod_home, strlen(lmod_home), name, length);
+
+    return NULL;
+}
+
+
+/**
+ * lmod_set_home - Library directory setup
+ *
+ * Points the last step of the module search at the "lib" directory next to
+ * the binary started as "argv0". Meant to be called once, at startup.
+ */
+void lmod_set_home(const char* argv0)
+{
+    char* binary = NULL;
+
+#ifdef __linux__
+    binary = realpath("/proc/self/exe", NULL);
+#endif
+
+    if (binary == NULL && argv0 != NULL && strchr(argv0, '/') != NULL)
+        binary = realpath(argv0, NULL);
+
+    if (binary == NULL)
+        return;
+
+    char* slash = strrchr(binary, '/');
+    size_t dirlen = slash != NULL ? (size_t)(slash - binary) : 0;
+
+    free(lmod_home);
+    lmod_home = malloc(dirlen + sizeof("/" LMOD_LIB_DIR));
+    memcpy(lmod_home, binary, dirlen);
+    strcpy(lmod_home + dirlen, "/" LMOD_LIB_DIR);
+
+    free(binary);
+}
@@ -0,0 +1,74 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_MODULE
+#define LEXY_MODULE
+
+#include <stddef.h>
+
+#include "type.h"
+
+
+/* extra directories searched by "use", in order */
+#define LMOD_PATH_ENV "LEXY_PATH"
+
+/* library directory, next to the interpreter binary */
+#define LMOD_LIB_DIR "lib"
+
+/* appended to every module name */
+#define LMOD_EXTENSION ".lisp"
+
+#ifdef _WIN32
+#define LMOD_PATH_SEP ';'
+#else
+#define LMOD_PATH_SEP ':'
+#endif
+
+/* slots of a new registry; always a power of two */
+#define LMOD_INITIAL_SLOTS 16
+
+
+typedef struct lmod_S lmod_T;
+
+/* set of the modules a VM has loaded, keyed by their resolved paths */
+struct lmod_S
+{
+    char** slots;
+    size_t capacity;
+    size_t count;
+};
+
+
+lmod_T* lmod_new      (void);
+void    lmod_del      (lmod_T* m);
+void    lmod_clear    (lmod_T* m);
+bool    lmod_has      (lmod_T* m, const char* path);
+bool    lmod_add      (lmod_T* m, const char* path);
+char*   lmod_resolve  (const char* name, size_t length);
+void    lmod_set_home (const char* argv0);
+
+#endif
@@ -67,13 +67,209 @@ enum {
   MPC_INPUT_MARKS_MIN = 32
 };
 
+/*
+** Arena blocks carry their size class and requested size in a header.
+** Blocks are at most MPC_ARENA_BLOCK_MAX bytes, rounded up to a power of
+** two and recycled through per-class free lists.
+*/
+
 enum {
-  MPC_INPUT_MEM_NUM = 512
+  MPC_ARENA_BLOCK_MIN = 16,
+  MPC_ARENA_BLOCK_MAX = 2048,
+  MPC_ARENA_CLASSES   = 8,
+  MPC_ARENA_CHUNK_MIN = 4096,
+  MPC_ARENA_CHUNK_MAX = 1048576,
+  MPC_ARENA_CHUNKS_MIN = 8
 };
 
+typedef union {
+  struct { unsigned int size; unsigned int cls; } info;
+  void *p;
+  long l;
+  double d;
+} mpc_block_t;
+
 typedef struct {
-  char mem[64];
-} mpc_mem_t;
+  char *chunk;
+  char *bump;
+  char *end;
+  size_t chunk_size;
+  int chunks_num;
+  int chunks_slots;
+  char **chunks;
+  char **chunk_ends;
+  char *lo;
+  char *hi;
+  void *free[MPC_ARENA_CLASSES];
+} mpc_arena_t;
+
+static mpc_arena_t *mpc_arena_new(void) {
+  int k;
+  mpc_arena_t *a = malloc(sizeof(mpc_arena_t));
+  a->chunk = NULL;
+  a->bump = NULL;
+  a->end = NULL;
+  a->chunk_size = MPC_ARENA_CHUNK_MIN;
+  a->chunks_num = 0;
+  a->chunks_slots = 0;
+  a->chunks = NULL;
+  a->chunk_ends = NULL;
+  a->lo = NULL;
+  a->hi = NULL;
+  for (k = 0; k < MPC_ARENA_CLASSES; k++) { a->free[k] = NULL; }
+  return a;
+}
+
+static void mpc_arena_delete(mpc_arena_t *a) {
+  int j;
+  if (a == NULL) { return; }
+  for (j = 0; j < a->chunks_num; j++) { free(a->chunks[j]); }
+  free(a->chunks);
+  free(a->chunk_ends);
+  free(a);
+}
+
+static char *mpc_arena_chunk(mpc_arena_t *a, size_t n) {
+
+  int j;
+  char *c = malloc(n);
+
+  if (a->chunks_num == a->chunks_slots) {
+    a->chunks_slots = a->chunks_slots ? a->chunks_slots * 2 : MPC_ARENA_CHUNKS_MIN;
+    a->chunks = realloc(a->chunks, sizeof(char*) * a->chunks_slots);
+    a->chunk_ends = realloc(a->chunk_ends, sizeof(char*) * a->chunks_slots);
+  }
+
+  /* Chunks are kept sorted by address so ownership is a binary search */
+  for (j = a->chunks_num; j > 0 && a->chunks[j-1] > c; j--) {
+    a->chunks[j] = a->chunks[j-1];
+    a->chunk_ends[j] = a->chunk_ends[j-1];
+  }
+  a->chunks[j] = c;
+  a->chunk_ends[j] = c + n;
+  a->chunks_num++;
+
+  if (a->lo == NULL || c < a->lo) { a->lo = c; }
+  if (a->hi == NULL || c + n > a->hi) { a->hi = c + n; }
+
+  return c;
+}
+
+static int mpc_arena_find(mpc_arena_t *a, void *p) {
+
+  int l, h, m;
+  char *c = p;
+
+  if (a == NULL || c < a->lo || c >= a->hi) { return -1; }
+
+  l = 0; h = a->chunks_num - 1;
+  while (l < h) {
+    m = (l + h + 1) / 2;
+    if (a->chunks[m] <= c) { l = m; } else { h = m - 1; }
+  }
+
+  return (h >= 0 && c >= a->chunks[l] && c < a->chunk_ends[l]) ? l : -1;
+}
+
+static int mpc_arena_owns(mpc_arena_t *a, void *p) {
+  /* Most blocks are released soon after they are made, from the newest chunk */
+  if (a != NULL && (char*)p >= a->chunk && (char*)p < a->end) { return 1; }
+  return mpc_arena_find(a, p) >= 0;
+}
+
+static int mpc_arena_class(size_t n) {
+  int k = 0;
+  if (n <= MPC_ARENA_BLOCK_MIN) { return 0; }
+  for (n = (n - 1) / MPC_ARENA_BLOCK_MIN; n > 0; n /= 2) { k++; }
+  return k;
+}
+
+static size_t mpc_arena_size(mpc_arena_t *a, void *x) {
+  (void) a;
+  return ((mpc_block_t*)x - 1)->info.size;
+}
+
+static void *mpc_arena_malloc(mpc_arena_t *a, size_t n) {
+
+  int k;
+  size_t m;
+  mpc_block_t *b;
+
+  k = mpc_arena_class(n);
+  if (a->free[k]) {
+    b = (mpc_block_t*)a->free[k] - 1;
+    a->free[k] = *(void**)a->free[k];
+    b->info.size = (unsigned int)n;
+    return b + 1;
+  }
+
+  m = sizeof(mpc_block_t) + ((size_t)MPC_ARENA_BLOCK_MIN << k);
+  if ((size_t)(a->end - a->bump) < m) {
+    a->chunk = mpc_arena_chunk(a, a->chunk_size);
+    a->bump = a->chunk;
+    a->end = a->chunk + a->chunk_size;
+    if (a->chunk_size < MPC_ARENA_CHUNK_MAX) { a->chunk_size *= 2; }
+  }
+
+  b = (mpc_block_t*)a->bump;
+  b->info.size = (unsigned int)n;
+  b->info.cls = (unsigned int)k;
+  a->bump += m;
+  return b + 1;
+}
+
+static void mpc_arena_release(mpc_arena_t *a, void *x) {
+  unsigned int k = ((mpc_block_t*)x - 1)->info.cls;
+  *(void**)x = a->free[k];
+  a->free[k] = x;
+}
+
+static void mpc_arena_free(mpc_arena_t *a, void *x) {
+  if (!mpc_arena_owns(a, x)) { free(x); return; }
+  mpc_arena_release(a, x);
+}
+
+static void *mpc_arena_realloc(mpc_arena_t *a, void *x, size_t n) {
+
+  void *y;
+  size_t m;
+  mpc_block_t *b;
+
+  if (x == NULL) { return mpc_arena_malloc(a, n); }
+  if (!mpc_arena_owns(a, x)) { return realloc(x, n); }
+
+  /* Blocks grow in place up to the capacity of their class */
+  b = (mpc_block_t*)x - 1;
+  if (n <= ((size_t)MPC_ARENA_BLOCK_MIN << b->info.cls)) {
+    if (n > b->info.size) { b->info.size = (unsigned int)n; }
+    return x;
+  }
+
+  m = mpc_arena_size(a, x);
+  y = mpc_arena_malloc(a, n);
+  memcpy(y, x, m);
+  mpc_arena_release(a, x);
+  return y;
+}
+
+/*
+** Packrat entries record the outcome of running a parser at a position:
+** the result it returned, the errors it merged into the running error and
+** where it left the input.
+*/
+
+typedef struct mpc_memo_t {
+  mpc_parser_t *p;
+  long pos;
+  int suppress;
+  int ok;
+  mpc_result_t result;
+  mpc_dtor_t dx;
+  mpc_err_t *merged;
+  mpc_state_t state;
+  char last;
+  struct mpc_memo_t *next;
+} mpc_memo_t;
 
 typedef struct {
 
@@ -94,9 +290,11 @@ typedef struct {
   char *lasts;
   char last;
 
-  size_t mem_index;
-  char mem_full[MPC_INPUT_MEM_NUM];
-  mpc_mem_t mem[MPC_INPUT_MEM_NUM];
+  int memo_num;
+  int memo_slots;
+  mpc_memo_t **memo;
+
+  mpc_arena_t *arena;
 
 } mpc_input_t;
 
@@ -123,8 +321,11 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->arena = mpc_arena_new();
 
   return i;
 }
@@ -153,8 +354,11 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->arena = mpc_arena_new();
 
   return i;
 
@@ -182,8 +386,11 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->arena = mpc_arena_new();
 
   return i;
 
@@ -210,14 +417,20 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
 
-  i->mem_index = 0;
-  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  i->memo_num = 0;
+  i->memo_slots = 0;
+  i->memo = NULL;
+
+  i->arena = mpc_arena_new();
 
   return i;
 }
 
+static void mpc_memo_clear(mpc_input_t *i);
+
 static void mpc_input_delete(mpc_input_t *i) {
 
+  mpc_memo_clear(i);
   free(i->filename);
 
   if (i->type == MPC_INPUT_STRING) { free(i->string); }
@@ -225,33 +438,20 @@ static void mpc_input_delete(mpc_input_t *i) {
 
   free(i->marks);
   free(i->lasts);
+  mpc_arena_delete(i->arena);
   free(i);
 }
 
-static int mpc_mem_ptr(mpc_input_t *i, void *p) {
-  return
-    (char*)p >= (char*)(i->mem) &&
-    (char*)p <  (char*)(i->mem) + (MPC_INPUT_MEM_NUM * sizeof(mpc_mem_t));
-}
+/*
+** Parsing allocates from the arena of its input. Values that reach user
+** callbacks are exported to the heap first; everything else is released
+** in one go when the input is deleted.
+*/
 
 static void *mpc_malloc(mpc_input_t *i, size_t n) {
-  size_t j;
-  char *p;
-
-  if (n > sizeof(mpc_mem_t)) { return malloc(n); }
-
-  j = i->mem_index;
-  do {
-    if (!i->mem_full[i->mem_index]) {
-      p = (void*)(i->mem + i->mem_index);
-      i->mem_full[i->mem_index] = 1;
-      i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
-      return p;
-    }
-    i->mem_index = (i->mem_index+1) % MPC_INPUT_MEM_NUM;
-  } while (j != i->mem_index);
-
-  return malloc(n);
+  /* Large blocks are left to the heap, where they are exported without a copy */
+  if (n > MPC_ARENA_BLOCK_MAX) { return malloc(n); }
+  return mpc_arena_malloc(i->arena, n);
 }
 
 static void *mpc_calloc(mpc_input_t *i, size_t n, size_t m) {
@@ -261,34 +461,30 @@ static void *mpc_calloc(mpc_input_t *i, size_t n, size_t m) {
 }
 
 static void mpc_free(mpc_input_t *i, void *p) {
-  size_t j;
-  if (!mpc_mem_ptr(i, p)) { free(p); return; }
-  j = ((size_t)(((char*)p) - ((char*)i->mem))) / sizeof(mpc_mem_t);
-  i->mem_full[j] = 0;
+  mpc_arena_free(i->arena, p);
 }
 
 static void *mpc_realloc(mpc_input_t *i, void *p, size_t n) {
 
   char *q = NULL;
 
-  if (!mpc_mem_ptr(i, p)) { return realloc(p, n); }
-
-  if (n > sizeof(mpc_mem_t)) {
-    q = malloc(n);
-    memcpy(q, p, sizeof(mpc_mem_t));
-    mpc_free(i, p);
-    return q;
-  }
+  if (n <= MPC_ARENA_BLOCK_MAX) { return mpc_arena_realloc(i->arena, p, n); }
+  if (!mpc_arena_owns(i->arena, p)) { return realloc(p, n); }
 
-  return p;
+  q = malloc(n);
+  memcpy(q, p, mpc_arena_size(i->arena, p));
+  mpc_arena_release(i->arena, p);
+  return q;
 }
 
 static void *mpc_export(mpc_input_t *i, void *p) {
   char *q = NULL;
-  if (!mpc_mem_ptr(i, p)) { return p; }
-  q = malloc(sizeof(mpc_mem_t));
-  memcpy(q, p, sizeof(mpc_mem_t));
-  mpc_free(i, p);
+  size_t n;
+  if (!mpc_arena_owns(i->arena, p)) { return p; }
+  n = mpc_arena_size(i->arena, p);
+  q = malloc(n);
+  memcpy(q, p, n);
+  mpc_arena_release(i->arena, p);
   return q;
 }
 
@@ -325,11 +521,10 @@ static void mpc_input_unmark(mpc_input_t *i) {
 
   i->marks_num--;
 
-  if (i->marks_slots > i->marks_num + i->marks_num / 2
-  &&  i->marks_slots > MPC_INPUT_MARKS_MIN) {
-    i->marks_slots =
-      i->marks_num > MPC_INPUT_MARKS_MIN ?
-      i->marks_num : MPC_INPUT_MARKS_MIN;
+  /* Shrink only once mostly empty, so deep nesting does not realloc per mark */
+  if (i->marks_slots > MPC_INPUT_MARKS_MIN
+  &&  i->marks_num < i->marks_slots / 4) {
+    i->marks_slots /= 2;
     i->marks = realloc(i->marks, sizeof(mpc_state_t) * i->marks_slots);
     i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);
   }
@@ -597,14 +792,12 @@ static void mpc_err_string_cat(char *buffer, int *pos, int *max, char const *fmt
   va_end(va);
 }
 
-static char char_unescape_buffer[4];
+static const char *mpc_err_char_unescape(char c, char *buffer) {
 
-static const char *mpc_err_char_unescape(char c) {
-
-  char_unescape_buffer[0] = '\'';
-  char_unescape_buffer[1] = ' ';
-  char_unescape_buffer[2] = '\'';
-  char_unescape_buffer[3] = '\0';
+  buffer[0] = '\'';
+  buffer[1] = ' ';
+  buffer[2] = '\'';
+  buffer[3] = '\0';
 
   switch (c) {
     case '\a': return "bell";
@@ -617,8 +810,8 @@ static const char *mpc_err_char_unescape(char c) {
     case '\t': return "tab";
     case ' ' : return "space";
     default:
-      char_unescape_buffer[1] = c;
-      return char_unescape_buffer;
+      buffer[1] = c;
+      return buffer;
   }
 
 }
@@ -628,6 +821,7 @@ char *mpc_err_string(mpc_err_t *x) {
   int i;
   int pos = 0;
   int max = 1023;
+  char unescaped[4];
   char *buffer = calloc(1, 1024);
 
   if (x->failure) {
@@ -653,7 +847,7 @@ char *mpc_err_string(mpc_err_t *x) {
   }
 
   mpc_err_string_cat(buffer, &pos, &max, " at ");
-  mpc_err_string_cat(buffer, &pos, &max, mpc_err_char_unescape(x->recieved));
+  mpc_err_string_cat(buffer, &pos, &max, mpc_err_char_unescape(x->recieved, unescaped));
   mpc_err_string_cat(buffer, &pos, &max, "\n");
 
   return realloc(buffer, strlen(buffer) + 1);
@@ -872,6 +1066,32 @@ static mpc_err_t *mpc_err_merge(mpc_input_t *i, mpc_err_t *x, mpc_err_t *y) {
   return mpc_err_or(i, errs, 2);
 }
 
+static mpc_err_t *mpc_err_copy(mpc_input_t *i, mpc_err_t *x) {
+  int j;
+  mpc_err_t *y;
+  if (x == NULL) { return NULL; }
+  y = mpc_malloc(i, sizeof(mpc_err_t));
+  y->filename = mpc_malloc(i, strlen(x->filename) + 1);
+  strcpy(y->filename, x->filename);
+  y->state = x->state;
+  y->expected_num = x->expected_num;
+  y->expected = NULL;
+  if (x->expected_num > 0) {
+    y->expected = mpc_malloc(i, sizeof(char*) * x->expected_num);
+    for (j = 0; j < x->expected_num; j++) {
+      y->expected[j] = mpc_malloc(i, strlen(x->expected[j]) + 1);
+      strcpy(y->expected[j], x->expected[j]);
+    }
+  }
+  y->failure = NULL;
+  if (x->failure) {
+    y->failure = mpc_malloc(i, strlen(x->failure) + 1);
+    strcpy(y->failure, x->failure);
+  }
+  y->recieved = x->recieved;
+  return y;
+}
+
 /*
 ** Parser Type
 */
@@ -910,9 +1130,51 @@ enum {
   MPC_TYPE_CHECK_WITH = 26,
 
   MPC_TYPE_SOI        = 27,
-  MPC_TYPE_EOI        = 28
+  MPC_TYPE_EOI        = 28,
+
+  MPC_TYPE_DFA        = 29,
+  MPC_TYPE_PACKRAT    = 30
+};
+
+/*
+** DFA Scanner Tables
+**
+** State 0 is the start state. "next" holds 256 entries per state (-1 where
+** the character has no transition) and "expected" the messages a failed
+** attempt to go on from an accepting state would have reported.
+*/
+
+enum {
+  MPC_DFA_POSITIONS_MAX = 128
 };
 
+typedef struct {
+  int states;
+  short *next;
+  char *accept;
+  int *expected_num;
+  char ***expected;
+} mpc_dfa_t;
+
+/*
+** Dispatch Tables
+**
+** Built for an `or` so it can skip alternatives that cannot match the next
+** character. "first" holds 256 bits per alternative, set for the characters
+** on which it might do anything other than fail without consuming input,
+** and "expected" the messages it reports when failing on any other. Tables
+** are ignored once a parser they may have looked into is redefined.
+*/
+
+typedef struct {
+  unsigned long gen;
+  unsigned char *first;
+  int *expected_num;
+  char ***expected;
+} mpc_dispatch_t;
+
+static unsigned long mpc_dispatch_gen = 0;
+
 typedef struct { char *m; } mpc_pdata_fail_t;
 typedef struct { mpc_ctor_t lf; void *x; } mpc_pdata_lift_t;
 typedef struct { mpc_parser_t *x; char *m; } mpc_pdata_expect_t;
@@ -928,8 +1190,10 @@ typedef struct { mpc_parser_t *x; mpc_check_with_t f; void *d; char *e; } mpc_pd
 typedef struct { mpc_parser_t *x; } mpc_pdata_predict_t;
 typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; } mpc_pdata_not_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_repeat_t;
-typedef struct { int n; mpc_parser_t **xs; } mpc_pdata_or_t;
+typedef struct { int n; mpc_parser_t **xs; mpc_dispatch_t *d; } mpc_pdata_or_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t **xs; mpc_dtor_t *dxs;  } mpc_pdata_and_t;
+typedef struct { mpc_dfa_t *d; mpc_parser_t *x; } mpc_pdata_dfa_t;
+typedef struct { mpc_parser_t *x; mpc_apply_t c; mpc_dtor_t dx; } mpc_pdata_packrat_t;
 
 typedef union {
   mpc_pdata_fail_t fail;
@@ -949,6 +1213,8 @@ typedef union {
   mpc_pdata_repeat_t repeat;
   mpc_pdata_and_t and;
   mpc_pdata_or_t or;
+  mpc_pdata_dfa_t dfa;
+  mpc_pdata_packrat_t packrat;
 } mpc_pdata_t;
 
 struct mpc_parser_t {
@@ -1028,272 +1294,655 @@ static void mpc_parse_dtor(mpc_input_t *i, mpc_dtor_t d, mpc_val_t *x) {
   d(mpc_export(i, x));
 }
 
-enum {
-  MPC_PARSE_STACK_MIN = 4
-};
+static void mpc_dfa_delete(mpc_dfa_t *d) {
+  int j, k;
+  for (j = 0; j < d->states; j++) {
+    for (k = 0; k < d->expected_num[j]; k++) { free(d->expected[j][k]); }
+    free(d->expected[j]);
+  }
+  free(d->expected);
+  free(d->expected_num);
+  free(d->accept);
+  free(d->next);
+  free(d);
+}
+
+static mpc_dfa_t *mpc_dfa_copy(mpc_dfa_t *a) {
+  int j, k;
+  mpc_dfa_t *d = malloc(sizeof(mpc_dfa_t));
+
+  d->states = a->states;
+  d->next = malloc(sizeof(short) * 256 * a->states);
+  memcpy(d->next, a->next, sizeof(short) * 256 * a->states);
+  d->accept = malloc(a->states);
+  memcpy(d->accept, a->accept, a->states);
+  d->expected_num = malloc(sizeof(int) * a->states);
+  memcpy(d->expected_num, a->expected_num, sizeof(int) * a->states);
+  d->expected = malloc(sizeof(char**) * a->states);
+
+  for (j = 0; j < a->states; j++) {
+    d->expected[j] = malloc(sizeof(char*) * a->expected_num[j]);
+    for (k = 0; k < a->expected_num[j]; k++) {
+      d->expected[j][k] = malloc(strlen(a->expected[j][k]) + 1);
+      strcpy(d->expected[j][k], a->expected[j][k]);
+    }
+  }
 
-#define MPC_SUCCESS(x) r->output = x; return 1
-#define MPC_FAILURE(x) r->error = x; return 0
-#define MPC_PRIMITIVE(x) \
-  if (x) { MPC_SUCCESS(r->output); } \
-  else { MPC_FAILURE(NULL); }
+  return d;
+}
 
-static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
+static void mpc_dispatch_delete(mpc_dispatch_t *d, int n) {
+  int j, k;
+  if (d == NULL) { return; }
+  for (j = 0; j < n; j++) {
+    for (k = 0; k < d->expected_num[j]; k++) { free(d->expected[j][k]); }
+    free(d->expected[j]);
+  }
+  free(d->expected);
+  free(d->expected_num);
+  free(d->first);
+  free(d);
+}
 
-  int j = 0, k = 0;
-  mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
-  mpc_result_t *results;
-  int results_slots = MPC_PARSE_STACK_MIN;
+static mpc_dispatch_t *mpc_dispatch_copy(mpc_dispatch_t *a, int n) {
+  int j, k;
+  mpc_dispatch_t *d;
 
-  switch (p->type) {
+  if (a == NULL) { return NULL; }
 
-    /* Basic Parsers */
+  d = malloc(sizeof(mpc_dispatch_t));
+  d->gen = a->gen;
+  d->first = malloc(32 * n);
+  memcpy(d->first, a->first, 32 * n);
+  d->expected_num = malloc(sizeof(int) * n);
+  memcpy(d->expected_num, a->expected_num, sizeof(int) * n);
+  d->expected = malloc(sizeof(char**) * n);
 
-    case MPC_TYPE_ANY:     MPC_PRIMITIVE(mpc_input_any(i, (char**)&r->output));
-    case MPC_TYPE_SINGLE:  MPC_PRIMITIVE(mpc_input_char(i, p->data.single.x, (char**)&r->output));
-    case MPC_TYPE_RANGE:   MPC_PRIMITIVE(mpc_input_range(i, p->data.range.x, p->data.range.y, (char**)&r->output));
-    case MPC_TYPE_ONEOF:   MPC_PRIMITIVE(mpc_input_oneof(i, p->data.string.x, (char**)&r->output));
-    case MPC_TYPE_NONEOF:  MPC_PRIMITIVE(mpc_input_noneof(i, p->data.string.x, (char**)&r->output));
-    case MPC_TYPE_SATISFY: MPC_PRIMITIVE(mpc_input_satisfy(i, p->data.satisfy.f, (char**)&r->output));
-    case MPC_TYPE_STRING:  MPC_PRIMITIVE(mpc_input_string(i, p->data.string.x, (char**)&r->output));
-    case MPC_TYPE_ANCHOR:  MPC_PRIMITIVE(mpc_input_anchor(i, p->data.anchor.f, (char**)&r->output));
-    case MPC_TYPE_SOI:     MPC_PRIMITIVE(mpc_input_soi(i, (char**)&r->output));
-    case MPC_TYPE_EOI:     MPC_PRIMITIVE(mpc_input_eoi(i, (char**)&r->output));
+  for (j = 0; j < n; j++) {
+    d->expected[j] = malloc(sizeof(char*) * a->expected_num[j]);
+    for (k = 0; k < a->expected_num[j]; k++) {
+      d->expected[j][k] = malloc(strlen(a->expected[j][k]) + 1);
+      strcpy(d->expected[j][k], a->expected[j][k]);
+    }
+  }
 
-    /* Other parsers */
+  return d;
+}
 
-    case MPC_TYPE_UNDEFINED: MPC_FAILURE(mpc_err_fail(i, "Parser Undefined!"));
-    case MPC_TYPE_PASS:      MPC_SUCCESS(NULL);
-    case MPC_TYPE_FAIL:      MPC_FAILURE(mpc_err_fail(i, p->data.fail.m));
-    case MPC_TYPE_LIFT:      MPC_SUCCESS(p->data.lift.lf());
-    case MPC_TYPE_LIFT_VAL:  MPC_SUCCESS(p->data.lift.x);
-    case MPC_TYPE_STATE:     MPC_SUCCESS(mpc_input_state_copy(i));
+/* Merges in an error expecting each of `expected` at the current position */
+static void mpc_err_merge_expected(mpc_input_t *i, mpc_err_t **e, int n, char **expected) {
+  int k;
+  mpc_err_t *err;
+  if (n == 0 || i->suppress) { return; }
+  err = mpc_err_new(i, expected[0]);
+  for (k = 1; k < n; k++) { mpc_err_add_expected(i, err, expected[k]); }
+  *e = mpc_err_merge(i, *e, err);
+}
 
-    /* Application Parsers */
+/*
+** Runs a DFA from the current position and, when it stops in an accepting
+** state, consumes the matched characters and outputs them as a string. On
+** failure nothing is consumed, so the caller can fall back to the tree.
+*/
 
-    case MPC_TYPE_APPLY:
-      if (mpc_parse_run(i, p->data.apply.x, r, e)) {
-        MPC_SUCCESS(mpc_parse_apply(i, p->data.apply.f, r->output));
-      } else {
-        MPC_FAILURE(r->output);
-      }
+static int mpc_input_dfa(mpc_input_t *i, mpc_dfa_t *d, char **o, mpc_err_t **e) {
 
-    case MPC_TYPE_APPLY_TO:
-      if (mpc_parse_run(i, p->data.apply_to.x, r, e)) {
-        MPC_SUCCESS(mpc_parse_apply_to(i, p->data.apply_to.f, r->output, p->data.apply_to.d));
-      } else {
-        MPC_FAILURE(r->error);
-      }
+  int s = 0, t, k;
+  long n = 0, m = 16;
+  const char *x;
+  char c;
 
-    case MPC_TYPE_CHECK:
-      if (mpc_parse_run(i, p->data.check.x, r, e)) {
-        if (p->data.check.f(&r->output)) {
-          MPC_SUCCESS(r->output);
-        } else {
-          MPC_FAILURE(mpc_err_fail(i, p->data.check.e));
-        }
-      } else {
-        MPC_FAILURE(r->error);
-      }
+  if (i->type == MPC_INPUT_STRING) {
 
-    case MPC_TYPE_CHECK_WITH:
-      if (mpc_parse_run(i, p->data.check_with.x, r, e)) {
-        if (p->data.check_with.f(&r->output, p->data.check_with.d)) {
-          MPC_SUCCESS(r->output);
-        } else {
-          MPC_FAILURE(mpc_err_fail(i, p->data.check_with.e));
-        }
-      } else {
-        MPC_FAILURE(r->error);
-      }
+    x = i->string + i->state.pos;
+    while (x[n] && (t = d->next[s * 256 + (unsigned char)x[n]]) >= 0) { s = t; n++; }
+    if (!d->accept[s]) { return 0; }
 
-    case MPC_TYPE_EXPECT:
-      mpc_input_suppress_enable(i);
-      if (mpc_parse_run(i, p->data.expect.x, r, e)) {
-        mpc_input_suppress_disable(i);
-        MPC_SUCCESS(r->output);
-      } else {
-        mpc_input_suppress_disable(i);
-        MPC_FAILURE(mpc_err_new(i, p->data.expect.m));
-      }
+    *o = mpc_malloc(i, n + 1);
+    memcpy(*o, x, n);
+    (*o)[n] = '\0';
 
-    case MPC_TYPE_PREDICT:
-      mpc_input_backtrack_disable(i);
-      if (mpc_parse_run(i, p->data.predict.x, r, e)) {
-        mpc_input_backtrack_enable(i);
-        MPC_SUCCESS(r->output);
-      } else {
-        mpc_input_backtrack_enable(i);
-        MPC_FAILURE(r->error);
+    for (k = 0; k < n; k++) {
+      i->state.pos++;
+      i->state.col++;
+      if (x[k] == '\n') {
+        i->state.col = 0;
+        i->state.row++;
       }
+    }
+    if (n > 0) { i->last = x[n-1]; }
+
+  } else {
 
-    /* Optional Parsers */
+    /* Without backtracking a failed match could not be given back */
+    if (i->backtrack < 1) { return 0; }
 
-    /* TODO: Update Not Error Message */
+    mpc_input_mark(i);
+    *o = mpc_malloc(i, m);
 
-    case MPC_TYPE_NOT:
-      mpc_input_mark(i);
-      mpc_input_suppress_enable(i);
-      if (mpc_parse_run(i, p->data.not.x, r, e)) {
-        mpc_input_rewind(i);
-        mpc_input_suppress_disable(i);
-        mpc_parse_dtor(i, p->data.not.dx, r->output);
-        MPC_FAILURE(mpc_err_new(i, "opposite"));
-      } else {
-        mpc_input_unmark(i);
-        mpc_input_suppress_disable(i);
-        MPC_SUCCESS(p->data.not.lf());
+    while ((c = mpc_input_peekc(i)) != '\0'
+    &&     (t = d->next[s * 256 + (unsigned char)c]) >= 0) {
+      mpc_input_success(i, mpc_input_getc(i), NULL);
+      if (n + 1 >= m) {
+        m = m * 2;
+        *o = mpc_realloc(i, *o, m);
       }
+      (*o)[n++] = c;
+      s = t;
+    }
 
-    case MPC_TYPE_MAYBE:
-      if (mpc_parse_run(i, p->data.not.x, r, e)) {
-        MPC_SUCCESS(r->output);
-      } else {
-        *e = mpc_err_merge(i, *e, r->error);
-        MPC_SUCCESS(p->data.not.lf());
-      }
+    if (!d->accept[s]) {
+      mpc_input_rewind(i);
+      mpc_free(i, *o);
+      return 0;
+    }
 
-    /* Repeat Parsers */
+    mpc_input_unmark(i);
+    (*o)[n] = '\0';
+  }
 
-    case MPC_TYPE_MANY:
+  mpc_err_merge_expected(i, e, d->expected_num[s], d->expected[s]);
 
-      results = results_stk;
-
-      while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
-        j++;
-        if (j == MPC_PARSE_STACK_MIN) {
-          results_slots = j + j / 2;
-          results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
-          memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
-        } else if (j >= results_slots) {
-          results_slots = j + j / 2;
-          results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
-        }
-      }
+  return 1;
+}
 
-      *e = mpc_err_merge(i, *e, results[j].error);
+/*
+** Returns the first alternative from `j` on that the next character does
+** not rule out, merging in what each one skipped would have reported.
+*/
 
-      MPC_SUCCESS(
-        mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
-        if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+static int mpc_input_dispatch(mpc_input_t *i, mpc_parser_t *p, int j, mpc_err_t **e) {
 
-    case MPC_TYPE_MANY1:
+  unsigned char c;
+  mpc_dispatch_t *d = p->data.or.d;
 
-      results = results_stk;
-
-      while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
-        j++;
-        if (j == MPC_PARSE_STACK_MIN) {
-          results_slots = j + j / 2;
-          results = mpc_malloc(i, sizeof(mpc_result_t) * results_slots);
-          memcpy(results, results_stk, sizeof(mpc_result_t) * MPC_PARSE_STACK_MIN);
-        } else if (j >= results_slots) {
-          results_slots = j + j / 2;
-          results = mpc_realloc(i, results, sizeof(mpc_result_t) * results_slots);
-        }
-      }
+  if (d == NULL || d->gen != mpc_dispatch_gen) { return j; }
 
-      if (j == 0) {
-        MPC_FAILURE(
-          mpc_err_many1(i, results[j].error);
-          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-      } else {
+  c = (unsigned char)mpc_input_peekc(i);
+  for (; j < p->data.or.n; j++) {
+    if (d->first[j * 32 + c / 8] & (1 << (c % 8))) { break; }
+    mpc_err_merge_expected(i, e, d->expected_num[j], d->expected[j]);
+  }
 
-        *e = mpc_err_merge(i, *e, results[j].error);
+  return j;
+}
 
-        MPC_SUCCESS(
-          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
-          if (j >= MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-      }
+/*
+** Packrat Memo Table
+**
+** Entries are keyed on the parser, the position and whether errors are
+** suppressed, since a suppressed run reports no errors. The table is only
+** used on string inputs with backtracking enabled, where jumping the input
+** straight to a recorded end state is safe.
+*/
 
-    case MPC_TYPE_COUNT:
+enum {
+  MPC_MEMO_SLOTS_MIN = 256
+};
+
+static size_t mpc_memo_hash(mpc_parser_t *p, long pos, int suppress) {
+  size_t h = ((size_t)p >> 3) ^ ((size_t)pos * 2654435761u);
+  return (h ^ (h >> 16)) * 2 + (suppress ? 1 : 0);
+}
+
+static mpc_memo_t *mpc_memo_find(mpc_input_t *i, mpc_parser_t *p) {
+
+  mpc_memo_t *m;
+  int suppress = i->suppress ? 1 : 0;
+
+  if (i->memo_slots == 0) { return NULL; }
+
+  m = i->memo[mpc_memo_hash(p, i->state.pos, suppress) & (i->memo_slots - 1)];
+  for (; m != NULL; m = m->next) {
+    if (m->p == p && m->pos == i->state.pos && m->suppress == suppress) { return m; }
+  }
 
-      results = p->data.repeat.n > MPC_PARSE_STACK_MIN
-        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.repeat.n)
-        : results_stk;
+  return NULL;
+}
+
+static mpc_memo_t *mpc_memo_new(mpc_input_t *i, mpc_parser_t *p) {
+  mpc_memo_t *m = malloc(sizeof(mpc_memo_t));
+  m->p = p;
+  m->pos = i->state.pos;
+  m->suppress = i->suppress ? 1 : 0;
+  return m;
+}
 
-      while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
-        j++;
-        if (j == p->data.repeat.n) { break; }
+/* Fills in an entry from the result of its run and adds it to the table */
+static void mpc_memo_add(mpc_input_t *i, mpc_memo_t *m, int ok, mpc_result_t *r,
+  mpc_apply_t c, mpc_dtor_t dx, mpc_err_t *merged) {
+
+  int j, slots;
+  size_t h;
+  mpc_memo_t *n, **memo;
+
+  m->ok = ok;
+  if (ok) {
+    m->result.output = c(r->output);
+  } else {
+    m->result.error = mpc_err_copy(i, r->error);
+  }
+  m->dx = dx;
+  m->merged = mpc_err_copy(i, merged);
+  m->state = i->state;
+  m->last = i->last;
+
+  if (i->memo_num >= i->memo_slots) {
+    slots = i->memo_slots ? i->memo_slots * 2 : MPC_MEMO_SLOTS_MIN;
+    memo = calloc(slots, sizeof(mpc_memo_t*));
+    for (j = 0; j < i->memo_slots; j++) {
+      while (i->memo[j]) {
+        n = i->memo[j];
+        i->memo[j] = n->next;
+        h = mpc_memo_hash(n->p, n->pos, n->suppress) & (slots - 1);
+        n->next = memo[h];
+        memo[h] = n;
       }
+    }
+    free(i->memo);
+    i->memo = memo;
+    i->memo_slots = slots;
+  }
+
+  h = mpc_memo_hash(m->p, m->pos, m->suppress) & (i->memo_slots - 1);
+  m->next = i->memo[h];
+  i->memo[h] = m;
+  i->memo_num++;
+}
 
-      if (j == p->data.repeat.n) {
-        MPC_SUCCESS(
-          mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
-          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+static void mpc_memo_clear(mpc_input_t *i) {
+
+  int j;
+  mpc_memo_t *m;
+
+  for (j = 0; j < i->memo_slots; j++) {
+    while (i->memo[j]) {
+      m = i->memo[j];
+      i->memo[j] = m->next;
+      if (m->ok) {
+        m->dx(m->result.output);
       } else {
-        for (k = 0; k < j; k++) {
-          mpc_parse_dtor(i, p->data.repeat.dx, results[k].output);
-        }
-        MPC_FAILURE(
-          mpc_err_count(i, results[j].error, p->data.repeat.n);
-          if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+        mpc_err_delete_internal(i, m->result.error);
       }
+      mpc_err_delete_internal(i, m->merged);
+      free(m);
+    }
+  }
 
-    /* Combinatory Parsers */
+  free(i->memo);
+  i->memo = NULL;
+  i->memo_num = 0;
+  i->memo_slots = 0;
+}
 
-    case MPC_TYPE_OR:
+/*
+** Parse Engine
+**
+** Rather than recursing in C once per combinator the engine keeps an
+** explicit, heap allocated stack of frames. Each frame records the parser
+** being run, how far through it the engine has got, and where the results
+** of its children begin on a shared results stack. When a frame finishes
+** it is popped and its result is handed to the parent frame in `res` and
+** `ok`. Nesting depth is therefore bounded by memory, not by the C stack.
+*/
+
+enum {
+  MPC_PARSE_STACK_MIN = 64
+};
 
-      if (p->data.or.n == 0) { MPC_SUCCESS(NULL); }
+typedef struct {
+  mpc_parser_t *p;
+  int step;
+  int base;
+} mpc_frame_t;
 
-      results = p->data.or.n > MPC_PARSE_STACK_MIN
-        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
-        : results_stk;
+/*
+** Leaves need no frame of their own and are run directly by the frame
+** that calls them. When a compiled table fails its tree is run in its
+** place, and returned in `p` if it needs a frame.
+*/
 
-      for (j = 0; j < p->data.or.n; j++) {
-        if (mpc_parse_run(i, p->data.or.xs[j], &results[j], e)) {
-          MPC_SUCCESS(results[j].output;
-            if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-        } else {
-          *e = mpc_err_merge(i, *e, results[j].error);
-        }
-      }
+#define MPC_PRIMITIVE(x) \
+  if (x) { return 1; } \
+  else { r->error = NULL; return 0; }
 
-      MPC_FAILURE(NULL;
-        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+static int mpc_parse_leaf(mpc_input_t *i, mpc_parser_t **p, mpc_result_t *r, mpc_err_t **e) {
 
-    case MPC_TYPE_AND:
+  mpc_parser_t *x = *p;
 
-      if (p->data.and.n == 0) { MPC_SUCCESS(NULL); }
+  switch (x->type) {
 
-      results = p->data.or.n > MPC_PARSE_STACK_MIN
-        ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
-        : results_stk;
+    /* Basic Parsers */
 
-      mpc_input_mark(i);
-      for (j = 0; j < p->data.and.n; j++) {
-        if (!mpc_parse_run(i, p->data.and.xs[j], &results[j], e)) {
-          mpc_input_rewind(i);
-          for (k = 0; k < j; k++) {
-            mpc_parse_dtor(i, p->data.and.dxs[k], results[k].output);
-          }
-          MPC_FAILURE(results[j].error;
-            if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
-        }
-      }
-      mpc_input_unmark(i);
-      MPC_SUCCESS(
-        mpc_parse_fold(i, p->data.and.f, j, (mpc_val_t**)results);
-        if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
+    case MPC_TYPE_ANY:     MPC_PRIMITIVE(mpc_input_any(i, (char**)&r->output));
+    case MPC_TYPE_SINGLE:  MPC_PRIMITIVE(mpc_input_char(i, x->data.single.x, (char**)&r->output));
+    case MPC_TYPE_RANGE:   MPC_PRIMITIVE(mpc_input_range(i, x->data.range.x, x->data.range.y, (char**)&r->output));
+    case MPC_TYPE_ONEOF:   MPC_PRIMITIVE(mpc_input_oneof(i, x->data.string.x, (char**)&r->output));
+    case MPC_TYPE_NONEOF:  MPC_PRIMITIVE(mpc_input_noneof(i, x->data.string.x, (char**)&r->output));
+    case MPC_TYPE_SATISFY: MPC_PRIMITIVE(mpc_input_satisfy(i, x->data.satisfy.f, (char**)&r->output));
+    case MPC_TYPE_STRING:  MPC_PRIMITIVE(mpc_input_string(i, x->data.string.x, (char**)&r->output));
+    case MPC_TYPE_ANCHOR:  MPC_PRIMITIVE(mpc_input_anchor(i, x->data.anchor.f, (char**)&r->output));
+    case MPC_TYPE_SOI:     MPC_PRIMITIVE(mpc_input_soi(i, (char**)&r->output));
+    case MPC_TYPE_EOI:     MPC_PRIMITIVE(mpc_input_eoi(i, (char**)&r->output));
 
-    /* End */
+    /* Compiled regular expressions run the tree when the table fails */
 
-    default:
+    case MPC_TYPE_DFA:
+      if (mpc_input_dfa(i, x->data.dfa.d, (char**)&r->output, e)) { return 1; }
+      *p = x->data.dfa.x;
+      return mpc_parse_leaf(i, p, r, e);
 
-      MPC_FAILURE(mpc_err_fail(i, "Unknown Parser Type Id!"));
-  }
+    /* Other parsers */
 
-  return 0;
+    case MPC_TYPE_UNDEFINED: r->error = mpc_err_fail(i, "Parser Undefined!"); return 0;
+    case MPC_TYPE_PASS:      r->output = NULL; return 1;
+    case MPC_TYPE_FAIL:      r->error = mpc_err_fail(i, x->data.fail.m); return 0;
+    case MPC_TYPE_LIFT:      r->output = x->data.lift.lf(); return 1;
+    case MPC_TYPE_LIFT_VAL:  r->output = x->data.lift.x; return 1;
+    case MPC_TYPE_STATE:     r->output = mpc_input_state_copy(i); return 1;
+
+    default: return -1;
+  }
 
 }
 
-#undef MPC_SUCCESS
-#undef MPC_FAILURE
 #undef MPC_PRIMITIVE
 
-int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
-  int x;
-  mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
+/* Every parser type other than these is a leaf */
+#define MPC_NODE_TYPES ( \
+  (1UL << MPC_TYPE_EXPECT)  | (1UL << MPC_TYPE_APPLY) | (1UL << MPC_TYPE_APPLY_TO) | \
+  (1UL << MPC_TYPE_PREDICT) | (1UL << MPC_TYPE_NOT)   | (1UL << MPC_TYPE_MAYBE)    | \
+  (1UL << MPC_TYPE_MANY)    | (1UL << MPC_TYPE_MANY1) | (1UL << MPC_TYPE_COUNT)    | \
+  (1UL << MPC_TYPE_OR)      | (1UL << MPC_TYPE_AND)   | (1UL << MPC_TYPE_CHECK)    | \
+  (1UL << MPC_TYPE_CHECK_WITH) | (1UL << MPC_TYPE_PACKRAT))
+
+#define MPC_SUCCESS(x) { res.output = (x); ok = 1; goto done; }
+#define MPC_FAILURE(x) { res.error = (x); ok = 0; goto done; }
+
+/* Calls `x` as step `n`, running it in place if it is a leaf */
+#define MPC_CALL(x, n) \
+  q = (x); f->step = (n); \
+  if (((1UL << q->type) & MPC_NODE_TYPES) \
+  ||  (ok = mpc_parse_leaf(i, &q, &res, e)) < 0) { goto push; }
+
+#define MPC_RESERVE(j) \
+  rs_num = f->base + (j) + 1; \
+  if (rs_num > rs_slots) { \
+    rs_slots = rs_num * 2; \
+    rs = realloc(rs, sizeof(mpc_result_t) * rs_slots); \
+    xs = rs + f->base; \
+  }
+
+static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *root, mpc_result_t *r, mpc_err_t **e) {
+
+  int j, k, ok;
+  int top, fs_slots = MPC_PARSE_STACK_MIN;
+  int rs_num = 0, rs_slots = MPC_PARSE_STACK_MIN;
+  mpc_frame_t *fs, *f;
+  mpc_result_t *rs, *xs;
+  mpc_result_t res;
+  mpc_parser_t *p, *q;
+  mpc_memo_t *m;
+
+  q = root;
+  if ((ok = mpc_parse_leaf(i, &q, r, e)) >= 0) { return ok; }
+
+  fs = malloc(sizeof(mpc_frame_t) * fs_slots);
+  rs = malloc(sizeof(mpc_result_t) * rs_slots);
+
+  top = 0;
+  f = fs;
+  f->p = p = q;
+  f->base = 0;
+  xs = rs;
+
+  for (;;) {
+
+    /* Entering a parser does its setup and calls its first child */
+
+    switch (p->type) {
+
+      case MPC_TYPE_APPLY:      MPC_CALL(p->data.apply.x, 1); break;
+      case MPC_TYPE_APPLY_TO:   MPC_CALL(p->data.apply_to.x, 1); break;
+      case MPC_TYPE_CHECK:      MPC_CALL(p->data.check.x, 1); break;
+      case MPC_TYPE_CHECK_WITH: MPC_CALL(p->data.check_with.x, 1); break;
+      case MPC_TYPE_MAYBE:      MPC_CALL(p->data.not.x, 1); break;
+
+      case MPC_TYPE_EXPECT:
+        mpc_input_suppress_enable(i);
+        MPC_CALL(p->data.expect.x, 1);
+        break;
+
+      case MPC_TYPE_PREDICT:
+        mpc_input_backtrack_disable(i);
+        MPC_CALL(p->data.predict.x, 1);
+        break;
+
+      case MPC_TYPE_NOT:
+        mpc_input_mark(i);
+        mpc_input_suppress_enable(i);
+        MPC_CALL(p->data.not.x, 1);
+        break;
+
+      case MPC_TYPE_MANY:
+      case MPC_TYPE_MANY1:
+      case MPC_TYPE_COUNT:
+        MPC_RESERVE(0);
+        MPC_CALL(p->data.repeat.x, 1);
+        break;
+
+      case MPC_TYPE_OR:
+        if (p->data.or.n == 0) { MPC_SUCCESS(NULL); }
+        j = mpc_input_dispatch(i, p, 0, e);
+        if (j == p->data.or.n) { MPC_FAILURE(NULL); }
+        MPC_CALL(p->data.or.xs[j], j + 1);
+        break;
+
+      case MPC_TYPE_AND:
+        if (p->data.and.n == 0) { MPC_SUCCESS(NULL); }
+        mpc_input_mark(i);
+        MPC_RESERVE(0);
+        MPC_CALL(p->data.and.xs[0], 1);
+        break;
+
+      case MPC_TYPE_PACKRAT:
+        if (i->type != MPC_INPUT_STRING || i->backtrack < 1) {
+          MPC_CALL(p->data.packrat.x, 1);
+          break;
+        }
+        if ((m = mpc_memo_find(i, p))) {
+          i->state = m->state;
+          i->last = m->last;
+          if (m->merged) { *e = mpc_err_merge(i, *e, mpc_err_copy(i, m->merged)); }
+          if (m->ok) { MPC_SUCCESS(p->data.packrat.c(m->result.output)); }
+          MPC_FAILURE(mpc_err_copy(i, m->result.error));
+        }
+        /* Run against an empty error so what the child merges can be kept */
+        MPC_RESERVE(1);
+        xs[0].error = *e;
+        xs[1].output = mpc_memo_new(i, p);
+        *e = NULL;
+        MPC_CALL(p->data.packrat.x, 2);
+        break;
+
+      default:
+        MPC_FAILURE(mpc_err_fail(i, "Unknown Parser Type Id!"));
+    }
+
+
+    /* Resuming a parser takes the result of the child called at `step` */
+
+  resume:
+    switch (p->type) {
+
+      /* Application Parsers */
+
+      case MPC_TYPE_APPLY:
+        if (ok) { MPC_SUCCESS(mpc_parse_apply(i, p->data.apply.f, res.output)); }
+        break;
+
+      case MPC_TYPE_APPLY_TO:
+        if (ok) { MPC_SUCCESS(mpc_parse_apply_to(i, p->data.apply_to.f, res.output, p->data.apply_to.d)); }
+        break;
+
+      case MPC_TYPE_CHECK:
+        if (ok && !p->data.check.f(&res.output)) {
+          MPC_FAILURE(mpc_err_fail(i, p->data.check.e));
+        }
+        break;
+
+      case MPC_TYPE_CHECK_WITH:
+        if (ok && !p->data.check_with.f(&res.output, p->data.check_with.d)) {
+          MPC_FAILURE(mpc_err_fail(i, p->data.check_with.e));
+        }
+        break;
+
+      case MPC_TYPE_EXPECT:
+        mpc_input_suppress_disable(i);
+        if (!ok) { MPC_FAILURE(mpc_err_new(i, p->data.expect.m)); }
+        break;
+
+      case MPC_TYPE_PREDICT:
+        mpc_input_backtrack_enable(i);
+        break;
+
+      case MPC_TYPE_PACKRAT:
+        if (f->step == 2) {
+          mpc_memo_add(i, xs[1].output, ok, &res, p->data.packrat.c, p->data.packrat.dx, *e);
+          *e = *e ? mpc_err_merge(i, xs[0].error, *e) : xs[0].error;
+        }
+        break;
+
+      /* Optional Parsers */
+
+      /* TODO: Update Not Error Message */
+
+      case MPC_TYPE_NOT:
+        if (ok) {
+          mpc_input_rewind(i);
+          mpc_input_suppress_disable(i);
+          mpc_parse_dtor(i, p->data.not.dx, res.output);
+          MPC_FAILURE(mpc_err_new(i, "opposite"));
+        } else {
+          mpc_input_unmark(i);
+          mpc_input_suppress_disable(i);
+          MPC_SUCCESS(p->data.not.lf());
+        }
+
+      case MPC_TYPE_MAYBE:
+        if (!ok) {
+          *e = mpc_err_merge(i, *e, res.error);
+          MPC_SUCCESS(p->data.not.lf());
+        }
+        break;
+
+      /* Repeat Parsers */
+
+      case MPC_TYPE_MANY:
+      case MPC_TYPE_MANY1:
+
+        for (j = f->step - 1; ok; ) {
+          xs[j++] = res;
+          MPC_RESERVE(j);
+          MPC_CALL(p->data.repeat.x, j + 1);
+        }
+
+        if (p->type == MPC_TYPE_MANY1 && j == 0) {
+          MPC_FAILURE(mpc_err_many1(i, res.error));
+        }
+
+        *e = mpc_err_merge(i, *e, res.error);
+        MPC_SUCCESS(mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)xs));
+
+      case MPC_TYPE_COUNT:
+
+        for (j = f->step - 1; ok; ) {
+          xs[j++] = res;
+          if (j == p->data.repeat.n) {
+            MPC_SUCCESS(mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)xs));
+          }
+          MPC_RESERVE(j);
+          MPC_CALL(p->data.repeat.x, j + 1);
+        }
+
+        for (k = 0; k < j; k++) {
+          mpc_parse_dtor(i, p->data.repeat.dx, xs[k].output);
+        }
+        MPC_FAILURE(mpc_err_count(i, res.error, p->data.repeat.n));
+
+      /* Combinatory Parsers */
+
+      case MPC_TYPE_OR:
+
+        for (j = f->step; ; j++) {
+          if (ok) { MPC_SUCCESS(res.output); }
+          *e = mpc_err_merge(i, *e, res.error);
+          j = mpc_input_dispatch(i, p, j, e);
+          if (j == p->data.or.n) { MPC_FAILURE(NULL); }
+          MPC_CALL(p->data.or.xs[j], j + 1);
+        }
+
+      case MPC_TYPE_AND:
+
+        for (j = f->step; ; j++) {
+          if (!ok) {
+            mpc_input_rewind(i);
+            for (k = 0; k < j - 1; k++) {
+              mpc_parse_dtor(i, p->data.and.dxs[k], xs[k].output);
+            }
+            MPC_FAILURE(res.error);
+          }
+          xs[j-1] = res;
+          if (j == p->data.and.n) {
+            mpc_input_unmark(i);
+            MPC_SUCCESS(mpc_parse_fold(i, p->data.and.f, j, (mpc_val_t**)xs));
+          }
+          MPC_RESERVE(j);
+          MPC_CALL(p->data.and.xs[j], j + 1);
+        }
+    }
+
+    /* The frame has finished, leaving its result in `res` and `ok` */
+
+  done:
+    rs_num = f->base;
+    if (--top < 0) { break; }
+    f = fs + top;
+    p = f->p;
+    xs = rs + f->base;
+    goto resume;
+
+    /* The frame calls `q`, which needs a frame of its own */
+
+  push:
+    if (++top == fs_slots) {
+      fs_slots *= 2;
+      fs = realloc(fs, sizeof(mpc_frame_t) * fs_slots);
+    }
+    f = fs + top;
+    f->p = p = q;
+    f->base = rs_num;
+    xs = rs + rs_num;
+
+  }
+
+  free(fs);
+  free(rs);
+
+  *r = res;
+  return ok;
+
+}
+
+#undef MPC_NODE_TYPES
+#undef MPC_SUCCESS
+#undef MPC_FAILURE
+#undef MPC_CALL
+#undef MPC_RESERVE
+
+int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
+  int x;
+  mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
   e->state = mpc_state_invalid();
   x = mpc_parse_run(i, p, r, &e);
   if (x) {
@@ -1340,6 +1989,8 @@ int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result
 int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
 
   FILE *f = fopen(filename, "rb");
+  char *buffer = NULL;
+  size_t length = 0, size = 0, n;
   int res;
 
   if (f == NULL) {
@@ -1348,8 +1999,20 @@ int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
     return 0;
   }
 
-  res = mpc_parse_file(filename, f, p, r);
+  /* Read the whole file so it is parsed as a string, which never seeks */
+  do {
+    if (length == size) {
+      size = size ? size * 2 : 4096;
+      buffer = realloc(buffer, size + 1);
+    }
+    n = fread(buffer + length, 1, size - length, f);
+    length += n;
+  } while (n > 0);
+
   fclose(f);
+
+  res = mpc_nparse(filename, buffer, length, p, r);
+  free(buffer);
   return res;
 }
 
@@ -1365,6 +2028,7 @@ static void mpc_undefine_or(mpc_parser_t *p) {
   for (i = 0; i < p->data.or.n; i++) {
     mpc_undefine_unretained(p->data.or.xs[i], 0);
   }
+  mpc_dispatch_delete(p->data.or.d, p->data.or.n);
   free(p->data.or.xs);
 
 }
@@ -1397,6 +2061,7 @@ static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
     case MPC_TYPE_APPLY:    mpc_undefine_unretained(p->data.apply.x, 0);    break;
     case MPC_TYPE_APPLY_TO: mpc_undefine_unretained(p->data.apply_to.x, 0); break;
     case MPC_TYPE_PREDICT:  mpc_undefine_unretained(p->data.predict.x, 0);  break;
+    case MPC_TYPE_PACKRAT:  mpc_undefine_unretained(p->data.packrat.x, 0);  break;
 
     case MPC_TYPE_MAYBE:
     case MPC_TYPE_NOT:
@@ -1417,6 +2082,11 @@ static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
     case MPC_TYPE_OR:  mpc_undefine_or(p);  break;
     case MPC_TYPE_AND: mpc_undefine_and(p); break;
 
+    case MPC_TYPE_DFA:
+      mpc_dfa_delete(p->data.dfa.d);
+      mpc_undefine_unretained(p->data.dfa.x, 0);
+      break;
+
     case MPC_TYPE_CHECK:
       mpc_undefine_unretained(p->data.check.x, 0);
       free(p->data.check.e);
@@ -1505,6 +2175,7 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
     case MPC_TYPE_APPLY:    p->data.apply.x    = mpc_copy(a->data.apply.x);    break;
     case MPC_TYPE_APPLY_TO: p->data.apply_to.x = mpc_copy(a->data.apply_to.x); break;
     case MPC_TYPE_PREDICT:  p->data.predict.x  = mpc_copy(a->data.predict.x);  break;
+    case MPC_TYPE_PACKRAT:  p->data.packrat.x  = mpc_copy(a->data.packrat.x);  break;
 
     case MPC_TYPE_MAYBE:
     case MPC_TYPE_NOT:
@@ -1528,6 +2199,7 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
       for (i = 0; i < a->data.or.n; i++) {
         p->data.or.xs[i] = mpc_copy(a->data.or.xs[i]);
       }
+      p->data.or.d = mpc_dispatch_copy(a->data.or.d, a->data.or.n);
     break;
     case MPC_TYPE_AND:
       p->data.and.xs = malloc(a->data.and.n * sizeof(mpc_parser_t*));
@@ -1551,6 +2223,11 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
       strcpy(p->data.check_with.e, a->data.check_with.e);
       break;
 
+    case MPC_TYPE_DFA:
+      p->data.dfa.d = mpc_dfa_copy(a->data.dfa.d);
+      p->data.dfa.x = mpc_copy(a->data.dfa.x);
+      break;
+
     default: break;
   }
 
@@ -1559,6 +2236,7 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
 }
 
 mpc_parser_t *mpc_undefine(mpc_parser_t *p) {
+  if (p->type != MPC_TYPE_UNDEFINED) { mpc_dispatch_gen++; }
   mpc_undefine_unretained(p, 1);
   p->type = MPC_TYPE_UNDEFINED;
   return p;
@@ -1566,6 +2244,8 @@ mpc_parser_t *mpc_undefine(mpc_parser_t *p) {
 
 mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a) {
 
+  if (p->type != MPC_TYPE_UNDEFINED) { mpc_dispatch_gen++; }
+
   if (p->retained) {
     p->type = a->type;
     p->data = a->data;
@@ -1587,7 +2267,12 @@ void mpc_cleanup(int n, ...) {
   va_list va;
   va_start(va, n);
   for (i = 0; i < n; i++) { list[i] = va_arg(va, mpc_parser_t*); }
-  for (i = 0; i < n; i++) { mpc_undefine(list[i]); }
+
+  /* Deleted parsers never run again, so dispatch tables are kept valid */
+  for (i = 0; i < n; i++) {
+    mpc_undefine_unretained(list[i], 1);
+    list[i]->type = MPC_TYPE_UNDEFINED;
+  }
   for (i = 0; i < n; i++) { mpc_delete(list[i]); }
   va_end(va);
 
@@ -1859,6 +2544,15 @@ mpc_parser_t *mpc_predictive(mpc_parser_t *a) {
   return p;
 }
 
+mpc_parser_t *mpc_packrat(mpc_parser_t *a, mpc_apply_t c, mpc_dtor_t da) {
+  mpc_parser_t *p = mpc_undefined();
+  p->type = MPC_TYPE_PACKRAT;
+  p->data.packrat.x = a;
+  p->data.packrat.c = c;
+  p->data.packrat.dx = da;
+  return p;
+}
+
 mpc_parser_t *mpc_not_lift(mpc_parser_t *a, mpc_dtor_t da, mpc_ctor_t lf) {
   mpc_parser_t *p = mpc_undefined();
   p->type = MPC_TYPE_NOT;
@@ -1920,6 +2614,7 @@ mpc_parser_t *mpc_or(int n, ...) {
   p->type = MPC_TYPE_OR;
   p->data.or.n = n;
   p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
+  p->data.or.d = NULL;
 
   va_start(va, n);
   for (i = 0; i < n; i++) {
@@ -2127,212 +2822,801 @@ mpc_parser_t *mpc_tok_squares(mpc_parser_t *a, mpc_dtor_t ad)  { return mpc_tok_
 ** lines of code using mpc.
 */
 
-/*
-**
-**  ### Regular Expression Grammar
-**
-**      <regex> : <term> | (<term> "|" <regex>)
-**
-**      <term> : <factor>*
-**
-**      <factor> : <base>
-**               | <base> "*"
-**               | <base> "+"
-**               | <base> "?"
-**               | <base> "{" <digits> "}"
-**
-**      <base> : <char>
-**             | "\" <char>
-**             | "(" <regex> ")"
-**             | "[" <range> "]"
-*/
+/*
+**
+**  ### Regular Expression Grammar
+**
+**      <regex> : <term> | (<term> "|" <regex>)
+**
+**      <term> : <factor>*
+**
+**      <factor> : <base>
+**               | <base> "*"
+**               | <base> "+"
+**               | <base> "?"
+**               | <base> "{" <digits> "}"
+**
+**      <base> : <char>
+**             | "\" <char>
+**             | "(" <regex> ")"
+**             | "[" <range> "]"
+*/
+
+static mpc_val_t *mpcf_re_or(int n, mpc_val_t **xs) {
+  (void) n;
+  if (xs[1] == NULL) { return xs[0]; }
+  else { return mpc_or(2, xs[0], xs[1]); }
+}
+
+static mpc_val_t *mpcf_re_and(int n, mpc_val_t **xs) {
+  int i;
+  mpc_parser_t *p = mpc_lift(mpcf_ctor_str);
+  for (i = 0; i < n; i++) {
+    p = mpc_and(2, mpcf_strfold, p, xs[i], free);
+  }
+  return p;
+}
+
+static mpc_val_t *mpcf_re_repeat(int n, mpc_val_t **xs) {
+  int num;
+  (void) n;
+  if (xs[1] == NULL) { return xs[0]; }
+  switch(((char*)xs[1])[0])
+  {
+    case '*': { free(xs[1]); return mpc_many(mpcf_strfold, xs[0]); }; break;
+    case '+': { free(xs[1]); return mpc_many1(mpcf_strfold, xs[0]); }; break;
+    case '?': { free(xs[1]); return mpc_maybe_lift(xs[0], mpcf_ctor_str); }; break;
+    default:
+      num = *(int*)xs[1];
+      free(xs[1]);
+  }
+
+  return mpc_count(num, mpcf_strfold, xs[0], free);
+}
+
+static mpc_parser_t *mpc_re_escape_char(char c) {
+  switch (c) {
+    case 'a': return mpc_char('\a');
+    case 'f': return mpc_char('\f');
+    case 'n': return mpc_char('\n');
+    case 'r': return mpc_char('\r');
+    case 't': return mpc_char('\t');
+    case 'v': return mpc_char('\v');
+    case 'b': return mpc_and(2, mpcf_snd, mpc_boundary(), mpc_lift(mpcf_ctor_str), free);
+    case 'B': return mpc_not_lift(mpc_boundary(), free, mpcf_ctor_str);
+    case 'A': return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
+    case 'Z': return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free);
+    case 'd': return mpc_digit();
+    case 'D': return mpc_not_lift(mpc_digit(), free, mpcf_ctor_str);
+    case 's': return mpc_whitespace();
+    case 'S': return mpc_not_lift(mpc_whitespace(), free, mpcf_ctor_str);
+    case 'w': return mpc_alphanum();
+    case 'W': return mpc_not_lift(mpc_alphanum(), free, mpcf_ctor_str);
+    default: return NULL;
+  }
+}
+
+static mpc_val_t *mpcf_re_escape(mpc_val_t *x, void* data) {
+
+  int mode = *((int*)data);
+  char *s = x;
+  mpc_parser_t *p;
+
+  /* Any Character */
+  if (s[0] == '.') {
+    free(s);
+    if (mode & MPC_RE_DOTALL) {
+      return mpc_any();
+    } else {
+      return mpc_expect(mpc_noneof("\n"), "any character except a newline");
+    }
+  }
+
+  /* Start of Input */
+  if (s[0] == '^') {
+    free(s);
+    if (mode & MPC_RE_MULTILINE) {
+      return mpc_and(2, mpcf_snd, mpc_or(2, mpc_soi(), mpc_boundary_newline()), mpc_lift(mpcf_ctor_str), free);
+    } else {
+      return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
+    }
+  }
+
+  /* End of Input */
+  if (s[0] == '$') {
+    free(s);
+    if (mode & MPC_RE_MULTILINE) {
+      return mpc_or(2,
+        mpc_newline(),
+        mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
+    } else {
+      return mpc_or(2,
+        mpc_and(2, mpcf_fst, mpc_newline(), mpc_eoi(), free),
+        mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
+    }
+  }
+
+  /* Regex Escape */
+  if (s[0] == '\\') {
+    p = mpc_re_escape_char(s[1]);
+    p = (p == NULL) ? mpc_char(s[1]) : p;
+    free(s);
+    return p;
+  }
+
+  /* Regex Standard */
+  p = mpc_char(s[0]);
+  free(s);
+  return p;
+}
+
+static const char *mpc_re_range_escape_char(char c) {
+  switch (c) {
+    case '-': return "-";
+    case 'a': return "\a";
+    case 'f': return "\f";
+    case 'n': return "\n";
+    case 'r': return "\r";
+    case 't': return "\t";
+    case 'v': return "\v";
+    case 'b': return "\b";
+    case 'd': return "0123456789";
+    case 's': return " \f\n\r\t\v";
+    case 'w': return "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+    default: return NULL;
+  }
+}
+
+static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
+
+  mpc_parser_t *out;
+  size_t i, j;
+  size_t start, end;
+  const char *tmp = NULL;
+  const char *s = x;
+  int comp = s[0] == '^' ? 1 : 0;
+  char *range = calloc(1,1);
+
+  if (s[0] == '\0') { free(range); free(x); return mpc_fail("Invalid Regex Range Expression"); }
+  if (s[0] == '^' &&
+      s[1] == '\0') { free(range); free(x); return mpc_fail("Invalid Regex Range Expression"); }
+
+  for (i = comp; i < strlen(s); i++){
+
+    /* Regex Range Escape */
+    if (s[i] == '\\') {
+      tmp = mpc_re_range_escape_char(s[i+1]);
+      if (tmp != NULL) {
+        range = realloc(range, strlen(range) + strlen(tmp) + 1);
+        strcat(range, tmp);
+      } else {
+        range = realloc(range, strlen(range) + 1 + 1);
+        range[strlen(range) + 1] = '\0';
+        range[strlen(range) + 0] = s[i+1];
+      }
+      i++;
+    }
+
+    /* Regex Range...Range */
+    else if (s[i] == '-') {
+      if (s[i+1] == '\0' || i == 0) {
+          range = realloc(range, strlen(range) + strlen("-") + 1);
+          strcat(range, "-");
+      } else {
+        start = s[i-1]+1;
+        end = s[i+1]-1;
+        for (j = start; j <= end; j++) {
+          range = realloc(range, strlen(range) + 1 + 1 + 1);
+          range[strlen(range) + 1] = '\0';
+          range[strlen(range) + 0] = (char)j;
+        }
+      }
+    }
+
+    /* Regex Range Normal */
+    else {
+      range = realloc(range, strlen(range) + 1 + 1);
+      range[strlen(range) + 1] = '\0';
+      range[strlen(range) + 0] = s[i];
+    }
+
+  }
+
+  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
+
+  free(x);
+  free(range);
+
+  return out;
+}
+
+/*
+** Regular Expression DFA Compilation
+**
+** Regexes made only of characters, classes, sequences, alternatives and
+** repetitions are compiled into a table with one state per character
+** position (Glushkov construction). The table is only kept when it is
+** deterministic, when every alternative but the last and every repeated
+** or optional expression consumes input, and when the tree accepts the
+** same text for every accepting state. Under those conditions the greedy,
+** non-backtracking tree matches exactly what the table matches, so the
+** table is run first and the tree only when the table fails.
+*/
+
+enum {
+  MPC_DFA_SET_BYTES = MPC_DFA_POSITIONS_MAX / 8
+};
+
+typedef struct {
+  int nullable;
+  unsigned char first[MPC_DFA_SET_BYTES];
+  unsigned char last[MPC_DFA_SET_BYTES];
+} mpc_dfa_node_t;
+
+typedef struct {
+  int n;
+  unsigned char chars[MPC_DFA_POSITIONS_MAX][32];
+  unsigned char follow[MPC_DFA_POSITIONS_MAX][MPC_DFA_SET_BYTES];
+} mpc_dfa_builder_t;
+
+#define MPC_DFA_HAS(s, j) ((s)[(j) / 8] & (1 << ((j) % 8)))
+#define MPC_DFA_ADD(s, j) ((s)[(j) / 8] |= (unsigned char)(1 << ((j) % 8)))
+
+static void mpc_dfa_union(unsigned char *x, const unsigned char *y) {
+  int j;
+  for (j = 0; j < MPC_DFA_SET_BYTES; j++) { x[j] |= y[j]; }
+}
+
+static void mpc_dfa_follow(mpc_dfa_builder_t *b, const unsigned char *from, const unsigned char *to) {
+  int j;
+  for (j = 0; j < b->n; j++) {
+    if (MPC_DFA_HAS(from, j)) { mpc_dfa_union(b->follow[j], to); }
+  }
+}
+
+static void mpc_dfa_concat(mpc_dfa_builder_t *b, mpc_dfa_node_t *r, mpc_dfa_node_t *x) {
+  mpc_dfa_follow(b, r->last, x->first);
+  if (r->nullable) { mpc_dfa_union(r->first, x->first); }
+  if (!x->nullable) { memset(r->last, 0, MPC_DFA_SET_BYTES); }
+  mpc_dfa_union(r->last, x->last);
+  r->nullable = r->nullable && x->nullable;
+}
+
+static int mpc_dfa_leaf(mpc_dfa_builder_t *b, mpc_parser_t *p, mpc_dfa_node_t *r) {
+
+  int c, j;
+  unsigned char *chars;
+
+  if (b->n == MPC_DFA_POSITIONS_MAX) { return 0; }
+
+  j = b->n++;
+  chars = b->chars[j];
+
+  for (c = 1; c < 256; c++) {
+    switch (p->type) {
+      case MPC_TYPE_ANY:    break;
+      case MPC_TYPE_SINGLE: if ((char)c != p->data.single.x) { continue; } break;
+      case MPC_TYPE_RANGE:
+        if ((char)c < p->data.range.x || (char)c > p->data.range.y) { continue; }
+        break;
+      case MPC_TYPE_ONEOF:  if (!strchr(p->data.string.x, c)) { continue; } break;
+      case MPC_TYPE_NONEOF: if (strchr(p->data.string.x, c)) { continue; } break;
+      default: return 0;
+    }
+    MPC_DFA_ADD(chars, c);
+  }
+
+  MPC_DFA_ADD(r->first, j);
+  MPC_DFA_ADD(r->last, j);
+  return 1;
+}
+
+static int mpc_dfa_build(mpc_dfa_builder_t *b, mpc_parser_t *p, mpc_dfa_node_t *r) {
+
+  int j;
+  mpc_dfa_node_t x;
+
+  memset(r, 0, sizeof(mpc_dfa_node_t));
+
+  if (p->retained) { return 0; }
+
+  switch (p->type) {
+
+    case MPC_TYPE_EXPECT: return mpc_dfa_build(b, p->data.expect.x, r);
+
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      return mpc_dfa_leaf(b, p, r);
+
+    case MPC_TYPE_LIFT:
+      r->nullable = 1;
+      return p->data.lift.lf == mpcf_ctor_str;
+
+    case MPC_TYPE_AND:
+      if (p->data.and.f != mpcf_strfold) { return 0; }
+      r->nullable = 1;
+      for (j = 0; j < p->data.and.n; j++) {
+        if (!mpc_dfa_build(b, p->data.and.xs[j], &x)) { return 0; }
+        mpc_dfa_concat(b, r, &x);
+      }
+      return 1;
+
+    case MPC_TYPE_OR:
+      if (p->data.or.n == 0) { return 0; }
+      for (j = 0; j < p->data.or.n; j++) {
+        if (!mpc_dfa_build(b, p->data.or.xs[j], &x)) { return 0; }
+        if (x.nullable && j != p->data.or.n-1) { return 0; }
+        mpc_dfa_union(r->first, x.first);
+        mpc_dfa_union(r->last, x.last);
+        r->nullable = x.nullable;
+      }
+      return 1;
+
+    case MPC_TYPE_MAYBE:
+      if (p->data.not.lf != mpcf_ctor_str) { return 0; }
+      if (!mpc_dfa_build(b, p->data.not.x, r) || r->nullable) { return 0; }
+      r->nullable = 1;
+      return 1;
+
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+      if (p->data.repeat.f != mpcf_strfold) { return 0; }
+      if (!mpc_dfa_build(b, p->data.repeat.x, r) || r->nullable) { return 0; }
+      mpc_dfa_follow(b, r->last, r->first);
+      r->nullable = p->type == MPC_TYPE_MANY;
+      return 1;
+
+    case MPC_TYPE_COUNT:
+      if (p->data.repeat.f != mpcf_strfold) { return 0; }
+      r->nullable = 1;
+      for (j = 0; j < p->data.repeat.n; j++) {
+        if (!mpc_dfa_build(b, p->data.repeat.x, &x)) { return 0; }
+        mpc_dfa_concat(b, r, &x);
+      }
+      return 1;
+
+    default: return 0;
+  }
+}
+
+/*
+** Runs the tree on the shortest text reaching the accepting state "s"
+** followed by the end of input. The tree must accept all of it, and the
+** errors it reports at the end are those the table reports from "s".
+*/
+
+static int mpc_dfa_witness(mpc_dfa_t *d, mpc_parser_t *p, int s, const int *prev, const char *via) {
+
+  int j, n = 0, ok;
+  char *w;
+  mpc_input_t *i;
+  mpc_result_t r;
+  mpc_err_t *e;
+
+  for (j = s; j != 0; j = prev[j]) { n++; }
+  w = malloc(n + 1);
+  w[n] = '\0';
+  for (j = s; j != 0; j = prev[j]) { w[--n] = via[j]; }
+
+  i = mpc_input_new_string("<mpc_re_compiler>", w);
+  e = mpc_err_fail(i, "Unknown Error");
+  e->state = mpc_state_invalid();
+
+  ok = mpc_parse_run(i, p, &r, &e);
+  if (ok) {
+    mpc_free(i, r.output);
+    ok = i->state.pos == (long)strlen(w);
+  } else {
+    mpc_err_delete_internal(i, r.error);
+  }
+
+  if (ok && e && !e->failure && e->state.pos == (long)strlen(w)) {
+    d->expected_num[s] = e->expected_num;
+    d->expected[s] = malloc(sizeof(char*) * e->expected_num);
+    for (j = 0; j < e->expected_num; j++) {
+      d->expected[s][j] = malloc(strlen(e->expected[j]) + 1);
+      strcpy(d->expected[s][j], e->expected[j]);
+    }
+  }
+
+  mpc_err_delete_internal(i, e);
+  mpc_input_delete(i);
+  free(w);
+  return ok;
+}
+
+static mpc_dfa_t *mpc_dfa_compile(mpc_parser_t *p) {
+
+  int s, j, c, ok, head = 0, tail = 0;
+  int *prev, *queue;
+  char *via;
+  unsigned char *cand;
+  mpc_dfa_node_t root;
+  mpc_dfa_t *d;
+  mpc_dfa_builder_t *b = calloc(1, sizeof(mpc_dfa_builder_t));
+
+  if (!mpc_dfa_build(b, p, &root)) {
+    free(b);
+    return NULL;
+  }
+
+  d = malloc(sizeof(mpc_dfa_t));
+  d->states = b->n + 1;
+  d->next = malloc(sizeof(short) * 256 * d->states);
+  d->accept = calloc(d->states, 1);
+  d->expected_num = calloc(d->states, sizeof(int));
+  d->expected = calloc(d->states, sizeof(char**));
+  memset(d->next, 0xFF, sizeof(short) * 256 * d->states);
+
+  ok = 1;
+  for (s = 0; s < d->states && ok; s++) {
+    cand = s == 0 ? root.first : b->follow[s-1];
+    d->accept[s] = s == 0 ? root.nullable : MPC_DFA_HAS(root.last, s-1) != 0;
+    for (j = 0; j < b->n && ok; j++) {
+      if (!MPC_DFA_HAS(cand, j)) { continue; }
+      for (c = 1; c < 256; c++) {
+        if (!MPC_DFA_HAS(b->chars[j], c)) { continue; }
+        if (d->next[s * 256 + c] >= 0) { ok = 0; break; }
+        d->next[s * 256 + c] = (short)(j + 1);
+      }
+    }
+  }
+
+  free(b);
+
+  /* Breadth first search for the shortest text reaching each state */
+
+  prev = malloc(sizeof(int) * d->states);
+  via = malloc(d->states);
+  queue = malloc(sizeof(int) * d->states);
+  for (s = 0; s < d->states; s++) { prev[s] = -1; }
+
+  prev[0] = 0;
+  queue[tail++] = 0;
+  while (head < tail && ok) {
+    s = queue[head++];
+    if (d->accept[s] && !mpc_dfa_witness(d, p, s, prev, via)) { ok = 0; }
+    for (c = 1; c < 256; c++) {
+      j = d->next[s * 256 + c];
+      if (j < 0 || prev[j] >= 0) { continue; }
+      prev[j] = s;
+      via[j] = (char)c;
+      queue[tail++] = j;
+    }
+  }
+
+  free(prev);
+  free(via);
+  free(queue);
+
+  if (!ok) {
+    mpc_dfa_delete(d);
+    return NULL;
+  }
+
+  return d;
+}
+
+static mpc_parser_t *mpc_dfa(mpc_parser_t *x) {
+  mpc_parser_t *p;
+  mpc_dfa_t *d = mpc_dfa_compile(x);
+
+  if (d == NULL) { return x; }
+
+  p = mpc_undefined();
+  p->type = MPC_TYPE_DFA;
+  p->data.dfa.d = d;
+  p->data.dfa.x = x;
+  return p;
+}
+
+/*
+** Alternative Dispatch
+**
+** FIRST sets are worked out following references into retained parsers.
+** What the analysis cannot see through, such as anchors, undefined parsers
+** or a parser reached again while it is being analysed, is given every
+** character and is never skipped. The zero character is in every set, so
+** nothing is skipped at the end of input. An alternative that can be
+** skipped is run once on a character outside its set to record what it
+** reports there, which is the same for every such character.
+*/
+
+typedef struct {
+  int nullable;
+  unsigned char first[32];
+} mpc_first_t;
+
+typedef struct {
+  int num;
+  int slots;
+  mpc_parser_t **ps;
+  mpc_first_t *fs;
+  char *done;
+} mpc_first_cache_t;
+
+static void mpc_first(mpc_first_cache_t *c, mpc_parser_t *p, mpc_first_t *r);
+
+static void mpc_first_unknown(mpc_first_t *r) {
+  r->nullable = 1;
+  memset(r->first, 0xFF, 32);
+}
+
+static void mpc_first_union(mpc_first_t *r, const mpc_first_t *x) {
+  int j;
+  for (j = 0; j < 32; j++) { r->first[j] |= x->first[j]; }
+}
+
+static void mpc_first_chars(mpc_parser_t *p, mpc_first_t *r) {
+  int k;
+  for (k = 1; k < 256; k++) {
+    switch (p->type) {
+      case MPC_TYPE_SINGLE:  if ((char)k != p->data.single.x) { continue; } break;
+      case MPC_TYPE_RANGE:
+        if ((char)k < p->data.range.x || (char)k > p->data.range.y) { continue; }
+        break;
+      case MPC_TYPE_ONEOF:   if (!strchr(p->data.string.x, k)) { continue; } break;
+      case MPC_TYPE_NONEOF:  if (strchr(p->data.string.x, k)) { continue; } break;
+      case MPC_TYPE_SATISFY: if (!p->data.satisfy.f((char)k)) { continue; } break;
+      default: break;
+    }
+    MPC_DFA_ADD(r->first, k);
+  }
+}
+
+/*
+** Sets "first" to the characters on which `p` might do anything other than
+** what it does on every other character, and "nullable" when that is to
+** succeed without consuming input rather than to fail.
+*/
+
+static void mpc_first_body(mpc_first_cache_t *c, mpc_parser_t *p, mpc_first_t *r) {
+
+  int j;
+  mpc_first_t x;
+
+  memset(r, 0, sizeof(mpc_first_t));
+
+  switch (p->type) {
+
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+      mpc_first_chars(p, r);
+      break;
+
+    case MPC_TYPE_STRING:
+      if (p->data.string.x[0] == '\0') { r->nullable = 1; }
+      else { MPC_DFA_ADD(r->first, (unsigned char)p->data.string.x[0]); }
+      break;
+
+    case MPC_TYPE_FAIL: break;
+
+    case MPC_TYPE_PASS:
+    case MPC_TYPE_LIFT:
+    case MPC_TYPE_LIFT_VAL:
+    case MPC_TYPE_STATE:
+      r->nullable = 1;
+      break;
+
+    case MPC_TYPE_EXPECT:   mpc_first(c, p->data.expect.x, r);   break;
+    case MPC_TYPE_APPLY:    mpc_first(c, p->data.apply.x, r);    break;
+    case MPC_TYPE_APPLY_TO: mpc_first(c, p->data.apply_to.x, r); break;
+    case MPC_TYPE_PREDICT:  mpc_first(c, p->data.predict.x, r);  break;
+    case MPC_TYPE_PACKRAT:  mpc_first(c, p->data.packrat.x, r);  break;
+    case MPC_TYPE_DFA:      mpc_first(c, p->data.dfa.x, r);      break;
+
+    case MPC_TYPE_CHECK:
+    case MPC_TYPE_CHECK_WITH:
+      mpc_first(c, p->type == MPC_TYPE_CHECK ? p->data.check.x : p->data.check_with.x, r);
+      if (r->nullable) { mpc_first_unknown(r); }
+      break;
+
+    case MPC_TYPE_NOT:
+      mpc_first(c, p->data.not.x, r);
+      r->nullable = !r->nullable;
+      break;
+
+    case MPC_TYPE_MAYBE:
+      mpc_first(c, p->data.not.x, r);
+      r->nullable = 1;
+      break;
+
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+      mpc_first(c, p->data.repeat.x, r);
+      if (p->type == MPC_TYPE_MANY) { r->nullable = 1; }
+      break;
+
+    case MPC_TYPE_COUNT:
+      if (p->data.repeat.n > 0) { mpc_first(c, p->data.repeat.x, r); }
+      else { mpc_first_unknown(r); }
+      break;
+
+    case MPC_TYPE_OR:
+      for (j = 0; j < p->data.or.n; j++) {
+        mpc_first(c, p->data.or.xs[j], &x);
+        mpc_first_union(r, &x);
+        r->nullable = r->nullable || x.nullable;
+      }
+      break;
 
-static mpc_val_t *mpcf_re_or(int n, mpc_val_t **xs) {
-  (void) n;
-  if (xs[1] == NULL) { return xs[0]; }
-  else { return mpc_or(2, xs[0], xs[1]); }
-}
+    case MPC_TYPE_AND:
+      r->nullable = 1;
+      for (j = 0; j < p->data.and.n && r->nullable; j++) {
+        mpc_first(c, p->data.and.xs[j], &x);
+        mpc_first_union(r, &x);
+        r->nullable = x.nullable;
+      }
+      break;
 
-static mpc_val_t *mpcf_re_and(int n, mpc_val_t **xs) {
-  int i;
-  mpc_parser_t *p = mpc_lift(mpcf_ctor_str);
-  for (i = 0; i < n; i++) {
-    p = mpc_and(2, mpcf_strfold, p, xs[i], free);
+    default:
+      mpc_first_unknown(r);
+      break;
   }
-  return p;
+
+  MPC_DFA_ADD(r->first, 0);
 }
 
-static mpc_val_t *mpcf_re_repeat(int n, mpc_val_t **xs) {
-  int num;
-  (void) n;
-  if (xs[1] == NULL) { return xs[0]; }
-  switch(((char*)xs[1])[0])
-  {
-    case '*': { free(xs[1]); return mpc_many(mpcf_strfold, xs[0]); }; break;
-    case '+': { free(xs[1]); return mpc_many1(mpcf_strfold, xs[0]); }; break;
-    case '?': { free(xs[1]); return mpc_maybe_lift(xs[0], mpcf_ctor_str); }; break;
-    default:
-      num = *(int*)xs[1];
-      free(xs[1]);
+static void mpc_first(mpc_first_cache_t *c, mpc_parser_t *p, mpc_first_t *r) {
+
+  int j;
+
+  if (!p->retained) {
+    mpc_first_body(c, p, r);
+    return;
   }
 
-  return mpc_count(num, mpcf_strfold, xs[0], free);
-}
+  for (j = 0; j < c->num; j++) {
+    if (c->ps[j] != p) { continue; }
+    if (c->done[j]) { *r = c->fs[j]; } else { mpc_first_unknown(r); }
+    return;
+  }
 
-static mpc_parser_t *mpc_re_escape_char(char c) {
-  switch (c) {
-    case 'a': return mpc_char('\a');
-    case 'f': return mpc_char('\f');
-    case 'n': return mpc_char('\n');
-    case 'r': return mpc_char('\r');
-    case 't': return mpc_char('\t');
-    case 'v': return mpc_char('\v');
-    case 'b': return mpc_and(2, mpcf_snd, mpc_boundary(), mpc_lift(mpcf_ctor_str), free);
-    case 'B': return mpc_not_lift(mpc_boundary(), free, mpcf_ctor_str);
-    case 'A': return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
-    case 'Z': return mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free);
-    case 'd': return mpc_digit();
-    case 'D': return mpc_not_lift(mpc_digit(), free, mpcf_ctor_str);
-    case 's': return mpc_whitespace();
-    case 'S': return mpc_not_lift(mpc_whitespace(), free, mpcf_ctor_str);
-    case 'w': return mpc_alphanum();
-    case 'W': return mpc_not_lift(mpc_alphanum(), free, mpcf_ctor_str);
-    default: return NULL;
+  if (c->num == c->slots) {
+    c->slots = c->slots ? c->slots * 2 : 16;
+    c->ps = realloc(c->ps, sizeof(mpc_parser_t*) * c->slots);
+    c->fs = realloc(c->fs, sizeof(mpc_first_t) * c->slots);
+    c->done = realloc(c->done, c->slots);
   }
+
+  j = c->num++;
+  c->ps[j] = p;
+  c->done[j] = 0;
+  mpc_first_body(c, p, r);
+  c->fs[j] = *r;
+  c->done[j] = 1;
 }
 
-static mpc_val_t *mpcf_re_escape(mpc_val_t *x, void* data) {
+/*
+** Runs `x` on the first character outside its FIRST set and keeps the
+** messages it reports, which must all be expectations at the start.
+*/
 
-  int mode = *((int*)data);
-  char *s = x;
-  mpc_parser_t *p;
+static int mpc_dispatch_witness(mpc_dispatch_t *d, int j, mpc_parser_t *x, const mpc_first_t *f) {
 
-  /* Any Character */
-  if (s[0] == '.') {
-    free(s);
-    if (mode & MPC_RE_DOTALL) {
-      return mpc_any();
-    } else {
-      return mpc_expect(mpc_noneof("\n"), "any character except a newline");
-    }
-  }
+  int k, ok;
+  char w[2];
+  mpc_input_t *i;
+  mpc_result_t r;
+  mpc_err_t *e = NULL;
 
-  /* Start of Input */
-  if (s[0] == '^') {
-    free(s);
-    if (mode & MPC_RE_MULTILINE) {
-      return mpc_and(2, mpcf_snd, mpc_or(2, mpc_soi(), mpc_boundary_newline()), mpc_lift(mpcf_ctor_str), free);
-    } else {
-      return mpc_and(2, mpcf_snd, mpc_soi(), mpc_lift(mpcf_ctor_str), free);
+  for (k = 1; k < 256 && MPC_DFA_HAS(f->first, k); k++);
+  if (k == 256) { return 0; }
+
+  w[0] = (char)k;
+  w[1] = '\0';
+
+  i = mpc_input_new_string("<mpc_dispatch>", w);
+
+  /* The analysis says this fails, so a success is never expected here */
+  ok = mpc_parse_run(i, x, &r, &e);
+  if (!ok) { e = mpc_err_merge(i, e, r.error); }
+
+  ok = !ok && i->state.pos == 0
+    && (e == NULL || (!e->failure && e->expected_num > 0 && e->state.pos == 0));
+
+  if (ok && e) {
+    d->expected_num[j] = e->expected_num;
+    d->expected[j] = malloc(sizeof(char*) * e->expected_num);
+    for (k = 0; k < e->expected_num; k++) {
+      d->expected[j][k] = malloc(strlen(e->expected[k]) + 1);
+      strcpy(d->expected[j][k], e->expected[k]);
     }
   }
 
-  /* End of Input */
-  if (s[0] == '$') {
-    free(s);
-    if (mode & MPC_RE_MULTILINE) {
-      return mpc_or(2,
-        mpc_newline(),
-        mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
+  mpc_err_delete_internal(i, e);
+  mpc_input_delete(i);
+  return ok;
+}
+
+static void mpc_dispatch_or(mpc_first_cache_t *c, mpc_parser_t *p) {
+
+  int j, n = p->data.or.n, any = 0;
+  mpc_first_t x;
+  mpc_dispatch_t *d;
+
+  if (n <= 0) { return; }
+
+  d = malloc(sizeof(mpc_dispatch_t));
+  d->gen = mpc_dispatch_gen;
+  d->first = malloc(32 * n);
+  d->expected_num = calloc(n, sizeof(int));
+  d->expected = calloc(n, sizeof(char**));
+
+  for (j = 0; j < n; j++) {
+    mpc_first(c, p->data.or.xs[j], &x);
+    if (!x.nullable && mpc_dispatch_witness(d, j, p->data.or.xs[j], &x)) {
+      memcpy(d->first + j * 32, x.first, 32);
+      any = 1;
     } else {
-      return mpc_or(2,
-        mpc_and(2, mpcf_fst, mpc_newline(), mpc_eoi(), free),
-        mpc_and(2, mpcf_snd, mpc_eoi(), mpc_lift(mpcf_ctor_str), free));
+      memset(d->first + j * 32, 0xFF, 32);
     }
   }
 
-  /* Regex Escape */
-  if (s[0] == '\\') {
-    p = mpc_re_escape_char(s[1]);
-    p = (p == NULL) ? mpc_char(s[1]) : p;
-    free(s);
-    return p;
-  }
+  mpc_dispatch_delete(p->data.or.d, n);
+  p->data.or.d = NULL;
 
-  /* Regex Standard */
-  p = mpc_char(s[0]);
-  free(s);
-  return p;
+  if (any) { p->data.or.d = d; } else { mpc_dispatch_delete(d, n); }
 }
 
-static const char *mpc_re_range_escape_char(char c) {
-  switch (c) {
-    case '-': return "-";
-    case 'a': return "\a";
-    case 'f': return "\f";
-    case 'n': return "\n";
-    case 'r': return "\r";
-    case 't': return "\t";
-    case 'v': return "\v";
-    case 'b': return "\b";
-    case 'd': return "0123456789";
-    case 's': return " \f\n\r\t\v";
-    case 'w': return "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
-    default: return NULL;
-  }
-}
+static void mpc_dispatch_unretained(mpc_first_cache_t *c, mpc_parser_t *p, int force) {
 
-static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
+  int j;
 
-  mpc_parser_t *out;
-  size_t i, j;
-  size_t start, end;
-  const char *tmp = NULL;
-  const char *s = x;
-  int comp = s[0] == '^' ? 1 : 0;
-  char *range = calloc(1,1);
+  if (p->retained && !force) { return; }
 
-  if (s[0] == '\0') { free(range); free(x); return mpc_fail("Invalid Regex Range Expression"); }
-  if (s[0] == '^' &&
-      s[1] == '\0') { free(range); free(x); return mpc_fail("Invalid Regex Range Expression"); }
+  switch (p->type) {
+    case MPC_TYPE_EXPECT:     mpc_dispatch_unretained(c, p->data.expect.x, 0);     break;
+    case MPC_TYPE_APPLY:      mpc_dispatch_unretained(c, p->data.apply.x, 0);      break;
+    case MPC_TYPE_APPLY_TO:   mpc_dispatch_unretained(c, p->data.apply_to.x, 0);   break;
+    case MPC_TYPE_CHECK:      mpc_dispatch_unretained(c, p->data.check.x, 0);      break;
+    case MPC_TYPE_CHECK_WITH: mpc_dispatch_unretained(c, p->data.check_with.x, 0); break;
+    case MPC_TYPE_PREDICT:    mpc_dispatch_unretained(c, p->data.predict.x, 0);    break;
+    case MPC_TYPE_PACKRAT:    mpc_dispatch_unretained(c, p->data.packrat.x, 0);    break;
+    case MPC_TYPE_DFA:        mpc_dispatch_unretained(c, p->data.dfa.x, 0);        break;
 
-  for (i = comp; i < strlen(s); i++){
+    case MPC_TYPE_NOT:
+    case MPC_TYPE_MAYBE:
+      mpc_dispatch_unretained(c, p->data.not.x, 0);
+      break;
 
-    /* Regex Range Escape */
-    if (s[i] == '\\') {
-      tmp = mpc_re_range_escape_char(s[i+1]);
-      if (tmp != NULL) {
-        range = realloc(range, strlen(range) + strlen(tmp) + 1);
-        strcat(range, tmp);
-      } else {
-        range = realloc(range, strlen(range) + 1 + 1);
-        range[strlen(range) + 1] = '\0';
-        range[strlen(range) + 0] = s[i+1];
-      }
-      i++;
-    }
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:
+      mpc_dispatch_unretained(c, p->data.repeat.x, 0);
+      break;
 
-    /* Regex Range...Range */
-    else if (s[i] == '-') {
-      if (s[i+1] == '\0' || i == 0) {
-          range = realloc(range, strlen(range) + strlen("-") + 1);
-          strcat(range, "-");
-      } else {
-        start = s[i-1]+1;
-        end = s[i+1]-1;
-        for (j = start; j <= end; j++) {
-          range = realloc(range, strlen(range) + 1 + 1 + 1);
-          range[strlen(range) + 1] = '\0';
-          range[strlen(range) + 0] = (char)j;
-        }
+    case MPC_TYPE_AND:
+      for (j = 0; j < p->data.and.n; j++) {
+        mpc_dispatch_unretained(c, p->data.and.xs[j], 0);
       }
-    }
+      break;
 
-    /* Regex Range Normal */
-    else {
-      range = realloc(range, strlen(range) + 1 + 1);
-      range[strlen(range) + 1] = '\0';
-      range[strlen(range) + 0] = s[i];
-    }
+    case MPC_TYPE_OR:
+      for (j = 0; j < p->data.or.n; j++) {
+        mpc_dispatch_unretained(c, p->data.or.xs[j], 0);
+      }
+      mpc_dispatch_or(c, p);
+      break;
 
+    default: break;
   }
+}
 
-  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
-
-  free(x);
-  free(range);
-
-  return out;
+static void mpc_dispatch(mpc_parser_t *p) {
+  mpc_first_cache_t c;
+  memset(&c, 0, sizeof(mpc_first_cache_t));
+  mpc_dispatch_unretained(&c, p, 1);
+  free(c.ps);
+  free(c.fs);
+  free(c.done);
 }
 
 mpc_parser_t *mpc_re(const char *re) {
@@ -2402,6 +3686,10 @@ mpc_parser_t *mpc_re_mode(const char *re, int mode) {
 
   mpc_optimise(r.output);
 
+  if (!(mode & MPC_RE_NO_DFA)) {
+    r.output = mpc_dfa(r.output);
+  }
+
   return r.output;
 
 }
@@ -2755,6 +4043,7 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_APPLY)    { mpc_print_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { mpc_print_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { mpc_print_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_PACKRAT)  { mpc_print_unretained(p->data.packrat.x, 0); }
 
   if (p->type == MPC_TYPE_NOT)   { mpc_print_unretained(p->data.not.x, 0); printf("!"); }
   if (p->type == MPC_TYPE_MAYBE) { mpc_print_unretained(p->data.not.x, 0); printf("?"); }
@@ -2763,6 +4052,8 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_MANY1) { mpc_print_unretained(p->data.repeat.x, 0); printf("+"); }
   if (p->type == MPC_TYPE_COUNT) { mpc_print_unretained(p->data.repeat.x, 0); printf("{%i}", p->data.repeat.n); }
 
+  if (p->type == MPC_TYPE_DFA)   { mpc_print_unretained(p->data.dfa.x, 0); }
+
   if (p->type == MPC_TYPE_OR) {
     printf("(");
     for(i = 0; i < p->data.or.n-1; i++) {
@@ -2871,19 +4162,71 @@ int mpc_test_pass(mpc_parser_t *p, const char *s, const void *d,
 
 void mpc_ast_delete(mpc_ast_t *a) {
 
-  int i;
+  int i, num = 0, slots = 16;
+  mpc_ast_t **stk;
 
   if (a == NULL) { return; }
 
-  for (i = 0; i < a->children_num; i++) {
-    mpc_ast_delete(a->children[i]);
+  /* Walk with an explicit stack so deep trees cannot overflow the C stack */
+  stk = malloc(sizeof(mpc_ast_t*) * slots);
+  stk[num++] = a;
+
+  while (num > 0) {
+    a = stk[--num];
+    if (num + a->children_num > slots) {
+      slots = (num + a->children_num) * 2;
+      stk = realloc(stk, sizeof(mpc_ast_t*) * slots);
+    }
+    for (i = 0; i < a->children_num; i++) {
+      stk[num++] = a->children[i];
+    }
+    free(a->children);
+    free(a->tag);
+    free(a->contents);
+    free(a);
   }
 
-  free(a->children);
-  free(a->tag);
-  free(a->contents);
-  free(a);
+  free(stk);
+
+}
 
+mpc_ast_t *mpc_ast_copy(mpc_ast_t *a) {
+
+  int i, num = 0, slots = 16;
+  mpc_ast_t *r, *root, **stk;
+
+  if (a == NULL) { return NULL; }
+
+  /* Pairs of source and copy whose children are still to be copied */
+  stk = malloc(sizeof(mpc_ast_t*) * slots * 2);
+  root = mpc_ast_new(a->tag, a->contents);
+  root->state = a->state;
+  stk[num * 2] = a;
+  stk[num * 2 + 1] = root;
+  num++;
+
+  while (num > 0) {
+    num--;
+    a = stk[num * 2];
+    if (num + a->children_num > slots) {
+      slots = (num + a->children_num) * 2;
+      stk = realloc(stk, sizeof(mpc_ast_t*) * slots * 2);
+    }
+    r = stk[num * 2 + 1];
+    if (a->children_num == 0) { continue; }
+    r->children_num = a->children_num;
+    r->children = malloc(sizeof(mpc_ast_t*) * a->children_num);
+    for (i = 0; i < a->children_num; i++) {
+      r->children[i] = mpc_ast_new(a->children[i]->tag, a->children[i]->contents);
+      r->children[i]->state = a->children[i]->state;
+      stk[num * 2] = a->children[i];
+      stk[num * 2 + 1] = r->children[i];
+      num++;
+    }
+  }
+
+  free(stk);
+  return root;
 }
 
 static void mpc_ast_delete_no_children(mpc_ast_t *a) {
@@ -3280,6 +4623,7 @@ mpc_parser_t *mpca_or(int n, ...) {
   p->type = MPC_TYPE_OR;
   p->data.or.n = n;
   p->data.or.xs = malloc(sizeof(mpc_parser_t*) * n);
+  p->data.or.d = NULL;
 
   va_start(va, n);
   for (i = 0; i < n; i++) {
@@ -3635,6 +4979,8 @@ static void mpca_stmt_list_delete(mpc_val_t *x) {
 
 }
 
+static void mpc_optimise_unretained(mpc_parser_t *p, int force);
+
 static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
 
   mpca_grammar_st_t *st = s;
@@ -3647,12 +4993,21 @@ static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
     left = mpca_grammar_find_parser(stmt->ident, st);
     if (st->flags & MPCA_LANG_PREDICTIVE) { stmt->grammar = mpc_predictive(stmt->grammar); }
     if (stmt->name) { stmt->grammar = mpc_expect(stmt->grammar, stmt->name); }
-    mpc_optimise(stmt->grammar);
+    if (st->flags & MPCA_LANG_PACKRAT) {
+      stmt->grammar = mpc_packrat(stmt->grammar, (mpc_apply_t)mpc_ast_copy, (mpc_dtor_t)mpc_ast_delete);
+    }
+    mpc_optimise_unretained(stmt->grammar, 1);
     mpc_define(left, stmt->grammar);
+    stmts++;
+  }
+
+  /* Dispatch tables look into other rules, so wait until all are defined */
+  for (stmts = x; *stmts; stmts++) {
+    stmt = *stmts;
+    mpc_dispatch(mpca_grammar_find_parser(stmt->ident, st));
     free(stmt->ident);
     free(stmt->name);
     free(stmt);
-    stmts++;
   }
 
   free(x);
@@ -3841,6 +5196,7 @@ static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
   if (p->type == MPC_TYPE_APPLY)    { return 1 + mpc_nodecount_unretained(p->data.apply.x, 0); }
   if (p->type == MPC_TYPE_APPLY_TO) { return 1 + mpc_nodecount_unretained(p->data.apply_to.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)  { return 1 + mpc_nodecount_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_PACKRAT)  { return 1 + mpc_nodecount_unretained(p->data.packrat.x, 0); }
 
   if (p->type == MPC_TYPE_CHECK)    { return 1 + mpc_nodecount_unretained(p->data.check.x, 0); }
   if (p->type == MPC_TYPE_CHECK_WITH) { return 1 + mpc_nodecount_unretained(p->data.check_with.x, 0); }
@@ -3852,6 +5208,8 @@ static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
   if (p->type == MPC_TYPE_MANY1) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
   if (p->type == MPC_TYPE_COUNT) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
 
+  if (p->type == MPC_TYPE_DFA)   { return 1 + mpc_nodecount_unretained(p->data.dfa.x, 0); }
+
   if (p->type == MPC_TYPE_OR) {
     total = 1;
     for(i = 0; i < p->data.or.n; i++) {
@@ -3893,6 +5251,7 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_CHECK)      { mpc_optimise_unretained(p->data.check.x, 0); }
   if (p->type == MPC_TYPE_CHECK_WITH) { mpc_optimise_unretained(p->data.check_with.x, 0); }
   if (p->type == MPC_TYPE_PREDICT)    { mpc_optimise_unretained(p->data.predict.x, 0); }
+  if (p->type == MPC_TYPE_PACKRAT)    { mpc_optimise_unretained(p->data.packrat.x, 0); }
   if (p->type == MPC_TYPE_NOT)        { mpc_optimise_unretained(p->data.not.x, 0); }
   if (p->type == MPC_TYPE_MAYBE)      { mpc_optimise_unretained(p->data.not.x, 0); }
   if (p->type == MPC_TYPE_MANY)       { mpc_optimise_unretained(p->data.repeat.x, 0); }
@@ -3924,6 +5283,8 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       p->data.or.n = n + m - 1;
       p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
       memmove(p->data.or.xs + n - 1, t->data.or.xs, m * sizeof(mpc_parser_t*));
+      mpc_dispatch_delete(p->data.or.d, n); p->data.or.d = NULL;
+      mpc_dispatch_delete(t->data.or.d, m);
       free(t->data.or.xs); free(t->name); free(t);
       continue;
     }
@@ -3938,6 +5299,8 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
       memmove(p->data.or.xs + m, p->data.or.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
       memmove(p->data.or.xs, t->data.or.xs, m * sizeof(mpc_parser_t*));
+      mpc_dispatch_delete(p->data.or.d, n); p->data.or.d = NULL;
+      mpc_dispatch_delete(t->data.or.d, m);
       free(t->data.or.xs); free(t->name); free(t);
       continue;
     }
@@ -4049,5 +5412,6 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
 
 void mpc_optimise(mpc_parser_t *p) {
   mpc_optimise_unretained(p, 1);
+  mpc_dispatch(p);
 }
 
@@ -0,0 +1,89 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "num.h"
+
+
+/**
+ * num_add_overflow - Checked integer addition
+ *
+ * Portable versions of the compiler builtins behind the NUM_*_OVERFLOW macros.
+ */
+bool num_add_overflow(int64_t a, int64_t b, int64_t* r)
+{
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b))
+        return TRUE;
+
+    *r = a + b;
+    return FALSE;
+}
+
+
+bool num_sub_overflow(int64_t a, int64_t b, int64_t* r)
+{
+    if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b))
+        return TRUE;
+
+    *r = a - b;
+    return FALSE;
+}
+
+
+bool num_mul_overflow(int64_t a, int64_t b, int64_t* r)
+{
+    if (a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a)
+              : (b > 0 ? a < INT64_MIN / b : (a != 0 && b < INT64_MAX / a)))
+        return TRUE;
+
+    *r = a * b;
+    return FALSE;
+}
+
+
+/**
+ * num_pow_overflow - Checked integer exponentiation
+ *
+ * Exponentiation by squaring; "exp" must not be negative.
+ */
+bool num_pow_overflow(int64_t base, int64_t exp, int64_t* r)
+{
+    int64_t acc = 1;
+
+    while (exp > 0)
+    {
+        if ((exp & 1) && NUM_MUL_OVERFLOW(acc, base, &acc))
+            return TRUE;
+
+        exp >>= 1;
+
+        if (exp > 0 && NUM_MUL_OVERFLOW(base, base, &base))
+            return TRUE;
+    }
+
+    *r = acc;
+    return FALSE;
+}
@@ -0,0 +1,54 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_NUM
+#define LEXY_NUM
+
+#include <stdint.h>
+
+#include "type.h"
+
+
+/* overflow-checked 64-bit integer kernels; each stores the result in "*r"
+   and evaluates to TRUE when it did not fit */
+#if defined(__GNUC__) || defined(__clang__)
+#define NUM_ADD_OVERFLOW(a, b, r) __builtin_add_overflow(a, b, r)
+#define NUM_SUB_OVERFLOW(a, b, r) __builtin_sub_overflow(a, b, r)
+#define NUM_MUL_OVERFLOW(a, b, r) __builtin_mul_overflow(a, b, r)
+#else
+#define NUM_ADD_OVERFLOW(a, b, r) num_add_overflow(a, b, r)
+#define NUM_SUB_OVERFLOW(a, b, r) num_sub_overflow(a, b, r)
+#define NUM_MUL_OVERFLOW(a, b, r) num_mul_overflow(a, b, r)
+#endif
+
+
+bool num_add_overflow (int64_t a, int64_t b, int64_t* r);
+bool num_sub_overflow (int64_t a, int64_t b, int64_t* r);
+bool num_mul_overflow (int64_t a, int64_t b, int64_t* r);
+bool num_pow_overflow (int64_t base, int64_t exp, int64_t* r);
+
+#endif
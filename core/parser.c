@@ -25,51 +25,127 @@
 
  */
 
+#include <string.h>
+
+#include "eval.h"
 #include "parser.h"
 #include "type.h"
 
 
-static bool parser_has_been_initialized = FALSE;
+lval_T* lval_qexpr (void);
+lval_T* lval_sym   (const char* s);
+
+
+/* token patterns of the language, which reads as
+
+     atom  : <number> | <string> | <symbol> | <sexpr> | <qexpr> | <comment>
+     sexpr : '(' <atom>* ')'
+     qexpr : '{' <atom>* '}'
+     lisp  : /^/ <atom>* /$/ */
+#define LPARSER_NUMBER  "-?[0-9]+(\\.[0-9]*)?"
+#define LPARSER_STRING  "\"(\\\\.|[^\"\\\\])*\""
+#define LPARSER_COMMENT ";[^\\r\\n]*"
+#define LPARSER_SYMBOL  "[a-zA-Z0-9_+\\-*/\\\\=<>!&]+"
+
+
+static mpc_val_t* parser_read_number(mpc_val_t* x)
+{
+    lval_T* v = lval_rnumstr(x);
+    free(x);
+
+    return v;
+}
+
+static mpc_val_t* parser_read_string(mpc_val_t* x)
+{
+    /* unescaped without the quotes */
+    char*  s      = x;
+    size_t length = strlen(s);
+
+    memmove(s, s + 1, length - 2);
+    s[length - 2] = '\0';
+
+    s = mpcf_unescape(s);
+    lval_T* v = lval_str(s);
+
+    free(s);
+    return v;
+}
 
-mpc_parser_t* Lisp;
-static mpc_parser_t* Number;
-static mpc_parser_t* String;
-static mpc_parser_t* Comment;
-static mpc_parser_t* Symbol;
-static mpc_parser_t* SExpr;
-static mpc_parser_t* QExpr;
-static mpc_parser_t* Atom;
+static mpc_val_t* parser_read_symbol(mpc_val_t* x)
+{
+    lval_T* v = lval_sym(x);
+    free(x);
 
+    return v;
+}
 
-void parser_init(void)
+/* comments come out of "read_atom" as NULL and are dropped here */
+static lval_T* parser_read_fold(lval_T* v, int n, mpc_val_t** xs)
 {
-    Number  = mpc_new("number");
-    String  = mpc_new("string");
-    Comment = mpc_new("comment");
-    Symbol  = mpc_new("symbol");
-    SExpr   = mpc_new("sexpr");
-    QExpr   = mpc_new("qexpr");
-    Atom    = mpc_new("atom");
-    Lisp    = mpc_new("lisp");
-
-    mpca_lang(MPCA_LANG_DEFAULT,
-        " number  : /-?[0-9]+\\.?[0-9]*/ ;             "
-        " string  : /\"(\\\\.|[^\"])*\"/ ;             "
-        " comment : /;[^\\r\\n]*/ ;                    "
-        " symbol  : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/ ; "
-        " sexpr   :  '(' <atom>* ')' ;                 "
-        " qexpr   :  '{' <atom>* '}' ;                 "
-        " atom    :  <number> | <string> | <symbol> |  "
-        "            <sexpr>  | <qexpr>  | <comment> ; "
-        " lisp    :  /^/ <atom>* /$/ ;                 ",
-
-        Number, String, Comment, Symbol, SExpr, QExpr, Atom, Lisp);
-
-    parser_has_been_initialized = TRUE;
+    for (int i = 0; i < n; i++)
+        if (xs[i] != NULL)
+            v = lval_add(v, xs[i]);
+
+    return v;
 }
 
-void parser_safe_cleanup(void)
+static mpc_val_t* parser_read_sexpr(int n, mpc_val_t** xs)
 {
-    if (parser_has_been_initialized)
-        mpc_cleanup(8, Number, String, Comment, Symbol, SExpr, QExpr, Atom, Lisp);
+    return parser_read_fold(lval_sexpr(), n, xs);
+}
+
+static mpc_val_t* parser_read_qexpr(int n, mpc_val_t** xs)
+{
+    return parser_read_fold(lval_qexpr(), n, xs);
+}
+
+static void parser_read_del(mpc_val_t* x)
+{
+    lval_del(x);
+}
+
+/* "open" and "close" around any number of atoms, as in the "sexpr" rule */
+static mpc_parser_t* parser_read_list(mpc_parser_t* open, mpc_fold_t f, mpc_parser_t* atom, mpc_parser_t* close)
+{
+    return mpc_and(3, mpcf_snd_free, mpc_tok(open), mpc_many(f, atom), mpc_tok(close),
+                   free, parser_read_del);
+}
+
+void parser_init(lparser_T* p)
+{
+    p->read_atom  = mpc_new("atom");
+    p->read_sexpr = mpc_new("sexpr");
+    p->read_qexpr = mpc_new("qexpr");
+    p->read       = mpc_new("lisp");
+
+    mpc_define(p->read_atom, mpc_or(6,
+        mpc_apply(mpc_tok(mpc_re(LPARSER_NUMBER)), parser_read_number),
+        mpc_apply(mpc_tok(mpc_re_mode(LPARSER_STRING, MPC_RE_DOTALL)), parser_read_string),
+        mpc_apply(mpc_tok(mpc_re(LPARSER_SYMBOL)), parser_read_symbol),
+        p->read_sexpr,
+        p->read_qexpr,
+        mpc_apply(mpc_tok(mpc_re(LPARSER_COMMENT)), mpcf_free)));
+
+    mpc_define(p->read_sexpr,
+        parser_read_list(mpc_char('('), parser_read_sexpr, p->read_atom, mpc_char(')')));
+
+    mpc_define(p->read_qexpr,
+        parser_read_list(mpc_char('{'), parser_read_qexpr, p->read_atom, mpc_char('}')));
+
+    mpc_define(p->read,
+        parser_read_list(mpc_re("^"), parser_read_sexpr, p->read_atom, mpc_re("$")));
+
+    mpc_optimise(p->read_atom);
+    mpc_optimise(p->read_sexpr);
+    mpc_optimise(p->read_qexpr);
+    mpc_optimise(p->read);
+}
+
+void parser_safe_cleanup(lparser_T* p)
+{
+    if (p->read != NULL)
+        mpc_cleanup(4, p->read_atom, p->read_sexpr, p->read_qexpr, p->read);
+
+    p->read = NULL;
 }
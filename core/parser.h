@@ -31,9 +31,20 @@
 #include "mpc.h"
 
 
-extern mpc_parser_t* Lisp;
-
-void parser_init(void);
-void parser_safe_cleanup(void);
+typedef struct lparser_S lparser_T;
+
+/* grammar rules of the language; every VM owns one set. The rules fold the
+   input into lval_T values while it is parsed, so loading code never builds
+   a syntax tree; "read" yields the S-Expression of every top-level form */
+struct lparser_S
+{
+    mpc_parser_t* read_atom;
+    mpc_parser_t* read_sexpr;
+    mpc_parser_t* read_qexpr;
+    mpc_parser_t* read;
+};
+
+void parser_init         (lparser_T* p);
+void parser_safe_cleanup (lparser_T* p);
 
 #endif
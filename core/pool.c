@@ -0,0 +1,349 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "pool.h"
+
+
+/* set on every thread while it runs the body of a parallel loop */
+static LEXY_THREAD_LOCAL bool pool_nested = FALSE;
+
+
+/**
+ * pool_workers - Default number of workers
+ *
+ * Taken from the LEXY_THREADS environment variable when set, otherwise from
+ * the number of online processors.
+ */
+size_t pool_workers(void)
+{
+    long n = 1;
+    char* env = getenv(POOL_WORKERS_ENV);
+
+    if (env != NULL && atol(env) > 0)
+        n = atol(env);
+#ifndef _WIN32
+    else if (sysconf(_SC_NPROCESSORS_ONLN) > 0)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return n > POOL_MAX_WORKERS ? POOL_MAX_WORKERS : (size_t)n;
+}
+
+
+#ifndef _WIN32
+
+struct lpool_range_S;
+struct lpool_job_S;
+struct lpool_worker_S;
+typedef struct lpool_range_S lpool_range_T;
+typedef struct lpool_job_S lpool_job_T;
+typedef struct lpool_worker_S lpool_worker_T;
+
+
+/* indices still owned by a worker; the owner takes chunks from the bottom
+   and thieves split off the top half */
+struct lpool_range_S
+{
+    pthread_mutex_t lock;
+
+    size_t lo;
+    size_t hi;
+};
+
+
+/* a single parallel loop */
+struct lpool_job_S
+{
+    lpool_task task;
+    void*      data;
+
+    size_t chunk;
+    size_t workers;
+
+    lpool_range_T* ranges;
+};
+
+
+/* a thread of the pool; it sleeps between loops */
+struct lpool_worker_S
+{
+    size_t    id;
+    size_t    seen;
+    pthread_t thread;
+};
+
+
+/* the workers are started by the first loop that needs them and kept until
+   the process exits; loops of different threads run one at a time */
+static pthread_mutex_t pool_run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  pool_idle = PTHREAD_COND_INITIALIZER;
+
+static lpool_worker_T pool_threads[POOL_MAX_WORKERS];
+static size_t         pool_started = 1;
+
+/* the loop being run, its number and the workers not done with it yet */
+static lpool_job_T* pool_job  = NULL;
+static size_t       pool_gen  = 0;
+static size_t       pool_busy = 0;
+static bool         pool_quit = FALSE;
+
+
+static bool pool_take(lpool_range_T* r, size_t chunk, size_t* lo, size_t* hi)
+{
+    pthread_mutex_lock(&r->lock);
+
+    bool found = r->lo < r->hi;
+    if (found)
+    {
+        *lo = r->lo;
+        *hi = (r->hi - r->lo) > chunk ? (r->lo + chunk) : r->hi;
+        r->lo = *hi;
+    }
+
+    pthread_mutex_unlock(&r->lock);
+    return found;
+}
+
+
+/**
+ * pool_steal - Work stealing
+ *
+ * Moves the upper half of the first non-empty range of another worker into
+ * the (empty) range of "thief". Since loops never create new work, a failed
+ * scan means every index has already been claimed.
+ */
+static bool pool_steal(lpool_job_T* job, size_t thief)
+{
+    for (size_t k = 1; k < job->workers; k++)
+    {
+        lpool_range_T* victim = &job->ranges[(thief + k) % job->workers];
+        size_t lo = 0, hi = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->lo < victim->hi)
+        {
+            hi = victim->hi;
+            lo = victim->hi - (victim->hi - victim->lo + 1) / 2;
+            victim->hi = lo;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (lo < hi)
+        {
+            lpool_range_T* own = &job->ranges[thief];
+
+            pthread_mutex_lock(&own->lock);
+            own->lo = lo;
+            own->hi = hi;
+            pthread_mutex_unlock(&own->lock);
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+static void pool_work(lpool_job_T* job, size_t id)
+{
+    size_t lo, hi;
+    bool nested = pool_nested;
+
+    pool_nested = TRUE;
+
+    do
+    {
+        while (pool_take(&job->ranges[id], job->chunk, &lo, &hi))
+            for (; lo < hi; lo++)
+                job->task(job->data, lo);
+    }
+    while (pool_steal(job, id));
+
+    pool_nested = nested;
+}
+
+
+static void* pool_thread(void* arg)
+{
+    lpool_worker_T* w = arg;
+
+    pthread_mutex_lock(&pool_lock);
+
+    while (TRUE)
+    {
+        while (!pool_quit && w->seen == pool_gen)
+            pthread_cond_wait(&pool_wake, &pool_lock);
+
+        if (pool_quit)
+            break;
+
+        w->seen = pool_gen;
+        lpool_job_T* job = pool_job;
+
+        pthread_mutex_unlock(&pool_lock);
+
+        /* workers beyond the ones of this loop have nothing to do */
+        if (w->id < job->workers)
+            pool_work(job, w->id);
+
+        pthread_mutex_lock(&pool_lock);
+
+        if (--pool_busy == 0)
+            pthread_cond_signal(&pool_idle);
+    }
+
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+
+/**
+ * pool_stop - Workers shutdown
+ *
+ * Wakes the workers up to quit and joins them, at the exit of the process.
+ */
+static void pool_stop(void)
+{
+    pthread_mutex_lock(&pool_lock);
+    pool_quit = TRUE;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (size_t i = 1; i < pool_started; i++)
+        pthread_join(pool_threads[i].thread, NULL);
+}
+
+
+/* starts the workers that "workers" needs and are not running yet; returns
+   how many run, the calling thread included */
+static size_t pool_start(size_t workers)
+{
+    if (pool_started == 1 && workers > 1)
+        atexit(pool_stop);
+
+    for (; pool_started < workers; pool_started++)
+    {
+        lpool_worker_T* w = &pool_threads[pool_started];
+
+        w->id   = pool_started;
+        w->seen = pool_gen;
+
+        if (pthread_create(&w->thread, NULL, pool_thread, w) != 0)
+            break;
+    }
+
+    return pool_started;
+}
+
+#endif
+
+
+/**
+ * pool_for - Parallel loop
+ *
+ * Calls "task" for every index in [0, count) over "workers" threads (0 picks
+ * "pool_workers"), the calling thread included, and returns once all of them
+ * are done. Indices are handed out "chunk" at a time and idle workers steal
+ * from the busy ones. The worker threads are started once and reused by every
+ * loop. Loops started from inside of a task run sequentially.
+ */
+void pool_for(size_t count, size_t chunk, size_t workers, lpool_task task, void* data)
+{
+    if (workers == 0)
+        workers = pool_workers();
+
+    if (workers > count)
+        workers = count;
+
+    if (workers > POOL_MAX_WORKERS)
+        workers = POOL_MAX_WORKERS;
+
+#ifndef _WIN32
+    if (workers > 1 && !pool_nested)
+    {
+        lpool_job_T job;
+        lpool_range_T ranges[POOL_MAX_WORKERS];
+
+        job.task    = task;
+        job.data    = data;
+        job.chunk   = chunk > 0 ? chunk : 1;
+        job.workers = workers;
+        job.ranges  = ranges;
+
+        for (size_t i = 0; i < workers; i++)
+        {
+            pthread_mutex_init(&ranges[i].lock, NULL);
+            ranges[i].lo = count * i / workers;
+            ranges[i].hi = count * (i + 1) / workers;
+        }
+
+        pthread_mutex_lock(&pool_run_lock);
+
+        /* ranges of threads that could not be started are stolen */
+        size_t running = pool_start(workers);
+
+        pthread_mutex_lock(&pool_lock);
+        pool_job  = &job;
+        pool_busy = running - 1;
+        pool_gen++;
+        pthread_cond_broadcast(&pool_wake);
+        pthread_mutex_unlock(&pool_lock);
+
+        pool_work(&job, 0);
+
+        pthread_mutex_lock(&pool_lock);
+        while (pool_busy > 0)
+            pthread_cond_wait(&pool_idle, &pool_lock);
+
+        pool_job = NULL;
+        pthread_mutex_unlock(&pool_lock);
+
+        pthread_mutex_unlock(&pool_run_lock);
+
+        for (size_t i = 0; i < workers; i++)
+            pthread_mutex_destroy(&ranges[i].lock);
+
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++)
+        task(data, i);
+}
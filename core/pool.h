@@ -0,0 +1,50 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_POOL
+#define LEXY_POOL
+
+#include <stddef.h>
+
+#include "type.h"
+
+
+/* upper bound of worker threads of a single parallel loop */
+#define POOL_MAX_WORKERS 64
+
+/* environment variable that overrides the default number of workers */
+#define POOL_WORKERS_ENV "LEXY_THREADS"
+
+
+/* body of a parallel loop; called once for every index */
+typedef void (*lpool_task)(void* data, size_t index);
+
+
+size_t pool_workers (void);
+void   pool_for     (size_t count, size_t chunk, size_t workers, lpool_task task, void* data);
+
+#endif
@@ -0,0 +1,338 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "prof.h"
+
+#include "fmt.h"
+#include "type.h"
+
+
+/* name of the frame that holds everything outside of a function call */
+#define PROF_ROOT_NAME "[top-level]"
+
+
+struct lprof_node_S;
+struct lprof_fn_S;
+typedef struct lprof_node_S lprof_node_T;
+typedef struct lprof_fn_S lprof_fn_T;
+
+
+/* node of the calling-context tree: one per distinct call path */
+struct lprof_node_S
+{
+    char*  name;
+    size_t calls;
+
+    volatile sig_atomic_t samples;
+
+    lprof_node_T* parent;
+    lprof_node_T* child;
+    lprof_node_T* sibling;
+};
+
+
+/* per-function totals, aggregated over every call path */
+struct lprof_fn_S
+{
+    const char* name;
+
+    size_t calls;
+    size_t self;
+    size_t inclusive;
+    size_t active;
+};
+
+
+LEXY_THREAD_LOCAL bool prof_running = FALSE;
+
+static lprof_node_T* prof_root = NULL;
+static lprof_node_T* volatile prof_current = NULL;
+
+
+static lprof_node_T* prof_node_new(const char* name, lprof_node_T* parent)
+{
+    lprof_node_T* n = malloc(sizeof(struct lprof_node_S));
+    n->name = malloc(strlen(name) + 1);
+    strcpy(n->name, name);
+
+    n->calls   = 0;
+    n->samples = 0;
+    n->parent  = parent;
+    n->child   = NULL;
+    n->sibling = NULL;
+
+    return n;
+}
+
+
+static void prof_node_del(lprof_node_T* n)
+{
+    while (n->child != NULL)
+    {
+        lprof_node_T* c = n->child;
+        n->child = c->sibling;
+
+        prof_node_del(c);
+    }
+
+    free(n->name);
+    free(n);
+}
+
+
+#ifndef _WIN32
+/**
+ * prof_on_sample - SIGPROF handler
+ *
+ * Charges one sample to the call path being executed. It only touches the
+ * current node, so it is safe to run at any point of the evaluation.
+ */
+static void prof_on_sample(int sign)
+{
+    prof_current->samples++;
+}
+
+
+static bool prof_timer(long usec)
+{
+    struct itimerval it;
+    it.it_interval.tv_sec  = 0;
+    it.it_interval.tv_usec = usec;
+    it.it_value = it.it_interval;
+
+    return setitimer(ITIMER_PROF, &it, NULL) == 0;
+}
+#endif
+
+
+/**
+ * prof_start - Profiler start
+ *
+ * Starts tracking the Lisp-level call stack and sampling it on a CPU-time
+ * timer. Returns FALSE if the timer could not be armed; calls are still
+ * counted in that case.
+ */
+bool prof_start(void)
+{
+    if (prof_root != NULL)
+        prof_node_del(prof_root);
+
+    prof_root    = prof_node_new(PROF_ROOT_NAME, NULL);
+    prof_current = prof_root;
+    prof_running = TRUE;
+
+#ifndef _WIN32
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(struct sigaction));
+
+    sa.sa_handler = prof_on_sample;
+    sa.sa_flags   = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+
+    return sigaction(SIGPROF, &sa, NULL) == 0 && prof_timer(PROF_INTERVAL_USEC);
+#else
+    return FALSE;
+#endif
+}
+
+
+/**
+ * prof_stop - Profiler stop
+ */
+void prof_stop(void)
+{
+#ifndef _WIN32
+    prof_timer(0);
+    signal(SIGPROF, SIG_IGN);
+#endif
+
+    prof_running = FALSE;
+}
+
+
+/**
+ * prof_enter - Push a function onto the profiled call stack
+ */
+void prof_enter(const char* name)
+{
+    lprof_node_T* n = prof_current->child;
+
+    while (n != NULL && !strequ(n->name, name))
+        n = n->sibling;
+
+    if (n == NULL)
+    {
+        n = prof_node_new(name, prof_current);
+        n->sibling = prof_current->child;
+        prof_current->child = n;
+    }
+
+    n->calls++;
+    prof_current = n;
+}
+
+
+/**
+ * prof_leave - Pop a function from the profiled call stack
+ */
+void prof_leave(void)
+{
+    if (prof_current->parent != NULL)
+        prof_current = prof_current->parent;
+}
+
+
+typedef struct lprof_walk_S
+{
+    FILE* folded;
+
+    const char** path;
+    size_t path_cap;
+
+    lprof_fn_T* fns;
+    size_t fns_num;
+}
+lprof_walk_T;
+
+
+static lprof_fn_T* prof_fn(lprof_walk_T* w, const char* name)
+{
+    for (size_t i = 0; i < w->fns_num; i++)
+    {
+        if (strequ(w->fns[i].name, name))
+            return &w->fns[i];
+    }
+
+    w->fns = realloc(w->fns, sizeof(struct lprof_fn_S) * (w->fns_num + 1));
+
+    lprof_fn_T* fn = &w->fns[w->fns_num++];
+    fn->name      = name;
+    fn->calls     = 0;
+    fn->self      = 0;
+    fn->inclusive = 0;
+    fn->active    = 0;
+
+    return fn;
+}
+
+
+/* prints the folded stacks below "n" and returns the samples of its subtree */
+static size_t prof_walk(lprof_walk_T* w, lprof_node_T* n, size_t depth)
+{
+    if (depth == w->path_cap)
+    {
+        w->path_cap = w->path_cap ? (w->path_cap * 2) : 64;
+        w->path = realloc(w->path, sizeof(char*) * w->path_cap);
+    }
+
+    w->path[depth] = n->name;
+
+    if (n->samples > 0 && w->folded != NULL)
+    {
+        for (size_t i = 0; i <= depth; i++)
+            fprintf(w->folded, i ? ";%s" : "%s", w->path[i]);
+
+        fprintf(w->folded, " %lu\n", (unsigned long)n->samples);
+    }
+
+    size_t total = (size_t)n->samples;
+
+    prof_fn(w, n->name)->active++;
+    for (lprof_node_T* c = n->child; c != NULL; c = c->sibling)
+        total += prof_walk(w, c, depth + 1);
+
+    /* "w->fns" may move while walking the children */
+    lprof_fn_T* fn = prof_fn(w, n->name);
+    fn->calls += n->calls;
+    fn->self  += (size_t)n->samples;
+
+    /* recursive calls are only accounted once, at the outermost frame */
+    if (--fn->active == 0)
+        fn->inclusive += total;
+
+    return total;
+}
+
+
+static int prof_fn_cmp(const void* a, const void* b)
+{
+    const lprof_fn_T* x = a;
+    const lprof_fn_T* y = b;
+
+    if (x->self != y->self)
+        return x->self < y->self ? 1 : -1;
+
+    if (x->calls != y->calls)
+        return x->calls < y->calls ? 1 : -1;
+
+    return strcmp(x->name, y->name);
+}
+
+
+/**
+ * prof_report - Profiler report
+ *
+ * Writes one "frame;frame;frame samples" line per sampled call path to
+ * "folded" (the input format of flamegraph.pl and friends), and a table of
+ * the functions with the most self samples to "table".
+ */
+void prof_report(FILE* folded, FILE* table)
+{
+    if (prof_root == NULL)
+        return;
+
+    lprof_walk_T w = { folded, NULL, 0, NULL, 0 };
+    size_t total = prof_walk(&w, prof_root, 0);
+
+    qsort(w.fns, w.fns_num, sizeof(struct lprof_fn_S), prof_fn_cmp);
+
+    fprintf(table,
+            "\n>>> lexy profile (%lu samples, %d usec interval)\n"
+            "%10s %7s %10s %7s %12s  %s\n",
+            (unsigned long)total, PROF_INTERVAL_USEC,
+            "self", "self%", "incl", "incl%", "calls", "function");
+
+    for (size_t i = 0; i < w.fns_num && i < PROF_REPORT_TOP; i++)
+    {
+        lprof_fn_T* fn = &w.fns[i];
+
+        fprintf(table, "%10lu %6.2f%% %10lu %6.2f%% %12lu  %s\n",
+                (unsigned long)fn->self, total ? (100.0 * fn->self / total) : 0.0,
+                (unsigned long)fn->inclusive, total ? (100.0 * fn->inclusive / total) : 0.0,
+                (unsigned long)fn->calls, fn->name);
+    }
+
+    free(w.path);
+    free(w.fns);
+}
@@ -0,0 +1,62 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_PROF
+#define LEXY_PROF
+
+#include <stdio.h>
+
+#include "type.h"
+
+
+/* sampling interval of the profiler timer, in microseconds */
+#define PROF_INTERVAL_USEC 1000
+
+/* number of functions listed by the top-N table */
+#define PROF_REPORT_TOP 20
+
+/* file that receives the folded stacks */
+#define PROF_FOLDED_FILE "lexy-prof.folded"
+
+
+#define PROF_ENTER(name) \
+    if (prof_running) { prof_enter(name); }
+
+#define PROF_LEAVE() \
+    if (prof_running) { prof_leave(); }
+
+
+/* set only on the thread that started the profiler */
+extern LEXY_THREAD_LOCAL bool prof_running;
+
+bool prof_start  (void);
+void prof_stop   (void);
+void prof_enter  (const char* name);
+void prof_leave  (void);
+void prof_report (FILE* folded, FILE* table);
+
+#endif
@@ -0,0 +1,304 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader.h"
+
+
+void lreader_init(lreader_T* r)
+{
+    r->capacity = LREADER_INITIAL_BYTES;
+    r->data     = malloc(r->capacity);
+    r->length   = 0;
+
+    r->scanned    = 0;
+    r->complete   = 0;
+    r->depth      = 0;
+    r->in_string  = FALSE;
+    r->escaped    = FALSE;
+    r->in_comment = FALSE;
+    r->in_atom    = FALSE;
+}
+
+
+void lreader_free(lreader_T* r)
+{
+    free(r->data);
+    r->data = NULL;
+}
+
+
+/* bytes that end a symbol or a number */
+static bool lreader_delimiter(char c)
+{
+    return isspace((unsigned char)c) || strchr("(){}\";", c) != NULL;
+}
+
+
+/**
+ * lreader_step - Form boundary detection
+ *
+ * Follows the lexical rules of the grammar (strings with escapes, comments
+ * up to the end of the line, nesting) over byte "i". Returns where the first
+ * top-level form that ends at this byte does, or 0. Line breaks outside of
+ * strings and lists also leave only whole forms behind them.
+ */
+static size_t lreader_step(lreader_T* r, size_t i)
+{
+    char   c     = r->data[i];
+    size_t end   = 0;
+    size_t close = 0;
+
+    if (r->in_string)
+    {
+        if (r->escaped)
+            r->escaped = FALSE;
+        else if (c == '\\')
+            r->escaped = TRUE;
+        else if (c == '"')
+        {
+            r->in_string = FALSE;
+            if (r->depth == 0)
+                end = r->complete = i + 1;
+        }
+
+        return end;
+    }
+
+    if (r->in_comment && c != '\n')
+        return 0;
+
+    /* a top-level atom ends right before the first byte that is not its own */
+    if (r->in_atom && lreader_delimiter(c))
+    {
+        r->in_atom = FALSE;
+        end = i;
+    }
+
+    switch (c)
+    {
+        case '"':
+            r->in_string = TRUE;
+            break;
+
+        case ';':
+            r->in_comment = TRUE;
+            break;
+
+        case '(':
+        case '{':
+            r->depth++;
+            break;
+
+        /* unbalanced closings are left for the parser to report, on their own */
+        case ')':
+        case '}':
+            if (r->depth > 0)
+                r->depth--;
+            if (r->depth == 0)
+                close = i + 1;
+            break;
+
+        case '\n':
+            r->in_comment = FALSE;
+            if (r->depth == 0)
+                r->complete = i + 1;
+            break;
+
+        default:
+            if (r->depth == 0 && !lreader_delimiter(c))
+                r->in_atom = TRUE;
+            break;
+    }
+
+    if (close > r->complete)
+        r->complete = close;
+    else if (end > r->complete)
+        r->complete = end;
+
+    return end ? end : close;
+}
+
+
+/* runs "lreader_step" over the bytes not seen yet */
+static void lreader_scan(lreader_T* r)
+{
+    for (size_t i = r->scanned; i < r->length; i++)
+        lreader_step(r, i);
+
+    r->scanned = r->length;
+}
+
+
+/**
+ * lreader_feed - Source text input
+ *
+ * Appends "n" bytes of "bytes"; only those bytes are scanned.
+ */
+void lreader_feed(lreader_T* r, const char* bytes, size_t n)
+{
+    if (r->length + n > r->capacity)
+    {
+        while (r->length + n > r->capacity)
+            r->capacity *= 2;
+
+        r->data = realloc(r->data, r->capacity);
+    }
+
+    memcpy(r->data + r->length, bytes, n);
+    r->length += n;
+
+    lreader_scan(r);
+}
+
+
+/**
+ * lreader_ready - Whether everything fed so far is made of whole forms
+ */
+bool lreader_ready(lreader_T* r)
+{
+    return r->complete == r->length;
+}
+
+
+/**
+ * lreader_empty - Whether nothing is buffered
+ */
+bool lreader_empty(lreader_T* r)
+{
+    return r->length == 0;
+}
+
+
+/* moves the first "n" bytes out into a new NUL-terminated string */
+static char* lreader_cut(lreader_T* r, size_t n)
+{
+    char* s = malloc(n + 1);
+
+    memcpy(s, r->data, n);
+    s[n] = '\0';
+
+    memmove(r->data, r->data + n, r->length - n);
+    r->length  -= n;
+    r->scanned -= n;
+    r->complete = r->complete > n ? r->complete - n : 0;
+
+    return s;
+}
+
+
+/**
+ * lreader_take - Whole forms extraction
+ *
+ * Returns the bytes that hold whole forms as a new NUL-terminated string,
+ * or every byte buffered when "all" is set (at the end of the input, so
+ * that an unfinished form reaches the parser and is reported). The rest
+ * stays buffered for the next pieces.
+ */
+char* lreader_take(lreader_T* r, bool all)
+{
+    char* s = lreader_cut(r, all ? r->length : r->complete);
+
+    if (all)
+    {
+        r->depth      = 0;
+        r->in_string  = FALSE;
+        r->escaped    = FALSE;
+        r->in_comment = FALSE;
+        r->in_atom    = FALSE;
+    }
+
+    return s;
+}
+
+
+/**
+ * lreader_take_form - Single form extraction
+ *
+ * Returns the first whole form buffered, with the blanks and comments before
+ * it, as a new NUL-terminated string, or NULL if there is none. Its bytes are
+ * scanned again, from the start of the buffer.
+ */
+char* lreader_take_form(lreader_T* r)
+{
+    lreader_T first = *r;
+
+    first.complete   = 0;
+    first.depth      = 0;
+    first.in_string  = FALSE;
+    first.escaped    = FALSE;
+    first.in_comment = FALSE;
+    first.in_atom    = FALSE;
+
+    size_t end = 0;
+    for (size_t i = 0; i < r->complete && end == 0; i++)
+        end = lreader_step(&first, i);
+
+    return end > 0 ? lreader_cut(r, end) : NULL;
+}
+
+
+/**
+ * lreader_getline - Line reading
+ *
+ * Reads a line of any length from "stream", without its line break, as a
+ * new string. Returns NULL at the end of the input.
+ */
+char* lreader_getline(FILE* stream)
+{
+    size_t capacity = 128;
+    size_t length   = 0;
+    char*  line     = malloc(capacity);
+
+    while (fgets(line + length, capacity - length, stream) != NULL)
+    {
+        length += strlen(line + length);
+
+        if (length > 0 && line[length - 1] == '\n')
+        {
+            line[length - 1] = '\0';
+            return line;
+        }
+
+        if (length + 1 == capacity)
+        {
+            capacity *= 2;
+            line = realloc(line, capacity);
+        }
+    }
+
+    if (length == 0)
+    {
+        free(line);
+        return NULL;
+    }
+
+    return line;
+}
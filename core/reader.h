@@ -0,0 +1,71 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_READER
+#define LEXY_READER
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "type.h"
+
+
+/* bytes of a new reader buffer */
+#define LREADER_INITIAL_BYTES 256
+
+
+typedef struct lreader_S lreader_T;
+
+/* source text fed in pieces (lines, chunks), scanned once as it arrives to
+   find where its top-level forms end; nothing is parsed until they do */
+struct lreader_S
+{
+    char*  data;
+    size_t length;
+    size_t capacity;
+
+    size_t scanned;   /* bytes already looked at */
+    size_t complete;  /* bytes that only hold whole forms */
+    size_t depth;     /* open parentheses and braces */
+    bool   in_string;
+    bool   escaped;
+    bool   in_comment;
+    bool   in_atom;   /* in a top-level symbol or number */
+};
+
+
+void   lreader_init  (lreader_T* r);
+void   lreader_free  (lreader_T* r);
+void   lreader_feed  (lreader_T* r, const char* bytes, size_t n);
+bool   lreader_ready (lreader_T* r);
+bool   lreader_empty (lreader_T* r);
+char*  lreader_take  (lreader_T* r, bool all);
+char*  lreader_take_form (lreader_T* r);
+
+char*  lreader_getline (FILE* stream);
+
+#endif
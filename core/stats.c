@@ -0,0 +1,302 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(LEXY_WITH_STATS) && !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+#include "stats.h"
+
+#include "fmt.h"
+#include "type.h"
+
+
+lval_T* lval_add   (lval_T* v, lval_T* x);
+lval_T* lval_int   (int64_t n);
+lval_T* lval_qexpr (void);
+lval_T* lval_sym   (const char* s);
+
+
+#ifdef LEXY_WITH_STATS
+
+#define STATS_FN_INITIAL_SIZE 64
+
+
+/* call counter of a single function */
+typedef struct lstats_fn_S
+{
+    char*  name;
+    bool   builtin;
+    size_t calls;
+}
+lstats_fn_T;
+
+
+lstats_T lexy_stats;
+
+/* open-addressed table of per-function counters, keyed by name */
+static lstats_fn_T* stats_fns      = NULL;
+static size_t       stats_fns_size = 0;
+static size_t       stats_fns_used = 0;
+
+/* parallel tasks (see: pool.c) account calls concurrently; the plain
+   counters are not synchronized and are approximate under "par" */
+#ifndef _WIN32
+static pthread_mutex_t stats_fns_lock = PTHREAD_MUTEX_INITIALIZER;
+#define STATS_FNS_LOCK()   pthread_mutex_lock(&stats_fns_lock)
+#define STATS_FNS_UNLOCK() pthread_mutex_unlock(&stats_fns_lock)
+#else
+#define STATS_FNS_LOCK()
+#define STATS_FNS_UNLOCK()
+#endif
+
+
+static size_t stats_hash(const char* s)
+{
+    size_t h = 2166136261u;
+
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+
+    return h;
+}
+
+
+static lstats_fn_T* stats_fn_slot(lstats_fn_T* table, size_t size, const char* name)
+{
+    size_t i = stats_hash(name) & (size - 1);
+
+    while (table[i].name != NULL && !strequ(table[i].name, name))
+        i = (i + 1) & (size - 1);
+
+    return &table[i];
+}
+
+
+static void stats_fn_grow(void)
+{
+    size_t nsize = stats_fns_size ? (stats_fns_size * 2) : STATS_FN_INITIAL_SIZE;
+    lstats_fn_T* ntable = calloc(nsize, sizeof(struct lstats_fn_S));
+
+    for (size_t i = 0; i < stats_fns_size; i++)
+    {
+        if (stats_fns[i].name != NULL)
+            *stats_fn_slot(ntable, nsize, stats_fns[i].name) = stats_fns[i];
+    }
+
+    free(stats_fns);
+    stats_fns      = ntable;
+    stats_fns_size = nsize;
+}
+
+
+/**
+ * stats_probe - Account a single symbol lookup
+ *
+ * "length" is the number of symbols compared until the lookup finished.
+ */
+void stats_probe(size_t length)
+{
+    lexy_stats.lenv_get++;
+    lexy_stats.lenv_get_probes += length;
+
+    if (length > lexy_stats.lenv_get_max_probe)
+        lexy_stats.lenv_get_max_probe = length;
+}
+
+
+/**
+ * stats_call - Account a single function call
+ */
+void stats_call(const char* name, bool builtin)
+{
+    if (builtin)
+        lexy_stats.builtin_calls++;
+    else
+        lexy_stats.lambda_calls++;
+
+    STATS_FNS_LOCK();
+
+    if ((stats_fns_used + 1) * 2 > stats_fns_size)
+        stats_fn_grow();
+
+    lstats_fn_T* fn = stats_fn_slot(stats_fns, stats_fns_size, name);
+    if (fn->name == NULL)
+    {
+        fn->name = malloc(strlen(name) + 1);
+        fn->builtin = builtin;
+        strcpy(fn->name, name);
+
+        stats_fns_used++;
+    }
+
+    fn->calls++;
+    STATS_FNS_UNLOCK();
+}
+
+
+static int stats_fn_cmp(const void* a, const void* b)
+{
+    const lstats_fn_T* x = *(const lstats_fn_T* const*)a;
+    const lstats_fn_T* y = *(const lstats_fn_T* const*)b;
+
+    if (x->calls != y->calls)
+        return x->calls < y->calls ? 1 : -1;
+
+    return strcmp(x->name, y->name);
+}
+
+
+/* per-function counters, most called first */
+static lstats_fn_T** stats_fn_sorted(void)
+{
+    lstats_fn_T** fns = malloc(sizeof(lstats_fn_T*) * (stats_fns_used + 1));
+    size_t n = 0;
+
+    for (size_t i = 0; i < stats_fns_size; i++)
+    {
+        if (stats_fns[i].name != NULL)
+            fns[n++] = &stats_fns[i];
+    }
+
+    qsort(fns, n, sizeof(lstats_fn_T*), stats_fn_cmp);
+    return fns;
+}
+
+
+bool stats_enabled(void)
+{
+    return TRUE;
+}
+
+
+/**
+ * stats_report - Instrumentation report
+ *
+ * Writes every counter in a human readable form to "out".
+ */
+void stats_report(FILE* out)
+{
+    double avg_probe = lexy_stats.lenv_get
+        ? ((double)lexy_stats.lenv_get_probes / lexy_stats.lenv_get)
+        : 0;
+
+    fprintf(out,
+            "\n>>> lexy stats\n"
+            "lval_new      : %lu\n"
+            "lval_copy     : %lu\n"
+            "lval_del      : %lu\n"
+            "lenv_copy     : %lu\n"
+            "lenv_get      : %lu (avg. probe %.2f, max. probe %lu)\n"
+            "lambda calls  : %lu\n"
+            "builtin calls : %lu\n",
+            (unsigned long)lexy_stats.lval_new,
+            (unsigned long)lexy_stats.lval_copy,
+            (unsigned long)lexy_stats.lval_del,
+            (unsigned long)lexy_stats.lenv_copy,
+            (unsigned long)lexy_stats.lenv_get, avg_probe,
+            (unsigned long)lexy_stats.lenv_get_max_probe,
+            (unsigned long)lexy_stats.lambda_calls,
+            (unsigned long)lexy_stats.builtin_calls);
+
+    if (stats_fns_used == 0)
+        return;
+
+    fprintf(out, "\n>>> calls per function\n");
+
+    lstats_fn_T** fns = stats_fn_sorted();
+    for (size_t i = 0; i < stats_fns_used; i++)
+    {
+        fprintf(out, "%12lu  %s%s\n",
+                (unsigned long)fns[i]->calls, fns[i]->name,
+                fns[i]->builtin ? " (builtin)" : "");
+    }
+
+    free(fns);
+}
+
+
+static lval_T* stats_pair(const char* name, size_t value)
+{
+    lval_T* pair = lval_add(lval_qexpr(), lval_sym(name));
+    return lval_add(pair, lval_int((int64_t)value));
+}
+
+
+/**
+ * stats_lval - Instrumentation counters as a TL value
+ *
+ * Returns a Q-Expression of {name value} pairs. The per-function counters are
+ * nested under the "calls" pair.
+ */
+lval_T* stats_lval(void)
+{
+    lval_T* v = lval_qexpr();
+
+    v = lval_add(v, stats_pair("lval-new", lexy_stats.lval_new));
+    v = lval_add(v, stats_pair("lval-copy", lexy_stats.lval_copy));
+    v = lval_add(v, stats_pair("lval-del", lexy_stats.lval_del));
+    v = lval_add(v, stats_pair("lenv-copy", lexy_stats.lenv_copy));
+    v = lval_add(v, stats_pair("lenv-get", lexy_stats.lenv_get));
+    v = lval_add(v, stats_pair("lenv-get-probes", lexy_stats.lenv_get_probes));
+    v = lval_add(v, stats_pair("lenv-get-max-probe", lexy_stats.lenv_get_max_probe));
+    v = lval_add(v, stats_pair("lambda-calls", lexy_stats.lambda_calls));
+    v = lval_add(v, stats_pair("builtin-calls", lexy_stats.builtin_calls));
+
+    lval_T* calls = lval_qexpr();
+    lstats_fn_T** fns = stats_fn_sorted();
+
+    for (size_t i = 0; i < stats_fns_used; i++)
+        calls = lval_add(calls, stats_pair(fns[i]->name, fns[i]->calls));
+
+    free(fns);
+    return lval_add(v, lval_add(lval_add(lval_qexpr(), lval_sym("calls")), calls));
+}
+
+#else
+
+bool stats_enabled(void)
+{
+    return FALSE;
+}
+
+
+void stats_report(FILE* out)
+{
+    fprintf(out, "\nlexy has been built without instrumentation (see: make build-stats)\n");
+}
+
+
+lval_T* stats_lval(void)
+{
+    return lval_qexpr();
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_STATS
+#define LEXY_STATS
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "type.h"
+
+
+/* name under which calls to unnamed lambdas are accounted */
+#define STATS_ANONYMOUS_FN "<lambda>"
+
+
+#ifdef LEXY_WITH_STATS
+/* --- */
+#define STATS_INC(counter)     (lexy_stats.counter++)
+#define STATS_PROBE(length)    stats_probe(length)
+#define STATS_CALL(name, btin) stats_call(name, btin)
+
+
+/* global interpreter counters */
+typedef struct lstats_S
+{
+    size_t lval_new;
+    size_t lval_copy;
+    size_t lval_del;
+    size_t lenv_copy;
+
+    size_t lenv_get;
+    size_t lenv_get_probes;
+    size_t lenv_get_max_probe;
+
+    size_t lambda_calls;
+    size_t builtin_calls;
+}
+lstats_T;
+
+extern lstats_T lexy_stats;
+
+void stats_probe (size_t length);
+void stats_call  (const char* name, bool builtin);
+
+#else
+/* --- */
+#define STATS_INC(counter)
+#define STATS_PROBE(length)    ((void)(length))
+#define STATS_CALL(name, btin)
+#endif
+
+
+/* ... */
+bool    stats_enabled (void);
+void    stats_report  (FILE* out);
+lval_T* stats_lval    (void);
+
+#endif
@@ -0,0 +1,192 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <string.h>
+
+#include "str.h"
+
+
+/**
+ * lstr_new - Flat string storage
+ *
+ * Copies "length" bytes of "s" into a new storage with a single reference. When
+ * "s" is NULL the bytes are left for the caller to fill in.
+ */
+lstr_T* lstr_new(const char* s, size_t length)
+{
+    lstr_T* str = malloc(sizeof(lstr_T) + length + 1);
+
+    str->refs   = 1;
+    str->length = length;
+    str->left   = NULL;
+    str->right  = NULL;
+
+    if (s != NULL)
+        memcpy(str->data, s, length);
+
+    str->data[length] = '\0';
+    return str;
+}
+
+
+lstr_T* lstr_retain(lstr_T* s)
+{
+    LEXY_REF_INC(s);
+    return s;
+}
+
+
+/**
+ * lstr_release - String storage reference dropping
+ *
+ * Frees the storage once its last reference is gone. A chain of appends is
+ * as deep as it is long, so dead rope nodes are unwound with an explicit
+ * stack threaded through their own "left" links instead of recursion.
+ */
+void lstr_release(lstr_T* s)
+{
+    lstr_T* stack = NULL;
+
+    while (s != NULL)
+    {
+        if (LEXY_REF_DEC(s) == 0)
+        {
+            if (s->left == NULL)
+            {
+                free(s);
+            }
+            else
+            {
+                lstr_T* left = s->left;
+                s->left = stack;
+                stack = s;
+                s = left;
+                continue;
+            }
+        }
+
+        if (stack == NULL)
+            break;
+
+        lstr_T* top = stack;
+        stack = top->left;
+        s = top->right;
+        free(top);
+    }
+}
+
+
+/**
+ * lstr_concat - String storage concatenation
+ *
+ * Takes over both references. Long results are rope nodes, which makes
+ * repeated appends O(1) each; the bytes are only copied once, when the rope
+ * is flattened.
+ */
+lstr_T* lstr_concat(lstr_T* left, lstr_T* right)
+{
+    lstr_T* str;
+
+    if (right->length == 0)
+    {
+        lstr_release(right);
+        return left;
+    }
+
+    if (left->length == 0)
+    {
+        lstr_release(left);
+        return right;
+    }
+
+    /* ropes are never shorter than LSTR_ROPE_MIN_BYTES, so both are flat */
+    if (left->length + right->length < LSTR_ROPE_MIN_BYTES)
+    {
+        str = lstr_new(NULL, left->length + right->length);
+        memcpy(str->data, left->data, left->length);
+        memcpy(str->data + left->length, right->data, right->length);
+
+        lstr_release(left);
+        lstr_release(right);
+        return str;
+    }
+
+    str = malloc(sizeof(lstr_T));
+    str->refs   = 1;
+    str->length = left->length + right->length;
+    str->left   = left;
+    str->right  = right;
+
+    return str;
+}
+
+
+/**
+ * lstr_flatten - String storage flattening
+ *
+ * Takes over the reference to "s" and returns a flat storage with the same
+ * contents, which is "s" itself when it already is flat. The rope is walked
+ * with an explicit stack that stays shallow for left- and right-leaning
+ * chains alike.
+ */
+lstr_T* lstr_flatten(lstr_T* s)
+{
+    if (s->left == NULL)
+        return s;
+
+    lstr_T* flat = lstr_new(NULL, s->length);
+
+    size_t capacity = 16, depth = 0, pos = 0;
+    lstr_T** stack = malloc(capacity * sizeof(lstr_T*));
+
+    stack[depth++] = s;
+    while (depth > 0)
+    {
+        lstr_T* node = stack[--depth];
+
+        if (node->left == NULL)
+        {
+            memcpy(flat->data + pos, node->data, node->length);
+            pos += node->length;
+            continue;
+        }
+
+        if (depth + 2 > capacity)
+        {
+            capacity *= 2;
+            stack = realloc(stack, capacity * sizeof(lstr_T*));
+        }
+
+        stack[depth++] = node->right;
+        stack[depth++] = node->left;
+    }
+
+    free(stack);
+    lstr_release(s);
+
+    return flat;
+}
@@ -0,0 +1,61 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_STR
+#define LEXY_STR
+
+#include <stddef.h>
+
+#include "type.h"
+
+
+/* concatenations shorter than this are copied flat instead of building a rope */
+#define LSTR_ROPE_MIN_BYTES 64
+
+
+/* shared, immutable and reference-counted string storage. Flat storages hold
+   "length" bytes plus a terminating NUL; rope nodes hold no bytes and join
+   the contents of "left" and "right" */
+struct lstr_S
+{
+    size_t refs;
+    size_t length;
+
+    lstr_T* left;
+    lstr_T* right;
+
+    char data[];
+};
+
+
+lstr_T* lstr_new     (const char* s, size_t length);
+lstr_T* lstr_retain  (lstr_T* s);
+void    lstr_release (lstr_T* s);
+lstr_T* lstr_concat  (lstr_T* left, lstr_T* right);
+lstr_T* lstr_flatten (lstr_T* s);
+
+#endif
@@ -28,6 +28,7 @@
 #ifndef LEXY_TYPE
 #define LEXY_TYPE
 
+#include <stdint.h>
 #include <stdlib.h>
 
 
@@ -36,17 +37,42 @@
 #define TRUE 1
 #define FALSE 0
 
+/* storage class of per-thread interpreter state */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define LEXY_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define LEXY_THREAD_LOCAL __declspec(thread)
+#else
+#define LEXY_THREAD_LOCAL __thread
+#endif
+
+/* reference counts of values shared by the parallel workers */
+#if defined(__GNUC__) || defined(__clang__)
+#define LEXY_REF_INC(x) __atomic_add_fetch(&(x)->refs, 1, __ATOMIC_RELAXED)
+#define LEXY_REF_DEC(x) __atomic_sub_fetch(&(x)->refs, 1, __ATOMIC_ACQ_REL)
+#else
+#define LEXY_REF_INC(x) (++(x)->refs)
+#define LEXY_REF_DEC(x) (--(x)->refs)
+#endif
+
 /* ... */
 #define TLERR_BAD_NUM          "invalid number\n"
 #define TLERR_DIV_ZERO         "division by zero\n"
 #define TLERR_UNBOUND_SYM      "unbound symbol '%s'\n"
 #define TLERR_UNBOUND_VARIADIC "function format invalid. Symbol '&' not followed by single symbol\n"
+#define TLERR_EXIT             "exit with status %d\n"
 
 
 struct lval_S;
 struct lenv_S;
+struct lbig_S;
+struct lstr_S;
+struct lerr_S;
 typedef struct lval_S lval_T;
 typedef struct lenv_S lenv_T;
+typedef struct lbig_S lbig_T;
+typedef struct lstr_S lstr_T;
+typedef struct lerr_S lerr_T;
 typedef struct lbtin_meta_S lbtin_meta_T;
 
 
@@ -59,6 +85,8 @@ typedef enum ltype
 {
     LTYPE_FUN,
     LTYPE_NUM,
+    LTYPE_INT,
+    LTYPE_BIGINT,
     LTYPE_STR,
     LTYPE_ERR,
     LTYPE_SYM,
@@ -68,6 +96,23 @@ typedef enum ltype
 ltype_E;
 
 
+/* what an error is about; the message itself is free-form */
+typedef enum lerrcode
+{
+    LERR_GENERIC,
+    LERR_USER,
+    LERR_BAD_NUM,
+    LERR_DIV_ZERO,
+    LERR_UNBOUND_SYM,
+    LERR_BAD_ARGS,
+    LERR_NOT_FUNCTION,
+    LERR_CONSTANT,
+    LERR_LOAD,
+    LERR_EXIT
+}
+lerrcode_E;
+
+
 /* ... */
 typedef enum lcond
 {
@@ -89,11 +134,12 @@ typedef enum lexec
 lexec_E;
 
 
-/* ... */
+/* static description of a built-in function */
 struct lbtin_meta_S
 {
-    char* name;
-    char* description;
+    const char* name;
+    const char* description;
+    lbtin function;
 };
 
 
@@ -110,13 +156,20 @@ struct lval_S
     lval_T*  formals;
     lval_T** cell;
 
-    char*  error;
+    char*  name;
+    lerr_T* error;
     char*  symbol;
-    char*  string;
+    lstr_T* string;
+    size_t  str_offset;
+    size_t  str_length;
     double number;
+    int64_t integer;
+    lbig_T* bigint;
 
     lbtin builtin;
-    lbtin_meta_T* btin_meta;
+    const lbtin_meta_T* btin_meta;
+
+    bool in_arena;
 };
 
 
@@ -126,9 +179,17 @@ struct lenv_S
     size_t  counter;
     lexec_E exec_type;
     lenv_T* parent;
+    bool    is_global;
 
     char**   symbols;
     lval_T** values;
+
+    /* in the global environment, the bindings made while "use" runs a
+       module are kept first, so the program's own can be dropped alone;
+       "saved" holds the module value of those the program rebinds */
+    size_t   library;
+    size_t   loading;
+    lval_T** saved;
 };
 
 #endif
@@ -0,0 +1,404 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "env.h"
+#include "eval.h"
+#include "reader.h"
+#include "vm.h"
+
+
+char*   ltype_nrepr (int type);
+lval_T* lval_call   (lenv_T* env, lval_T* func, lval_T* args);
+lval_T* lval_copy   (lval_T* val);
+lval_T* lval_pop    (lval_T* t, size_t i);
+lval_T* lval_sym    (const char* s);
+
+
+LEXY_THREAD_LOCAL lexy_vm_T* lexy_vm_current = NULL;
+
+
+/**
+ * lexy_vm_new - VM creation
+ *
+ * Builds an independent interpreter: its own global environment, grammar,
+ * evaluation arena and registry of loaded modules. Different VMs may run concurrently, one per thread.
+ */
+lexy_vm_T* lexy_vm_new(void)
+{
+    lexy_vm_T* vm = malloc(sizeof(struct lexy_vm_S));
+
+    vm->arena         = arena_new(sizeof(struct lval_S));
+    vm->arena_depth   = 0;
+    vm->persist_depth = 0;
+    vm->modules       = lmod_new();
+
+    lexy_vm_T* previous = lexy_vm_enter(vm);
+
+    vm->env = lenv_new();
+    lenv_init(vm->env);
+    parser_init(&vm->parser);
+
+    lexy_vm_leave(previous);
+    return vm;
+}
+
+
+/**
+ * lexy_vm_del - VM deletion
+ */
+void lexy_vm_del(lexy_vm_T* vm)
+{
+    lexy_vm_T* previous = lexy_vm_enter(vm);
+
+    lenv_del(vm->env);
+    parser_safe_cleanup(&vm->parser);
+    arena_destroy(vm->arena);
+    lmod_del(vm->modules);
+
+    lexy_vm_leave(previous == vm ? NULL : previous);
+    free(vm);
+}
+
+
+/**
+ * lexy_vm_enter - VM activation
+ *
+ * Makes "vm" the VM of the calling thread and returns the one that was active
+ * before, which must be handed to "lexy_vm_leave" afterwards.
+ */
+lexy_vm_T* lexy_vm_enter(lexy_vm_T* vm)
+{
+    lexy_vm_T* previous = lexy_vm_current;
+    lexy_vm_current = vm;
+
+    return previous;
+}
+
+
+/**
+ * lexy_vm_leave - VM deactivation
+ */
+void lexy_vm_leave(lexy_vm_T* previous)
+{
+    lexy_vm_current = previous;
+}
+
+
+/**
+ * vm_eval_forms - Top-level forms evaluation
+ *
+ * Evaluates each form in its own arena scope and stops at the first error.
+ * Returns (on the heap) either that error or the value of the last form.
+ */
+static lval_T* vm_eval_forms(lexy_vm_T* vm, lval_T* forms)
+{
+    lval_T* res = NULL;
+
+    while (forms->counter && res == NULL)
+    {
+        lval_arena_begin();
+
+        lval_T* e = lval_eval(vm->env, lval_pop(forms, 0));
+        if (e->type == LTYPE_ERR || forms->counter == 0)
+            res = lval_persist(e);
+
+        lval_del(e);
+        lval_arena_end();
+    }
+
+    lval_del(forms);
+    return res != NULL ? res : lval_sexpr();
+}
+
+
+/**
+ * vm_eval_parsed - Parse result evaluation
+ *
+ * The grammar reads values directly, so "r" holds the forms themselves.
+ */
+static lval_T* vm_eval_parsed(lexy_vm_T* vm, int parsed, mpc_result_t* r)
+{
+    if (parsed)
+    {
+        return vm_eval_forms(vm, r->output);
+    }
+
+    char* err_msg = mpc_err_string(r->error);
+    mpc_err_delete(r->error);
+
+    lval_T* err = lval_errc(LERR_LOAD, "%s", err_msg);
+    free(err_msg);
+
+    return err;
+}
+
+
+/**
+ * lexy_vm_eval_string - Source code evaluation
+ *
+ * Evaluates every form of "code" in the VM. "name" is only used to report
+ * syntax errors. The returned value is owned by the caller.
+ */
+lval_T* lexy_vm_eval_string(lexy_vm_T* vm, const char* name, const char* code)
+{
+    lexy_vm_T* previous = lexy_vm_enter(vm);
+
+    mpc_result_t r;
+    int parsed = mpc_parse(name, code, vm->parser.read, &r);
+    lval_T* res = vm_eval_parsed(vm, parsed, &r);
+
+    lexy_vm_leave(previous);
+    return res;
+}
+
+
+/**
+ * lexy_vm_eval_file - Source file evaluation
+ *
+ * Same as "lexy_vm_eval_string", reading the code from "path".
+ */
+lval_T* lexy_vm_eval_file(lexy_vm_T* vm, const char* path)
+{
+    lexy_vm_T* previous = lexy_vm_enter(vm);
+
+    mpc_result_t r;
+    int parsed = mpc_parse_contents(path, vm->parser.read, &r);
+    lval_T* res = vm_eval_parsed(vm, parsed, &r);
+
+    lexy_vm_leave(previous);
+    return res;
+}
+
+
+/* errors of successive forms go on lines of their own */
+static void vm_print_error(lexy_vm_T* vm, lval_T* e, FILE* out)
+{
+    char storage[LVAL_PRINT_BUFFER_BYTES];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+    lval_render(&b, e, vm->env->exec_type == LEXEC_REPL);
+
+    if (b.length == 0 || b.data[b.length - 1] != '\n')
+        lbuf_putc(&b, '\n');
+
+    lbuf_flush(&b, out);
+    lbuf_free(&b);
+}
+
+
+/* moves "at" past the source text "code" */
+static void vm_advance(mpc_state_t* at, const char* code)
+{
+    for (; *code != '\0'; code++)
+    {
+        if (*code == '\n')
+        {
+            at->row++;
+            at->col = 0;
+        }
+        else
+            at->col++;
+    }
+}
+
+
+/**
+ * vm_eval_chunk - Streamed forms evaluation
+ *
+ * Parses the whole forms of "code", which is consumed and starts at "at" in
+ * the input, and evaluates them one by one. Errors are written to "out" and
+ * the evaluation goes on, as in "use"; "*failed" is set if any happens. If the
+ * code does not parse and "split" is set, its forms are parsed and evaluated
+ * one at a time so that only the bad ones are skipped. Returns (on the heap)
+ * the error made by "exit", or NULL.
+ */
+static lval_T* vm_eval_chunk(lexy_vm_T* vm, const char* name, char* code, mpc_state_t* at, FILE* out, bool* failed, bool split)
+{
+    mpc_result_t r;
+    int parsed = mpc_parse(name, code, vm->parser.read, &r);
+
+    lval_T* res = NULL;
+
+    if (!parsed && split)
+    {
+        mpc_err_delete(r.error);
+
+        lreader_T forms;
+        lreader_init(&forms);
+        lreader_feed(&forms, code, strlen(code));
+        free(code);
+
+        char* form;
+        while (res == NULL && (form = lreader_take_form(&forms)) != NULL)
+            res = vm_eval_chunk(vm, name, form, at, out, failed, FALSE);
+
+        /* blanks, comments or the unfinished end of the input */
+        if (res == NULL && !lreader_empty(&forms))
+            res = vm_eval_chunk(vm, name, lreader_take(&forms, TRUE), at, out, failed, FALSE);
+
+        lreader_free(&forms);
+        return res;
+    }
+
+    if (!parsed)
+    {
+        /* positions are counted from the start of the input, not of the code */
+        if (r.error->state.row == 0)
+            r.error->state.col += at->col;
+
+        r.error->state.row += at->row;
+
+        char* err_msg = mpc_err_string(r.error);
+        mpc_err_delete(r.error);
+
+        fputs(err_msg, out);
+        free(err_msg);
+
+        vm_advance(at, code);
+        free(code);
+
+        *failed = TRUE;
+        return NULL;
+    }
+
+    vm_advance(at, code);
+    free(code);
+
+    lval_T* forms = r.output;
+
+    while (forms->counter && res == NULL)
+    {
+        lval_arena_begin();
+
+        lval_T* e = lval_eval(vm->env, lval_pop(forms, 0));
+        if (e->type == LTYPE_ERR && e->error->code == LERR_EXIT)
+            res = lval_persist(e);
+        else if (e->type == LTYPE_ERR)
+        {
+            vm_print_error(vm, e, out);
+            *failed = TRUE;
+        }
+
+        lval_del(e);
+        lval_arena_end();
+    }
+
+    lval_del(forms);
+    return res;
+}
+
+
+/**
+ * lexy_vm_eval_stream - Streamed source evaluation
+ *
+ * Reads "in" in large chunks and evaluates the whole forms of every chunk as
+ * soon as they arrive, so the input never has to fit in memory. Errors are
+ * written to "out" as they happen; "exit" stops the reading. Returns the status given
+ * to "exit", else 1 if any error happened and 0 otherwise.
+ */
+int lexy_vm_eval_stream(lexy_vm_T* vm, const char* name, FILE* in, FILE* out)
+{
+    lexy_vm_T* previous = lexy_vm_enter(vm);
+
+    char*   chunk  = malloc(LEXY_VM_STREAM_BYTES);
+    lval_T* stop   = NULL;
+    bool    failed = FALSE;
+
+    lreader_T reader;
+    lreader_init(&reader);
+
+    mpc_state_t at = { 0, 0, 0, 0 };
+
+    size_t n;
+    while (stop == NULL && (n = fread(chunk, 1, LEXY_VM_STREAM_BYTES, in)) > 0)
+    {
+        lreader_feed(&reader, chunk, n);
+
+        if (reader.complete > 0)
+            stop = vm_eval_chunk(vm, name, lreader_take(&reader, FALSE), &at, out, &failed, TRUE);
+    }
+
+    /* whatever is left is either the last form or a syntax error */
+    if (stop == NULL && !lreader_empty(&reader))
+        stop = vm_eval_chunk(vm, name, lreader_take(&reader, TRUE), &at, out, &failed, TRUE);
+
+    int status = stop != NULL ? lerr_status(stop->error) : (failed ? 1 : 0);
+
+    if (stop != NULL)
+        lval_del(stop);
+
+    lreader_free(&reader);
+    free(chunk);
+
+    lexy_vm_leave(previous);
+    return status;
+}
+
+
+/**
+ * lexy_vm_call - Function call
+ *
+ * Calls the function bound to "fn" in the VM global environment with the
+ * (already evaluated) elements of the S-Expression "args", which is consumed.
+ * The returned value is owned by the caller.
+ */
+lval_T* lexy_vm_call(lexy_vm_T* vm, const char* fn, lval_T* args)
+{
+    lexy_vm_T* previous = lexy_vm_enter(vm);
+    lval_arena_begin();
+
+    lval_T* sym  = lval_sym(fn);
+    lval_T* func = lenv_get(vm->env, sym);
+    lval_T* res;
+
+    if (func->type == LTYPE_FUN)
+        res = lval_call(vm->env, func, args);
+    else
+    {
+        res = func->type == LTYPE_ERR
+            ? lval_copy(func)
+            : lval_errc(LERR_NOT_FUNCTION, "'%s' is not a function. Got '%s', expected '%s'.",
+                        fn, ltype_nrepr(func->type), ltype_nrepr(LTYPE_FUN));
+
+        lval_del(args);
+    }
+
+    lval_T* nres = lval_persist(res);
+
+    lval_del(res);
+    lval_del(func);
+    lval_del(sym);
+
+    lval_arena_end();
+    lexy_vm_leave(previous);
+
+    return nres;
+}
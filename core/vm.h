@@ -0,0 +1,78 @@
+/*
+
+   Copyright (c) 2018-2021 Caian R. Ertl <hi@caian.org>
+
+   Permission is hereby granted, free of charge, to any person
+   obtaining a copy of this software and associated documentation
+   files (the "Software"), to deal in the Software without
+   restriction, including without limitation the rights to use,
+   copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following
+   conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+   OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LEXY_VM
+#define LEXY_VM
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "eval.h"
+#include "module.h"
+#include "parser.h"
+#include "type.h"
+
+
+/* bytes read at once by "lexy_vm_eval_stream" */
+#define LEXY_VM_STREAM_BYTES (64 * 1024)
+
+
+typedef struct lexy_vm_S lexy_vm_T;
+
+/* an interpreter instance; everything a program mutates lives in here */
+struct lexy_vm_S
+{
+    lenv_T*   env;
+    lparser_T parser;
+
+    /* slab of lval_T nodes for the top-level form being evaluated */
+    arena_T* arena;
+
+    /* nesting of "lval_arena_begin" calls and of "lval_persist" calls */
+    size_t arena_depth;
+    size_t persist_depth;
+
+    /* modules already brought in by "use" */
+    lmod_T* modules;
+};
+
+
+/* the VM running on the calling thread (NULL outside of any VM) */
+extern LEXY_THREAD_LOCAL lexy_vm_T* lexy_vm_current;
+
+
+lexy_vm_T* lexy_vm_new         (void);
+void       lexy_vm_del         (lexy_vm_T* vm);
+lexy_vm_T* lexy_vm_enter       (lexy_vm_T* vm);
+void       lexy_vm_leave       (lexy_vm_T* previous);
+lval_T*    lexy_vm_eval_string (lexy_vm_T* vm, const char* name, const char* code);
+lval_T*    lexy_vm_eval_file   (lexy_vm_T* vm, const char* path);
+int        lexy_vm_eval_stream (lexy_vm_T* vm, const char* name, FILE* in, FILE* out);
+lval_T*    lexy_vm_call        (lexy_vm_T* vm, const char* fn, lval_T* args);
+
+#endif
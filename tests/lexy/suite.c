@@ -1,5 +1,20 @@
+#include <time.h>
+
 #include "../ptest.h"
+#include "../../core/arena.h"
+#include "../../core/bigint.h"
+#include "../../core/builtin.h"
+#include "../../core/env.h"
+#include "../../core/error.h"
 #include "../../core/fmt.h"
+#include "../../core/module.h"
+#include "../../core/parser.h"
+#include "../../core/prof.h"
+#include "../../core/reader.h"
+#include "../../core/pool.h"
+#include "../../core/stats.h"
+#include "../../core/str.h"
+#include "../../core/vm.h"
 
 
 static void
@@ -25,6 +40,27 @@ test_isfint(void)
     PT_ASSERT(isvint(z));
 }
 
+static void
+test_lbuf(void)
+{
+    char storage[4];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+
+    lbuf_puts(&b, "ab");
+    PT_ASSERT(b.data == storage && !b.on_heap);
+
+    lbuf_printf(&b, "%s-%d", "long enough to grow", 42);
+    lbuf_putc(&b, '!');
+
+    PT_ASSERT(b.on_heap);
+    PT_ASSERT(strequ(b.data, "ablong enough to grow-42!"));
+    PT_ASSERT(b.length == strlen(b.data));
+
+    lbuf_free(&b);
+}
+
 void
 suite_fmt(void)
 {
@@ -32,6 +68,1170 @@ suite_fmt(void)
 
     pt_add_test(test_strequ, "Test 'strequ'", suite_name);
     pt_add_test(test_isfint, "Test 'isvint'", suite_name);
+    pt_add_test(test_lbuf, "Test 'lbuf'", suite_name);
+}
+
+
+static void
+test_arena_reuse(void)
+{
+    arena_T* a = arena_new(sizeof(double));
+
+    void* x = arena_alloc(a);
+    void* y = arena_alloc(a);
+
+    PT_ASSERT(x != y);
+
+    arena_release(a, x);
+    PT_ASSERT(arena_alloc(a) == x);
+
+    arena_destroy(a);
+}
+
+static void
+test_arena_reset(void)
+{
+    arena_T* a = arena_new(sizeof(double));
+    void* first = arena_alloc(a);
+
+    for (int i = 0; i < (ARENA_BLOCK_SLOTS * 3); i++)
+        *(double*)arena_alloc(a) = i;
+
+    arena_reset(a);
+    PT_ASSERT(arena_alloc(a) == first);
+
+    arena_destroy(a);
+}
+
+void
+suite_arena(void)
+{
+    char* suite_name = "Suite 'arena'";
+
+    pt_add_test(test_arena_reuse, "Test 'arena_release'", suite_name);
+    pt_add_test(test_arena_reset, "Test 'arena_reset'", suite_name);
+}
+
+
+#define TEST_BTIN_LOOKUP(name, descr, fn) \
+    PT_ASSERT(lenv_btin(name) != NULL && lenv_btin(name)->function == fn);
+
+static void
+test_btin_table(void)
+{
+    BTIN_LIST(TEST_BTIN_LOOKUP)
+
+    PT_ASSERT(lenv_btin("fn") == NULL);
+    PT_ASSERT(lenv_btin("") == NULL);
+}
+
+void
+suite_env(void)
+{
+    char* suite_name = "Suite 'env'";
+
+    pt_add_test(test_btin_table, "Test 'lenv_btin'", suite_name);
+}
+
+
+static void
+test_pool_square(void* data, size_t i)
+{
+    ((size_t*)data)[i] += i * i;
+}
+
+static void
+test_pool_for(void)
+{
+    size_t n = 10007;
+    size_t* out = calloc(n, sizeof(size_t));
+
+    pool_for(n, 3, 4, test_pool_square, out);
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < n; i++)
+        wrong += out[i] != i * i;
+
+    PT_ASSERT(wrong == 0);
+
+    /* the same workers run the next loops, whatever their size */
+    for (size_t w = 1; w <= 8; w++)
+        pool_for(n, 5, w, test_pool_square, out);
+
+    wrong = 0;
+    for (size_t i = 0; i < n; i++)
+        wrong += out[i] != 9 * i * i;
+
+    PT_ASSERT(wrong == 0);
+
+    free(out);
+}
+
+static void
+test_pool_row(void* data, size_t i)
+{
+    size_t* rows = data;
+    pool_for(64, 1, 4, test_pool_square, rows + i * 64);
+}
+
+static void
+test_pool_nested(void)
+{
+    size_t* rows = calloc(16 * 64, sizeof(size_t));
+
+    pool_for(16, 1, 4, test_pool_row, rows);
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < 16 * 64; i++)
+        wrong += rows[i] != (i % 64) * (i % 64);
+
+    PT_ASSERT(wrong == 0);
+
+    free(rows);
+}
+
+void
+suite_pool(void)
+{
+    char* suite_name = "Suite 'pool'";
+
+    pt_add_test(test_pool_for, "Test 'pool_for'", suite_name);
+    pt_add_test(test_pool_nested, "Test 'pool_for' nested", suite_name);
+}
+
+
+static void
+test_big_str(void)
+{
+    const char* digits = "-340282366920938463463374607431768211457";
+    lbig_T* a = big_from_str(digits);
+    char* s = big_to_str(a);
+    int64_t n = 0;
+
+    PT_ASSERT(a->negative && a->length == 5);
+    PT_ASSERT(strequ(s, digits));
+    PT_ASSERT(!big_to_int(a, &n) && n == 0);
+
+    free(s);
+    big_del(a);
+
+    a = big_from_int(INT64_MIN);
+    s = big_to_str(a);
+    PT_ASSERT(strequ(s, "-9223372036854775808"));
+    PT_ASSERT(big_to_int(a, &n) && n == INT64_MIN);
+
+    free(s);
+    big_del(a);
+}
+
+static void
+test_big_mul(void)
+{
+    /* operands well past BIG_KARATSUBA_LIMBS, one of them unbalanced */
+    lbig_T* three = big_from_int(3);
+    lbig_T* seven = big_from_int(-7);
+    lbig_T* a = big_pow(three, 4000);
+    lbig_T* b = big_pow(seven, 900);
+    lbig_T* p = big_mul(a, b);
+    lbig_T* r = NULL;
+    lbig_T* q = big_divmod(p, b, &r);
+
+    PT_ASSERT(a->length > 4 * BIG_KARATSUBA_LIMBS);
+    PT_ASSERT(!p->negative && r->length == 0);
+    PT_ASSERT(big_cmp(q, a) == 0);
+
+    big_del(q);
+    big_del(r);
+    big_del(p);
+
+    q = big_divmod(a, seven, &r);
+    PT_ASSERT(q->negative && !r->negative && r->length == 1 && r->limbs[0] == 4);
+
+    big_del(q);
+    big_del(r);
+    big_del(b);
+    big_del(a);
+    big_del(seven);
+    big_del(three);
+}
+
+void
+suite_bigint(void)
+{
+    char* suite_name = "Suite 'bigint'";
+
+    pt_add_test(test_big_str, "Test 'big_from_str'", suite_name);
+    pt_add_test(test_big_mul, "Test 'big_mul'", suite_name);
+}
+
+
+static void
+test_lstr_rope(void)
+{
+    lstr_T* acc = lstr_new("", 0);
+    size_t n = 100000;
+
+    /* a chain of appends as deep as it is long */
+    for (size_t i = 0; i < n; i++)
+        acc = lstr_concat(acc, lstr_new(i % 2 ? "ab" : "cd", 2));
+
+    PT_ASSERT(acc->length == 2 * n && acc->left != NULL);
+
+    lstr_T* flat = lstr_flatten(lstr_retain(acc));
+    PT_ASSERT(flat->left == NULL && flat->length == 2 * n);
+    PT_ASSERT(memcmp(flat->data, "cdabcd", 6) == 0 && flat->data[2 * n] == '\0');
+
+    lstr_release(flat);
+    lstr_release(acc);
+
+    lstr_T* small = lstr_concat(lstr_new("ab", 2), lstr_new("cd", 2));
+    PT_ASSERT(small->left == NULL && strequ(small->data, "abcd"));
+    lstr_release(small);
+}
+
+static void
+test_lmod_registry(void)
+{
+    lmod_T* m = lmod_new();
+    char path[32];
+
+    /* enough keys to grow the table a few times */
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(path, "/lib/module-%d.lisp", i);
+        PT_ASSERT(lmod_add(m, path));
+    }
+
+    PT_ASSERT(m->count == 100 && m->capacity * 3 >= m->count * 4);
+    PT_ASSERT(lmod_has(m, "/lib/module-42.lisp"));
+    PT_ASSERT(!lmod_add(m, "/lib/module-42.lisp"));
+    PT_ASSERT(!lmod_has(m, "/lib/module-100.lisp"));
+
+    lmod_clear(m);
+    PT_ASSERT(m->count == 0 && !lmod_has(m, "/lib/module-42.lisp"));
+
+    lmod_del(m);
+}
+
+static void
+test_lmod_resolve(void)
+{
+    char* std = lmod_resolve("lib/std", 7);
+    PT_ASSERT(std != NULL && std[0] == '/');
+    free(std);
+
+    PT_ASSERT(lmod_resolve("lib/no-such-module", 18) == NULL);
+}
+
+static lerr_T*
+test_lerr_new(lerrcode_E code, const char* template, ...)
+{
+    va_list va;
+    va_start(va, template);
+
+    lerr_T* e = lerr_new(code, template, va);
+
+    va_end(va);
+    return e;
+}
+
+static bool
+test_lerr_is(lerr_T* e, const char* expect)
+{
+    char storage[64];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+    lerr_format(&b, e);
+
+    bool same = strequ(b.data, expect);
+
+    lbuf_free(&b);
+    return same;
+}
+
+static void
+test_lerr_format(void)
+{
+    char name[] = "temporary";
+    lerr_T* e = test_lerr_new(LERR_BAD_ARGS, "'%s' took %i of %lu (%.*s) at 100%% %5.2f",
+        name, 3, (unsigned long)7, 3, "abcdef", 0.5);
+
+    /* string arguments are copied, not referenced */
+    strcpy(name, "changed!!");
+
+    PT_ASSERT(e->code == LERR_BAD_ARGS && e->nargs == 6);
+    PT_ASSERT(test_lerr_is(e, "'temporary' took 3 of 7 (abc) at 100%  0.50"));
+
+    lerr_T* copy = lerr_retain(e);
+    lerr_release(e);
+    PT_ASSERT(copy->refs == 1);
+    lerr_release(copy);
+
+    /* beyond LERR_MAX_ARGS the message is formatted right away */
+    e = test_lerr_new(LERR_GENERIC, "%d%d%d%d%d%d%d", 1, 2, 3, 4, 5, 6, 7);
+    PT_ASSERT(test_lerr_is(e, "1234567"));
+    lerr_release(e);
+
+    lerr_release(lerr_retain(&lerr_div_zero));
+    PT_ASSERT(lerr_div_zero.refs == 0 && test_lerr_is(&lerr_div_zero, TLERR_DIV_ZERO));
+}
+
+void
+suite_error(void)
+{
+    char* suite_name = "Suite 'error'";
+
+    pt_add_test(test_lerr_format, "Test 'lerr_format'", suite_name);
+}
+
+void
+suite_module(void)
+{
+    char* suite_name = "Suite 'module'";
+
+    pt_add_test(test_lmod_registry, "Test 'lmod_add'", suite_name);
+    pt_add_test(test_lmod_resolve, "Test 'lmod_resolve'", suite_name);
+}
+
+void
+suite_str(void)
+{
+    char* suite_name = "Suite 'str'";
+
+    pt_add_test(test_lstr_rope, "Test 'lstr_concat'", suite_name);
+}
+
+
+static void
+test_lreader_feed(lreader_T* r, const char* s)
+{
+    lreader_feed(r, s, strlen(s));
+}
+
+static void
+test_lreader_lines(void)
+{
+    lreader_T r;
+    lreader_init(&r);
+
+    test_lreader_feed(&r, "(add 1\n");
+    PT_ASSERT(!lreader_ready(&r));
+
+    /* brackets inside strings and comments do not count */
+    test_lreader_feed(&r, "  \"(\\\"\n{\" ; )\n");
+    PT_ASSERT(!lreader_ready(&r));
+
+    test_lreader_feed(&r, "2)\n");
+    PT_ASSERT(lreader_ready(&r));
+
+    char* s = lreader_take(&r, FALSE);
+    PT_ASSERT(strequ(s, "(add 1\n  \"(\\\"\n{\" ; )\n2)\n"));
+    PT_ASSERT(lreader_empty(&r));
+    free(s);
+
+    test_lreader_feed(&r, ")\n");
+    PT_ASSERT(lreader_ready(&r));
+    free(lreader_take(&r, FALSE));
+
+    lreader_free(&r);
+}
+
+static void
+test_lreader_take(void)
+{
+    lreader_T r;
+    lreader_init(&r);
+
+    /* whole forms are taken, the unfinished one stays for the next chunk */
+    test_lreader_feed(&r, "(a)\n(b\n(c");
+    PT_ASSERT(!lreader_ready(&r));
+
+    char* s = lreader_take(&r, FALSE);
+    PT_ASSERT(strequ(s, "(a)\n"));
+    free(s);
+
+    test_lreader_feed(&r, "))\n{d");
+    s = lreader_take(&r, FALSE);
+    PT_ASSERT(strequ(s, "(b\n(c))\n"));
+    free(s);
+
+    s = lreader_take(&r, TRUE);
+    PT_ASSERT(strequ(s, "{d"));
+    PT_ASSERT(lreader_empty(&r) && lreader_ready(&r));
+    free(s);
+
+    lreader_free(&r);
+}
+
+static void
+test_lreader_forms(void)
+{
+    lreader_T r;
+    lreader_init(&r);
+
+    /* forms end where they close, without waiting for a line break */
+    test_lreader_feed(&r, "(a \")\") {b}\"c\" de");
+    PT_ASSERT(!lreader_ready(&r));
+
+    char* s = lreader_take_form(&r);
+    PT_ASSERT(strequ(s, "(a \")\")"));
+    free(s);
+
+    s = lreader_take_form(&r);
+    PT_ASSERT(strequ(s, " {b}"));
+    free(s);
+
+    s = lreader_take_form(&r);
+    PT_ASSERT(strequ(s, "\"c\""));
+    free(s);
+
+    /* an atom is only whole once something else follows it */
+    PT_ASSERT(lreader_take_form(&r) == NULL);
+
+    test_lreader_feed(&r, "f(g) ; h)\n");
+    PT_ASSERT(lreader_ready(&r));
+
+    s = lreader_take_form(&r);
+    PT_ASSERT(strequ(s, " def"));
+    free(s);
+
+    s = lreader_take_form(&r);
+    PT_ASSERT(strequ(s, "(g)"));
+    free(s);
+
+    /* only a comment is left */
+    PT_ASSERT(lreader_take_form(&r) == NULL);
+
+    s = lreader_take(&r, FALSE);
+    PT_ASSERT(strequ(s, " ; h)\n"));
+    PT_ASSERT(lreader_empty(&r));
+    free(s);
+
+    lreader_free(&r);
+}
+
+static void
+test_lreader_getline(void)
+{
+    FILE* f = tmpfile();
+    PT_ASSERT(f != NULL);
+
+    /* far longer than the initial line buffer, which has to grow */
+    for (int i = 0; i < 1000; i++)
+        fputs("0123456789", f);
+
+    fputs("\n\nlast", f);
+    rewind(f);
+
+    char* line = lreader_getline(f);
+    PT_ASSERT(line != NULL && strlen(line) == 10000 && line[9999] == '9');
+    free(line);
+
+    line = lreader_getline(f);
+    PT_ASSERT(line != NULL && strequ(line, ""));
+    free(line);
+
+    /* the last line may have no line break */
+    line = lreader_getline(f);
+    PT_ASSERT(line != NULL && strequ(line, "last"));
+    free(line);
+
+    PT_ASSERT(lreader_getline(f) == NULL);
+    fclose(f);
+}
+
+void
+suite_reader(void)
+{
+    char* suite_name = "Suite 'reader'";
+
+    pt_add_test(test_lreader_lines, "Test 'lreader_feed'", suite_name);
+    pt_add_test(test_lreader_take, "Test 'lreader_take'", suite_name);
+    pt_add_test(test_lreader_forms, "Test 'lreader_take_form'", suite_name);
+    pt_add_test(test_lreader_getline, "Test 'lreader_getline'", suite_name);
+}
+
+
+lval_T* lval_num (double n);
+
+
+static bool
+test_err_is(lval_T* v, lerrcode_E code, const char* expect)
+{
+    if (v->type != LTYPE_ERR || v->error->code != code)
+        return FALSE;
+
+    char storage[64];
+
+    lbuf_T b;
+    lbuf_init(&b, storage, sizeof(storage));
+    lerr_format(&b, v->error);
+
+    bool same = strequ(b.data, expect);
+
+    lbuf_free(&b);
+    return same;
+}
+
+static bool
+test_str_is(lval_T* v, const char* expect)
+{
+    return v->type == LTYPE_STR && v->str_length == strlen(expect)
+        && memcmp(lval_strptr(v), expect, v->str_length) == 0;
+}
+
+/* the file stays positioned at its end, so it can be written to again */
+static bool
+test_file_has(FILE* f, const char* expect)
+{
+    char text[16384];
+
+    rewind(f);
+    size_t n = fread(text, 1, sizeof(text) - 1, f);
+    text[n] = '\0';
+
+    fseek(f, 0, SEEK_END);
+    return strstr(text, expect) != NULL;
+}
+
+static void
+test_vm_eval_string(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(global {x} 40) (add x 2)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 42);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(error \"boom\") (global {y} 1)");
+    PT_ASSERT(test_err_is(res, LERR_USER, "boom"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "y");
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    lexy_vm_del(vm);
+    PT_ASSERT(lexy_vm_current == NULL);
+}
+
+static void
+test_vm_isolation(void)
+{
+    lexy_vm_T* a = lexy_vm_new();
+    lexy_vm_T* b = lexy_vm_new();
+
+    lval_del(lexy_vm_eval_string(a, "<a>", "(global {x} 1)"));
+
+    lval_T* res = lexy_vm_eval_string(b, "<b>", "x");
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    lexy_vm_del(a);
+    lexy_vm_del(b);
+}
+
+static void
+test_vm_call(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+    lval_del(lexy_vm_eval_string(vm, "<test>", "(global {sq} (lambda {x} {mul x x}))"));
+
+    lval_T* res = lexy_vm_call(vm, "sq", lval_add(lval_sexpr(), lval_num(7)));
+    PT_ASSERT(res->type == LTYPE_NUM && res->number == 49);
+    lval_del(res);
+
+    res = lexy_vm_call(vm, "max", lval_add(lval_add(lval_sexpr(), lval_num(3)), lval_num(5)));
+    PT_ASSERT(res->type == LTYPE_NUM && res->number == 5);
+    lval_del(res);
+
+    res = lexy_vm_call(vm, "undefined", lval_sexpr());
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_par(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>",
+        "(global {sq} (lambda {x} {mul x x})) (par add {sq 3} {sq 4} {5})");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 30);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(par add {1} {global {y} 2})");
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_pmap(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>",
+        "(pmap (lambda {x} {mul x x}) {1 2 3 4 5 6 7 8 9} 4)");
+    PT_ASSERT(res->type == LTYPE_QEXPR && res->counter == 9);
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < res->counter; i++)
+        wrong += res->cell[i]->integer != (int64_t)((i + 1) * (i + 1));
+
+    PT_ASSERT(wrong == 0);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(pmap (lambda {x} {mul x x}) {1 \"a\" 3})");
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_to_string(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(to-string {1 2.5 \"s\" (x)})");
+    PT_ASSERT(test_str_is(res, "{1 2.500000 \"s\" (x)}"));
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_integers(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(add 9007199254740993 0)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 9007199254740993LL);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(mul 4294967296 4294967296)");
+    PT_ASSERT(res->type == LTYPE_BIGINT && big_to_double(res->bigint) == 18446744073709551616.0);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(sub (add 9223372036854775807 1) 1)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == INT64_MAX);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(to-string (mul 2432902008176640000 21 22 23 24 25))");
+    PT_ASSERT(test_str_is(res, "15511210043330985984000000"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(lt 18446744073709551616 18446744073709551617)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 1);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(div 7 2)");
+    PT_ASSERT(res->type == LTYPE_NUM && res->number == 3.5);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(pow 3 39)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 4052555153018976267LL);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(mod 1 0)");
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    /* exponents beyond 64 bits */
+    res = lexy_vm_eval_string(vm, "<test>", "(pow -1 100000000000000000001)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == -1);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(pow -1 100000000000000000000)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 1);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(pow 1 100000000000000000000)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 1);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(pow 0 100000000000000000000)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 0);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(pow 2 100000000000000000000)");
+    PT_ASSERT(res->type == LTYPE_NUM && isinf(res->number));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(pow 18446744073709551616 0)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 1);
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_strings(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(str-len \"lexy\")");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 4);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(substr \"hello, world\" 7 3)");
+    PT_ASSERT(test_str_is(res, "wor"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(str-join (str-split \"a,,b,c\" \",\") \"|\")");
+    PT_ASSERT(test_str_is(res, "a||b|c"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(str-find \"abcabc\" \"ca\")");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 2);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(str-find \"abcabc\" \"x\")");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == -1);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(str-concat \"1\" (num->str (add (str->num \"41\") 1)) \".5\")");
+    PT_ASSERT(test_str_is(res, "142.5"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(str->num \"4x\")");
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(substr \"abc\" 2 5)");
+    PT_ASSERT(res->type == LTYPE_ERR);
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_try(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(try {div 1 0} (catch {e} {str-concat \"caught: \" e}))");
+    PT_ASSERT(test_str_is(res, "caught: division by zero"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(try {add 1 2} (catch {e} {0}))");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 3);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(try {error \"a\"} (catch {e} {error (str-concat e \"b\")}))");
+    PT_ASSERT(test_err_is(res, LERR_USER, "ab"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(catch {a b} {a})");
+    PT_ASSERT(test_err_is(res, LERR_BAD_ARGS, "function 'catch' has taken an incorrect number of formals. Got 2, expected 1"));
+    lval_del(res);
+
+    /* the first erroring argument stops the evaluation of the others */
+    res = lexy_vm_eval_string(vm, "<test>", "(list (error \"first\") (global {z} 1))");
+    PT_ASSERT(test_err_is(res, LERR_USER, "first"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "z");
+    PT_ASSERT(test_err_is(res, LERR_UNBOUND_SYM, "unbound symbol 'z'\n"));
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_exit(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(try {exit 3} (catch {e} {0}))");
+    PT_ASSERT(test_err_is(res, LERR_EXIT, "exit with status 3\n"));
+    PT_ASSERT(lerr_status(res->error) == 3);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(exit 0)");
+    PT_ASSERT(res->type == LTYPE_ERR && lerr_status(res->error) == 0);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(div 1 0)");
+    PT_ASSERT(res->type == LTYPE_ERR && lerr_status(res->error) == 1);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(exit 1 2)");
+    PT_ASSERT(test_err_is(res, LERR_BAD_ARGS, "function 'exit' has taken an incorrect number of arguments. Got 2, expected 1"));
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_reset(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(global {before} 1) (use \"lib/std\") (global {after} 2)");
+    lval_del(res);
+
+    /* what the module defined survives, the program's own globals do not */
+    lenv_reset(vm->env);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(len-of {1 2 3})");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 3);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "before");
+    PT_ASSERT(test_err_is(res, LERR_UNBOUND_SYM, "unbound symbol 'before'\n"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "after");
+    PT_ASSERT(test_err_is(res, LERR_UNBOUND_SYM, "unbound symbol 'after'\n"));
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(globalc {after} 3) after");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 3);
+    lval_del(res);
+
+    /* a module global the program rebinds gets the module's value back */
+    for (int run = 0; run < 2; run++)
+    {
+        res = lexy_vm_eval_string(vm, "<test>", "(global {len-of} (lambda {l} {0})) (len-of {1 2 3})");
+        PT_ASSERT(res->type == LTYPE_INT && res->integer == 0);
+        lval_del(res);
+
+        lenv_reset(vm->env);
+
+        res = lexy_vm_eval_string(vm, "<test>", "(len-of {1 2 3})");
+        PT_ASSERT(res->type == LTYPE_INT && res->integer == 3);
+        lval_del(res);
+    }
+
+    lexy_vm_del(vm);
+}
+
+static int
+test_vm_stream(lexy_vm_T* vm, const char* code, FILE* errors)
+{
+    FILE* f = tmpfile();
+
+    fputs(code, f);
+    rewind(f);
+
+    int status = lexy_vm_eval_stream(vm, "<test>", f, errors);
+
+    fclose(f);
+    return status;
+}
+
+static void
+test_vm_eval_stream(void)
+{
+    FILE* errors = tmpfile();
+    PT_ASSERT(errors != NULL);
+
+    lexy_vm_T* vm = lexy_vm_new();
+
+    PT_ASSERT(test_vm_stream(vm, "(global {a} 1)\n(global {b} (add a 1))", errors) == 0);
+
+    /* an error does not stop the forms after it, and each one is reported */
+    PT_ASSERT(test_vm_stream(vm, "(foo)\n(div 1 0)\n(global {c} 3)\n", errors) == 1);
+    PT_ASSERT(test_file_has(errors, "ILLEGAL INSTRUCTION: unbound symbol 'foo'\nILLEGAL INSTRUCTION: division by zero\n"));
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(add a b c)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 6);
+    lval_del(res);
+
+    /* a program of several chunks, with a form across their boundary */
+    size_t size = LEXY_VM_STREAM_BYTES * 2 + 100;
+    char*  code = malloc(size + 1);
+    size_t at   = 0;
+
+    at += sprintf(code + at, "(global {s} \"");
+    while (at < LEXY_VM_STREAM_BYTES + 10)
+        code[at++] = 'x';
+
+    at += sprintf(code + at, "\")\n(error \"first\")\n(exit 3)\n");
+    while (at < size - 10)
+        at += sprintf(code + at, "(global {late} 1)\n");
+
+    code[at] = '\0';
+
+    /* the first "exit" ends the program with exactly its status */
+    PT_ASSERT(test_vm_stream(vm, code, errors) == 3);
+    PT_ASSERT(test_file_has(errors, "division by zero\nILLEGAL INSTRUCTION: first\n"));
+    free(code);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(str-len s)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == LEXY_VM_STREAM_BYTES + 10 - 13);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "late");
+    PT_ASSERT(test_err_is(res, LERR_UNBOUND_SYM, "unbound symbol 'late'\n"));
+    lval_del(res);
+
+    /* a program without line breaks is still evaluated form by form, even
+       where the chunks split its atoms */
+    size_t forms = LEXY_VM_STREAM_BYTES * 2 / 22 + 1;
+    code = malloc(forms * 22 + 64);
+    at   = sprintf(code, "(global {n} 0)");
+
+    for (size_t i = 0; i < forms; i++)
+        at += sprintf(code + at, "(global {n} (add n 1))");
+
+    sprintf(code + at, "n (exit 0) (global {n} 0)");
+
+    PT_ASSERT(test_vm_stream(vm, code, errors) == 0);
+    free(code);
+
+    res = lexy_vm_eval_string(vm, "<test>", "n");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == (int64_t)forms);
+    lval_del(res);
+
+    PT_ASSERT(test_vm_stream(vm, "(global {d} 4)\n(unclosed", errors) == 1);
+    PT_ASSERT(test_file_has(errors, "ILLEGAL INSTRUCTION: first\n<test>:2:10: error: "));
+
+    res = lexy_vm_eval_string(vm, "<test>", "d");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 4);
+    lval_del(res);
+
+    /* syntax errors are placed in the whole input and skip their form only */
+    PT_ASSERT(test_vm_stream(vm, "(global {e} 5)\n(global {f} 6))\n(global {g} 7) @ (global {h} 8)\n", errors) == 1);
+    PT_ASSERT(test_file_has(errors, "at end of input\n<test>:2:15: error: "));
+    PT_ASSERT(test_file_has(errors, "at ')'\n<test>:3:16: error: "));
+
+    res = lexy_vm_eval_string(vm, "<test>", "(add e f g h)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 26);
+    lval_del(res);
+
+    fclose(errors);
+    lexy_vm_del(vm);
+}
+
+static void
+test_vm_read(void)
+{
+    /* every source with the forms it reads as, or NULL if it does not parse */
+    const char* sources[][2] = {
+        { "(global {x} 40) (add x 2)",                         "((global {x} 40) (add x 2))" },
+        { "{a {b -1.5} \"s\\\"\\n\" ()} ; comment\n(c)",       "({a {b -1.500000} \"s\"\n\" ()} (c))" },
+        { "99999999999999999999 -7",                           "(99999999999999999999 -7)" },
+        { "",                                                  "()" },
+        { "(unclosed {x}",                                     NULL },
+    };
+
+    lparser_T p;
+    parser_init(&p);
+
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+    {
+        mpc_result_t r;
+        int ok = mpc_parse("<test>", sources[i][0], p.read, &r);
+
+        PT_ASSERT(ok == (sources[i][1] != NULL));
+
+        if (!ok)
+        {
+            mpc_err_delete(r.error);
+            continue;
+        }
+
+        char storage[64];
+
+        lbuf_T b;
+        lbuf_init(&b, storage, sizeof(storage));
+        lval_render(&b, r.output, FALSE);
+
+        PT_ASSERT(strequ(b.data, sources[i][1]));
+
+        lbuf_free(&b);
+        lval_del(r.output);
+    }
+
+    mpc_result_t r;
+    PT_ASSERT(mpc_parse("<test>", "{a \"b\\n\"} ; c", p.read, &r));
+
+    lval_T* forms = r.output;
+    PT_ASSERT(forms->type == LTYPE_SEXPR && forms->counter == 1);
+    PT_ASSERT(forms->cell[0]->type == LTYPE_QEXPR && forms->cell[0]->counter == 2);
+    PT_ASSERT(test_str_is(forms->cell[0]->cell[1], "b\n"));
+    lval_del(forms);
+
+    parser_safe_cleanup(&p);
+}
+
+void
+suite_vm(void)
+{
+    char* suite_name = "Suite 'vm'";
+
+    pt_add_test(test_vm_eval_string, "Test 'lexy_vm_eval_string'", suite_name);
+    pt_add_test(test_vm_isolation, "Test 'lexy_vm_T' isolation", suite_name);
+    pt_add_test(test_vm_call, "Test 'lexy_vm_call'", suite_name);
+    pt_add_test(test_vm_par, "Test 'par'", suite_name);
+    pt_add_test(test_vm_pmap, "Test 'pmap'", suite_name);
+    pt_add_test(test_vm_to_string, "Test 'to-string'", suite_name);
+    pt_add_test(test_vm_strings, "Test string built-ins", suite_name);
+    pt_add_test(test_vm_try, "Test 'try' and 'catch'", suite_name);
+    pt_add_test(test_vm_integers, "Test integer arithmetic", suite_name);
+    pt_add_test(test_vm_read, "Test 'lparser_T' reader", suite_name);
+    pt_add_test(test_vm_eval_stream, "Test 'lexy_vm_eval_stream'", suite_name);
+    pt_add_test(test_vm_exit, "Test 'exit'", suite_name);
+    pt_add_test(test_vm_reset, "Test 'lenv_reset'", suite_name);
+}
+
+
+static int64_t
+test_stats_counter(lexy_vm_T* vm, const char* name)
+{
+    char code[64];
+    sprintf(code, "(stats {%s})", name);
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", code);
+    int64_t value = res->cell[0]->cell[1]->integer;
+
+    lval_del(res);
+    return value;
+}
+
+static void
+test_stats_counters(void)
+{
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>", "(global {stats-sq} (lambda {x} {mul x x}))");
+    lval_del(res);
+
+    if (!stats_enabled())
+    {
+        res = lexy_vm_eval_string(vm, "<test>", "(stats {})");
+        PT_ASSERT(test_err_is(res, LERR_BAD_ARGS,
+            "function 'stats' is not available: lexy has been built without instrumentation"));
+        lval_del(res);
+
+        lexy_vm_del(vm);
+        return;
+    }
+
+    /* the counters are process-wide, so only their growth is checked */
+    int64_t lambdas  = test_stats_counter(vm, "lambda-calls");
+    int64_t builtins = test_stats_counter(vm, "builtin-calls");
+
+    res = lexy_vm_eval_string(vm, "<test>", "(stats-sq 3) (stats-sq 4)");
+    lval_del(res);
+
+    PT_ASSERT(test_stats_counter(vm, "lambda-calls") == lambdas + 2);
+    PT_ASSERT(test_stats_counter(vm, "builtin-calls") >= builtins + 2);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(stats {no-such-counter})");
+    PT_ASSERT(res->type == LTYPE_QEXPR && res->counter == 0);
+    lval_del(res);
+
+    res = lexy_vm_eval_string(vm, "<test>", "(stats 1)");
+    PT_ASSERT(test_err_is(res, LERR_BAD_ARGS,
+        "function 'stats' has taken an incorrect type at argument 1. Got 'Integer', expected 'Q-Expression'"));
+    lval_del(res);
+
+    lexy_vm_del(vm);
+}
+
+static void
+test_stats_report(void)
+{
+    FILE* out = tmpfile();
+    PT_ASSERT(out != NULL);
+
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>",
+        "(global {stats-twice} (lambda {x} {add x x})) (stats-twice 1) (stats-twice 2) (stats-twice 3)");
+    lval_del(res);
+
+    /* what "lexy -d" writes at exit */
+    stats_report(out);
+
+    if (stats_enabled())
+    {
+        PT_ASSERT(test_file_has(out, "\n>>> lexy stats\nlval_new      : "));
+        PT_ASSERT(test_file_has(out, "\n>>> calls per function\n"));
+        PT_ASSERT(test_file_has(out, "           3  stats-twice\n"));
+        PT_ASSERT(test_file_has(out, "  add (builtin)\n"));
+    }
+    else
+        PT_ASSERT(test_file_has(out, "lexy has been built without instrumentation"));
+
+    fclose(out);
+    lexy_vm_del(vm);
+}
+
+void
+suite_stats(void)
+{
+    char* suite_name = "Suite 'stats'";
+
+    pt_add_test(test_stats_counters, "Test 'stats'", suite_name);
+    pt_add_test(test_stats_report, "Test 'stats_report'", suite_name);
+}
+
+
+static void
+test_prof_report(void)
+{
+    FILE* folded = tmpfile();
+    FILE* table  = tmpfile();
+    PT_ASSERT(folded != NULL && table != NULL);
+
+    lexy_vm_T* vm = lexy_vm_new();
+
+    lval_T* res = lexy_vm_eval_string(vm, "<test>",
+        "(global {prof-fact} (lambda {n} {if (le n 1) {1} {mul n (prof-fact (sub n 1))}}))");
+    lval_del(res);
+
+    PT_ASSERT(prof_start());
+
+    res = lexy_vm_eval_string(vm, "<test>", "(prof-fact 5)");
+    PT_ASSERT(res->type == LTYPE_INT && res->integer == 120);
+    lval_del(res);
+
+    /* enough CPU time for the timer to sample the calls a few times */
+    clock_t until = clock() + CLOCKS_PER_SEC / 10;
+    while (clock() < until)
+        lval_del(lexy_vm_eval_string(vm, "<test>", "(prof-fact 20)"));
+
+    prof_stop();
+    PT_ASSERT(!prof_running);
+
+    /* what "lexy -p" writes at exit */
+    prof_report(folded, table);
+
+    PT_ASSERT(test_file_has(table, "\n>>> lexy profile ("));
+    PT_ASSERT(test_file_has(table, "  [top-level]\n"));
+    PT_ASSERT(test_file_has(table, "  prof-fact\n"));
+    PT_ASSERT(test_file_has(folded, "[top-level];prof-fact"));
+
+    /* a restart drops the previous call tree */
+    PT_ASSERT(prof_start());
+    prof_stop();
+
+    fclose(table);
+    table = tmpfile();
+    prof_report(NULL, table);
+
+    PT_ASSERT(!test_file_has(table, "prof-fact"));
+
+    fclose(folded);
+    fclose(table);
+    lexy_vm_del(vm);
+}
+
+void
+suite_prof(void)
+{
+    char* suite_name = "Suite 'prof'";
+
+    pt_add_test(test_prof_report, "Test 'prof_report'", suite_name);
 }
 
 
@@ -39,5 +1239,16 @@ int
 main(int argc, char** argv)
 {
     pt_add_suite(suite_fmt);
+    pt_add_suite(suite_arena);
+    pt_add_suite(suite_env);
+    pt_add_suite(suite_pool);
+    pt_add_suite(suite_bigint);
+    pt_add_suite(suite_str);
+    pt_add_suite(suite_reader);
+    pt_add_suite(suite_module);
+    pt_add_suite(suite_error);
+    pt_add_suite(suite_vm);
+    pt_add_suite(suite_stats);
+    pt_add_suite(suite_prof);
     return pt_run();
 }
@@ -222,6 +222,79 @@ void test_eoi(void) {
 
 }
 
+void test_deep(void) {
+
+  int k, n = 100000, success;
+  char *s = malloc(2 * n + 2);
+  mpc_ast_t *a, *b;
+  mpc_result_t r;
+  mpc_parser_t *Nest = mpc_new("nest");
+
+  /* Far deeper than recursion on the C stack could follow */
+
+  mpc_define(Nest, mpc_or(2,
+    mpc_and(3, mpcf_snd_free, mpc_char('('), Nest, mpc_char(')'), free, free),
+    mpc_char('x')));
+
+  for (k = 0; k < n; k++) { s[k] = '('; s[n+k+1] = ')'; }
+  s[n] = 'x';
+  s[2*n+1] = '\0';
+
+  success = mpc_parse("test", s, Nest, &r);
+  PT_ASSERT(success);
+  PT_ASSERT_STR_EQ(r.output, "x");
+  free(r.output);
+
+  s[2*n] = '\0';
+  success = mpc_parse("test", s, Nest, &r);
+  PT_ASSERT(!success);
+  PT_ASSERT(r.error->state.pos == 2 * n);
+  mpc_err_delete(r.error);
+
+  mpc_cleanup(1, Nest);
+  free(s);
+
+  a = mpc_ast_new("nest", "");
+  for (k = 0, b = a; k < n; k++) {
+    b = mpc_ast_add_child(b, mpc_ast_new("nest", ""))->children[0];
+  }
+  mpc_ast_delete(a);
+
+}
+
+void test_dispatch(void) {
+
+  int success;
+  char *err;
+  mpc_result_t r;
+  mpc_parser_t *A = mpc_new("a");
+  mpc_parser_t *Alts;
+
+  mpc_define(A, mpc_char('a'));
+  Alts = mpc_or(3, A, mpc_char('b'), mpc_string("cd"));
+  mpc_optimise(Alts);
+
+  PT_ASSERT(mpc_test_pass(Alts, "a", "a", streq, free, strprint));
+  PT_ASSERT(mpc_test_pass(Alts, "cd", "cd", streq, free, strprint));
+
+  /* Skipped alternatives still report what they expected */
+  success = mpc_parse("test", "x", Alts, &r);
+  PT_ASSERT(!success);
+  err = mpc_err_string(r.error);
+  PT_ASSERT_STR_EQ(err, "test:1:1: error: expected 'a', 'b' or \"cd\" at 'x'\n");
+  free(err);
+  mpc_err_delete(r.error);
+
+  /* Redefining a parser the table looked into must not skip it */
+  mpc_undefine(A);
+  mpc_define(A, mpc_char('x'));
+  PT_ASSERT(mpc_test_pass(Alts, "x", "x", streq, free, strprint));
+
+  mpc_delete(Alts);
+  mpc_cleanup(1, A);
+
+}
+
 void suite_core(void) {
   pt_add_test(test_ident,  "Test Ident",  "Suite Core");
   pt_add_test(test_maths,  "Test Maths",  "Suite Core");
@@ -231,4 +304,6 @@ void suite_core(void) {
   pt_add_test(test_reader, "Test Reader", "Suite Core");
   pt_add_test(test_tokens, "Test Tokens", "Suite Core");
   pt_add_test(test_eoi,    "Test EOI",    "Suite Core");
+  pt_add_test(test_deep,   "Test Deep",   "Suite Core");
+  pt_add_test(test_dispatch, "Test Dispatch", "Suite Core");
 }
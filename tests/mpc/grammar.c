@@ -400,6 +400,136 @@ void test_digits_file(void) {
 
 }
 
+static void test_packrat_same(mpc_parser_t *a, mpc_parser_t *b, const char *s) {
+
+  mpc_result_t ra, rb;
+  char *ea, *eb;
+  int oka = mpc_parse("test", s, a, &ra);
+  int okb = mpc_parse("test", s, b, &rb);
+
+  PT_ASSERT(oka == okb);
+
+  if (oka && okb) {
+    PT_ASSERT(mpc_ast_eq(ra.output, rb.output));
+  }
+
+  if (!oka && !okb) {
+    ea = mpc_err_string(ra.error);
+    eb = mpc_err_string(rb.error);
+    PT_ASSERT_STR_EQ(ea, eb);
+    free(ea);
+    free(eb);
+  }
+
+  if (oka) { mpc_ast_delete(ra.output); } else { mpc_err_delete(ra.error); }
+  if (okb) { mpc_ast_delete(rb.output); } else { mpc_err_delete(rb.error); }
+
+}
+
+void test_arena(void) {
+
+  int j, n = 5000;
+  char *s;
+  mpc_result_t r;
+  mpc_ast_t *t;
+  mpc_parser_t *Word, *List, *Doc;
+
+  Word = mpc_new("word");
+  List = mpc_new("list");
+  Doc  = mpc_new("doc");
+
+  PT_ASSERT(mpca_lang(MPCA_LANG_DEFAULT,
+    " word : /[a-z]+/ | \"lit\" ;          "
+    " list : '(' (<word> | <list>)* ')' ; "
+    " doc  : /^/ <list>+ /$/ ;            ",
+    Word, List, Doc, NULL) == NULL);
+
+  /* Enough lists to spread the parse over several arena chunks */
+  s = malloc(n * 4 + 1);
+  for (j = 0; j < n; j++) { memcpy(s + j * 4, "(ab)", 4); }
+  s[n * 4] = '\0';
+  PT_ASSERT(mpc_parse("test", s, Doc, &r));
+  t = r.output;
+  PT_ASSERT(t->children_num == n + 2);
+  PT_ASSERT_STR_EQ(t->children[n]->children[1]->contents, "ab");
+  mpc_ast_delete(t);
+
+  /* Tokens past the largest block class are left to the heap */
+  s[0] = '(';
+  for (j = 0; j < n; j++) { s[j + 1] = 'a' + (j % 26); }
+  s[n + 1] = ')';
+  s[n + 2] = '\0';
+  PT_ASSERT(mpc_parse("test", s, Doc, &r));
+  t = r.output;
+  PT_ASSERT(strlen(t->children[1]->children[1]->contents) == (size_t)n);
+  PT_ASSERT(strncmp(t->children[1]->children[1]->contents, s + 1, n) == 0);
+  mpc_ast_delete(t);
+  free(s);
+
+  PT_ASSERT(!mpc_parse("test", "(a (b c)", Doc, &r));
+  mpc_err_delete(r.error);
+
+  mpc_cleanup(3, Word, List, Doc);
+
+}
+
+void test_packrat(void) {
+
+  int j, n = 40;
+  char *s;
+  mpc_result_t r;
+  mpc_parser_t *Expr, *Term, *Factor, *Maths;
+  mpc_parser_t *PExpr, *PTerm, *PFactor, *PMaths;
+
+  /* Overlapping alternatives reparse each prefix without memoization */
+  const char *lang =
+    " expr   : <term> '+' <expr> | <term> ;    "
+    " term   : <factor> '*' <term> | <factor> ; "
+    " factor : /[0-9]+/ | '(' <expr> ')' ;     "
+    " maths  : /^/ <expr> /$/ ;                ";
+
+  Expr   = mpc_new("expr");
+  Term   = mpc_new("term");
+  Factor = mpc_new("factor");
+  Maths  = mpc_new("maths");
+
+  PExpr   = mpc_new("expr");
+  PTerm   = mpc_new("term");
+  PFactor = mpc_new("factor");
+  PMaths  = mpc_new("maths");
+
+  PT_ASSERT(mpca_lang(MPCA_LANG_DEFAULT, lang, Expr, Term, Factor, Maths, NULL) == NULL);
+  PT_ASSERT(mpca_lang(MPCA_LANG_PACKRAT, lang, PExpr, PTerm, PFactor, PMaths, NULL) == NULL);
+
+  test_packrat_same(Maths, PMaths, "1");
+  test_packrat_same(Maths, PMaths, "1+2*3");
+  test_packrat_same(Maths, PMaths, "(1+2)*(3*(4+5))+6");
+  test_packrat_same(Maths, PMaths, "(1+2)*(3*(4+5)+6");
+  test_packrat_same(Maths, PMaths, "1+*2");
+  test_packrat_same(Maths, PMaths, "");
+
+  /* Deep nesting is exponential without memoization */
+  s = malloc(n * 4 + 2);
+  for (j = 0; j < n; j++) { s[j] = '('; }
+  s[n] = '1';
+  for (j = 0; j < n; j++) { memcpy(s + n + 1 + j * 3, ")*2", 3); }
+  s[n * 4 + 1] = '\0';
+
+  if (mpc_parse("test", s, PMaths, &r)) {
+    PT_ASSERT(1);
+    mpc_ast_delete(r.output);
+  } else {
+    PT_ASSERT(0);
+    mpc_err_delete(r.error);
+  }
+
+  free(s);
+
+  mpc_cleanup(4, Expr, Term, Factor, Maths);
+  mpc_cleanup(4, PExpr, PTerm, PFactor, PMaths);
+
+}
+
 void suite_grammar(void) {
   pt_add_test(test_grammar, "Test Grammar", "Suite Grammar");
   pt_add_test(test_language, "Test Language", "Suite Grammar");
@@ -410,4 +540,6 @@ void suite_grammar(void) {
   pt_add_test(test_missingrule, "Test Missing Rule", "Suite Grammar");
   pt_add_test(test_regex_mode, "Test Regex Mode", "Suite Grammar");
   pt_add_test(test_digits_file, "Test Digits File", "Suite Grammar");
+  pt_add_test(test_packrat, "Test Packrat", "Suite Grammar");
+  pt_add_test(test_arena, "Test Arena", "Suite Grammar");
 }
@@ -169,6 +169,74 @@ void test_regex_dotall(void) {
 
 }
 
+static char *regex_run(mpc_parser_t *p, const char *s) {
+  mpc_result_t r;
+  char *out;
+  if (mpc_parse("<test>", s, p, &r)) {
+    out = malloc(strlen(r.output) + 4);
+    strcpy(out, "OK:");
+    strcat(out, r.output);
+    free(r.output);
+  } else {
+    out = mpc_err_string(r.error);
+    mpc_err_delete(r.error);
+  }
+  return out;
+}
+
+static int regex_same(mpc_parser_t *a, mpc_parser_t *b, const char *s) {
+  char *x = regex_run(a, s);
+  char *y = regex_run(b, s);
+  int same = strcmp(x, y) == 0;
+  if (!same) { printf("\n'%s': '%s' vs '%s'", s, x, y); }
+  free(x);
+  free(y);
+  return same;
+}
+
+void test_regex_dfa(void) {
+
+  const char *res[] = {
+    "-?[0-9]+(\\.[0-9]*)?",
+    "\"(\\\\.|[^\"\\\\])*\"",
+    ";[^\\r\\n]*",
+    "[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+",
+    "(ab)*c?",
+    "a(b|cd)+e{2}" };
+
+  const char *inputs[] = {
+    "", "-", "-12", "3.", "3.25x", "--1", "\"a\\\"b\"", "\"open", "\"\\",
+    ";note\nx", "sym-1+", "abab", "aba", "ababc", "abcdbee", "abe", "acde" };
+
+  int j, k;
+  mpc_parser_t *a, *b, *ca, *cb;
+
+  for (j = 0; j < (int)(sizeof(res) / sizeof(res[0])); j++) {
+
+    /* the same regex with and without the table, alone and followed by '!' */
+    a = mpc_re_mode(res[j], MPC_RE_DOTALL);
+    b = mpc_re_mode(res[j], MPC_RE_DOTALL | MPC_RE_NO_DFA);
+    ca = mpc_and(2, mpcf_strfold, mpc_copy(a), mpc_char('!'), free);
+    cb = mpc_and(2, mpcf_strfold, mpc_copy(b), mpc_char('!'), free);
+
+    for (k = 0; k < (int)(sizeof(inputs) / sizeof(inputs[0])); k++) {
+      PT_ASSERT(regex_same(a, b, inputs[k]));
+      PT_ASSERT(regex_same(ca, cb, inputs[k]));
+    }
+
+    mpc_delete(a);
+    mpc_delete(b);
+    mpc_delete(ca);
+    mpc_delete(cb);
+  }
+
+  /* the table gives up on a partial repetition and the tree backtracks */
+  a = mpc_re("(ab)*");
+  PT_ASSERT(regex_test_pass(a, "aba", "ab"));
+  mpc_delete(a);
+
+}
+
 void suite_regex(void) {
   pt_add_test(test_regex_basic, "Test Regex Basic", "Suite Regex");
   pt_add_test(test_regex_range, "Test Regex Range", "Suite Regex");
@@ -178,4 +246,5 @@ void suite_regex(void) {
   pt_add_test(test_regex_newline, "Test Regex Newline", "Suite Regex");
   pt_add_test(test_regex_multiline, "Test Regex Multiline", "Suite Regex");
   pt_add_test(test_regex_dotall, "Test Regex Dotall", "Suite Regex");
+  pt_add_test(test_regex_dfa, "Test Regex DFA", "Suite Regex");
 }
@@ -0,0 +1,112 @@
+import re
+
+from os.path import join
+from os.path import dirname
+from os.path import abspath
+
+
+# FNV-1a (32 bits); must match "btin_hash" at core/env.c
+FNV_PRIME = 16777619
+MAX_SEED_ATTEMPTS = 1000000
+
+
+def read_file(filepath):
+    with open(filepath, 'r') as file:
+        return file.read()
+
+
+def write_file(filepath, data):
+    with open(filepath, 'w') as file:
+        file.write(data)
+
+
+def read_builtins(header):
+    body = re.search(r'#define BTIN_LIST\(X\)(.*?)\n\n', header, re.S).group(1)
+    return re.findall(r'X\("([^"]+)",\s*(\w+),\s*(\w+)\)', body)
+
+
+def btin_hash(name, seed):
+    h = seed
+
+    for c in name.encode('utf-8'):
+        h = ((h ^ c) * FNV_PRIME) & 0xFFFFFFFF
+
+    return h ^ (h >> 16)
+
+
+def find_perfect_hash(names):
+    size = 1
+    while size < len(names) * 2:
+        size *= 2
+
+    while True:
+        for seed in range(1, MAX_SEED_ATTEMPTS):
+            slots = set(btin_hash(n, seed) & (size - 1) for n in names)
+
+            if len(slots) == len(names):
+                return seed, size
+
+        size *= 2
+
+
+def main():
+    core_dir = abspath(join(dirname(__file__), '..', 'core'))
+
+    source_f = join(core_dir, 'builtin.h')        # origin header file
+    table_t = join(core_dir, 'builtin_table.h')  # destination header file
+
+    builtins = read_builtins(read_file(source_f))
+    seed, size = find_perfect_hash([b[0] for b in builtins])
+
+    print(
+        '* reading from: {}\n'
+        '* writing to:   {}\n'
+        '* builtins: {}, table size: {}, seed: {}'.format(
+            source_f, table_t, len(builtins), size, seed
+        )
+    )
+
+    slots = {btin_hash(name, seed) & (size - 1): (name, descr, fn)
+             for name, descr, fn in builtins}
+
+    width = max(len(str(s)) for s in slots) + 2
+    name_w = max(len(b[0]) for b in builtins) + 3
+    descr_w = max(len(b[1]) for b in builtins) + 1
+
+    entries = '\n'.join(
+        '    {} = {{ {} {} {} }},'.format(
+            ('[' + str(slot) + ']').ljust(width),
+            ('"' + slots[slot][0] + '",').ljust(name_w),
+            (slots[slot][1] + ',').ljust(descr_w),
+            slots[slot][2]
+        )
+        for slot in sorted(slots)
+    )
+
+    write_file(
+        table_t,
+        '/* this file is auto-generated by utils/write-builtins.py */\n'
+        '/*                 DO NOT TOUCH IT                      */\n'
+        '\n'
+        '#ifndef LEXY_BUILTIN_TABLE\n'
+        '#define LEXY_BUILTIN_TABLE\n'
+        '\n'
+        '#include "builtin.h"\n'
+        '#include "type.h"\n'
+        '\n'
+        '#define BTIN_TABLE_SEED {}u\n'
+        '#define BTIN_TABLE_SIZE {}\n'
+        '\n'
+        '\n'
+        '/* perfect hash table of every built-in function */\n'
+        'static const lbtin_meta_T btin_table[BTIN_TABLE_SIZE] =\n'
+        '{{\n'
+        '{}\n'
+        '}};\n'
+        '\n'
+        '#endif\n'.format(seed, size, entries)
+    )
+
+
+if __name__ == '__main__':
+    main()